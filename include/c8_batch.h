@@ -0,0 +1,84 @@
+#ifndef C8_BATCH_H
+#define C8_BATCH_H
+
+#include "c8_inttypes.h"
+
+struct c8_cpu;
+
+/**
+ * Many copies of the same ROM stepped together. The hot registers (V,
+ * pc, I, timers) of all instances are kept as arrays, one element per
+ * instance ("lane"). Lanes that sit on the same pc execute the
+ * instruction together with SIMD kernels, lanes that diverge (skips,
+ * jumps on different data) wait and rejoin the group at the lowest pc.
+ * Drawing, memory ops, the stack and input run per lane on a regular
+ * struct c8_cpu that holds the rest of the state.
+ *
+ * Every lane gives the same result as calling c8_step on its own CPU,
+ * including CXNN which draws from the lane's own generator.
+ */
+struct c8_batch;
+
+/* c8_batch_create flags */
+
+/* Run every instruction through c8_step per lane, no SIMD kernels */
+#define C8_BATCH_SCALAR (0x1)
+
+/**
+ * @brief Create a batch of identical CPUs.
+ * @param[in] p_template, CPU with the ROM loaded. Must not be NULL.
+ * @param[in] count, number of lanes, at least 1.
+ * @param[in] flags, C8_BATCH_* flags.
+ * @return Pointer to batch, NULL on allocation failure.
+ */
+struct c8_batch* c8_batch_create(
+    const struct c8_cpu* p_template,
+    uint32_t             count,
+    uint32_t             flags);
+
+/**
+ * @brief Release a batch and all of its CPUs.
+ * @param[in] p_batch, Pointer to batch, may be NULL.
+ */
+void c8_batch_destroy(
+    struct c8_batch* p_batch);
+
+/**
+ * @brief Number of lanes in a batch.
+ * @param[in] p_batch, Pointer to batch. Must not be NULL.
+ * @return Number of lanes.
+ */
+uint32_t c8_batch_count(
+    const struct c8_batch* p_batch);
+
+/**
+ * @brief Access the full state of a lane. Registers, timers, keyboard and
+ *        screen may be read and written through the returned CPU until the
+ *        next c8_batch_run or c8_batch_decrement_timers. RAM must not be
+ *        written.
+ * @param[in] p_batch, Pointer to batch. Must not be NULL.
+ * @param[in] lane, lane index, less than c8_batch_count.
+ * @return Pointer to the lane's CPU.
+ */
+struct c8_cpu* c8_batch_cpu(
+    struct c8_batch* p_batch,
+    uint32_t         lane);
+
+/**
+ * @brief Execute exactly budget instructions on every lane, same result as
+ *        calling c8_step budget times on each lane.
+ * @param[in] p_batch, Pointer to batch. Must not be NULL.
+ * @param[in] budget, number of instructions per lane.
+ */
+void c8_batch_run(
+    struct c8_batch* p_batch,
+    uint32_t         budget);
+
+/**
+ * @brief c8_decrement_timers for every lane.
+ * @param[in] p_batch, Pointer to batch. Must not be NULL.
+ */
+void c8_batch_decrement_timers(
+    struct c8_batch* p_batch);
+
+#endif /* C8_BATCH_H */
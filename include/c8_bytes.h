@@ -0,0 +1,49 @@
+#ifndef C8_BYTES_H
+#define C8_BYTES_H
+
+#include "c8_inttypes.h"
+
+#include <stddef.h>
+
+/* Byte level helpers shared by the file formats and the state hashes.
+ * Files are little endian whatever the host byte order, and hashes are
+ * 64-bit FNV-1a over bytes, so both come out the same on every host.
+ */
+#define C8_FNV_OFFSET (0xcbf29ce484222325ull)
+#define C8_FNV_PRIME  (0x100000001b3ull)
+
+/**
+ * @brief Continue a 64-bit FNV-1a hash over a buffer.
+ * @param[in] hash, C8_FNV_OFFSET to start a new hash.
+ * @param[in] p_data, bytes to hash. May be NULL if size is 0.
+ * @param[in] size, number of bytes.
+ * @return Updated hash.
+ */
+uint64_t c8_fnv(
+    uint64_t       hash,
+    const uint8_t* p_data,
+    size_t         size);
+
+/**
+ * @brief Write the low bytes of a value, least significant first.
+ * @param[out] p_out, destination of at least bytes bytes.
+ * @param[in] value, value to write.
+ * @param[in] bytes, 1 to 8.
+ * @return p_out advanced past the written bytes.
+ */
+uint8_t* c8_put_le(
+    uint8_t* p_out,
+    uint64_t value,
+    int      bytes);
+
+/**
+ * @brief Read a value written by c8_put_le.
+ * @param[in] p_in, source of at least bytes bytes.
+ * @param[in] bytes, 1 to 8.
+ * @return Value, zero extended.
+ */
+uint64_t c8_get_le(
+    const uint8_t* p_in,
+    int            bytes);
+
+#endif /* C8_BYTES_H */
@@ -3,13 +3,78 @@
 
 #include "c8_inttypes.h"
 
-#define C8_SCREEN_W (64)
-#define C8_SCREEN_H (32)
+/* CHIP-8 resolution, SUPER-CHIP switches between it and hi-res with
+ * 00FE and 00FF
+ */
+#define C8_SCREEN_LORES_W (64)
+#define C8_SCREEN_LORES_H (32)
+#define C8_SCREEN_HIRES_W (128)
+#define C8_SCREEN_HIRES_H (64)
+/* 64-bit words per screen row, enough for hi-res */
+#define C8_SCREEN_WORDS (C8_SCREEN_HIRES_W / 64)
 #define C8_PROGRAM_START_ADDR (0x200)
+/* Large 8x10 digits used by FX30, right after the small font */
+#define C8_BIG_FONT_ADDR (0x50)
+
+/* Seed set by c8_init, runs are reproducible unless c8_seed is called */
+#define C8_DEFAULT_SEED (0)
+
+/* Dispatch engine behind c8_step, selected at build time. 0 is the
+ * reference switch interpreter, 1 the table driven threaded interpreter.
+ */
+#ifndef C8_DISPATCH_THREADED
+#define C8_DISPATCH_THREADED (0)
+#endif
+
+/* Count instructions into a struct c8_profile, see c8_profile.h */
+#ifndef C8_PROFILE
+#define C8_PROFILE (0)
+#endif
+
+/* Record executed instructions into a struct c8_trace, see c8_trace.h */
+#ifndef C8_TRACE
+#define C8_TRACE (0)
+#endif
 
 #define C8_ARRAY_SIZE(arr) \
     (sizeof(arr) / sizeof(*arr))
 
+/* c8_run flags */
+#define C8_RUN_STOP_ON_DRAW (0x1)
+/* Skip whole iterations of loops that spin without side effects, such as
+ * waiting for the delay timer. The result is the same as stepping them.
+ */
+#define C8_RUN_SKIP_IDLE    (0x2)
+
+/**
+ * Reason for c8_run to return.
+ */
+enum c8_run_stop {
+    /* Budget used up */
+    C8_RUN_BUDGET = 0,
+    /* 00E0 or DXYN executed, only with C8_RUN_STOP_ON_DRAW */
+    C8_RUN_DRAW,
+    /* FX0A is waiting for a key, the program counter points at it */
+    C8_RUN_KEY_WAIT,
+    /* Program counter left the program or the CPU stopped, 00FD stops
+     * with the program counter pointing at it
+     */
+    C8_RUN_ERROR
+};
+
+#if C8_DISPATCH_THREADED
+/**
+ * Predecoded instruction, one per even address. handler is the
+ * enum c8_op plus one, 0 marks an entry that has not been decoded yet.
+ */
+struct c8_decoded {
+    uint8_t handler;
+    uint8_t x;
+    uint8_t y;
+    uint8_t nn;
+};
+#endif
+
 /**
  * Structure for CHIP-8 programming language compatible CPU.
  * https://en.wikipedia.org/wiki/CHIP-8
@@ -42,22 +107,68 @@ struct c8_cpu {
     uint16_t delay_timer;
     uint16_t sound_timer;
 
+    /* xorshift64* state for CXNN, set with c8_seed. Never 0. */
+    uint64_t rng_state;
+
     /* Hex Keyboard has 16 keys ranging from 0 to F */
     uint8_t keyboard[16];
 
-    uint8_t screen[C8_SCREEN_W * C8_SCREEN_H];
+    /* C8_SCREEN_WORDS 64-bit words per row, bit 63 of word 0 is the
+     * leftmost pixel (x = 0) and bit 63 of word 1 is x = 64. Only the
+     * first screen_h rows and screen_w columns are used, the rest stay 0.
+     * Use c8_get_pixel for single pixels.
+     */
+    uint64_t screen[C8_SCREEN_HIRES_H][C8_SCREEN_WORDS];
+
+    /* Current resolution, lo-res or hi-res */
+    uint16_t screen_w;
+    uint16_t screen_h;
+
+    /* SUPER-CHIP flag registers, saved and loaded with FX75 and FX85 */
+    uint8_t flags[16];
 
     /* flag for then the screen should be updated */
     int screen_is_dirty;
+
+    /* Set by c8_step and c8_run when FX0A found no key down, the program
+     * counter points at it. Nothing changes until a key is pressed, so a
+     * frontend can block on input as long as the timers are 0.
+     */
+    int waiting_for_key;
+
+#if C8_PROFILE
+    /* Set with c8_profile_attach, NULL when not profiling */
+    struct c8_profile* p_profile;
+#endif
+
+#if C8_TRACE
+    /* Set with c8_trace_attach, NULL when not tracing */
+    struct c8_trace* p_trace;
+#endif
+
+#if C8_DISPATCH_THREADED
+    /* Decode cache for ram, kept in sync by c8_invalidate */
+    struct c8_decoded decoded[4096 / 2];
+#endif
 };
 
 /**
- * @brief Initialize CHIP-8 CPU struct.
+ * @brief Initialize CHIP-8 CPU struct, seeded with C8_DEFAULT_SEED.
  * @param[out] p_cpu, Pointer to CHIP-8 CPU struct. Must not be NULL.
  */
 void c8_init(
     struct c8_cpu* p_cpu);
 
+/**
+ * @brief Seed the random number generator used by CXNN. Each CPU has its
+ *        own generator, the same seed gives the same sequence.
+ * @param[out] p_cpu, Pointer to CHIP-8 CPU struct. Must not be NULL.
+ * @param[in] seed, any value.
+ */
+void c8_seed(
+    struct c8_cpu* p_cpu,
+    uint64_t       seed);
+
 /**
  * @brief - Load program into memory, starting from 0x200
  * @param[in] program_size
@@ -81,7 +192,8 @@ int c8_load_rom_from_file(
     struct c8_cpu* p_cpu);
 
 /**
- * @brief - Load font into memory, starting from 0
+ * @brief - Load fonts into memory, the small font starting from 0 and
+ *          the SUPER-CHIP large font from C8_BIG_FONT_ADDR
  * @param[out] p_cpu, Pointer to CHIP-8 CPU struct
  */
 void c8_load_font(
@@ -95,10 +207,67 @@ void c8_decrement_timers(
     struct c8_cpu* p_cpu);
 
 /**
- * @brief Steps the CPU for a single instruction
+ * @brief Drop cached decodes for a range of memory. Must be called after
+ *        writing to p_cpu->ram directly, c8_step handles its own writes.
+ * @param[out] p_cpu, Pointer to CHIP-8 CPU struct. Must not be NULL.
+ * @param[in] addr, first address written
+ * @param[in] size, number of bytes written
+ */
+void c8_invalidate(
+    struct c8_cpu* p_cpu,
+    uint32_t       addr,
+    uint32_t       size);
+
+/**
+ * @brief Read a single pixel from the packed screen.
+ * @param[in] p_cpu, Pointer to CHIP-8 CPU struct. Must not be NULL.
+ * @param[in] x, column, 0 to screen_w - 1
+ * @param[in] y, row, 0 to screen_h - 1
+ * @return 1 if the pixel is set, 0 otherwise.
+ */
+int c8_get_pixel(
+    const struct c8_cpu* p_cpu,
+    uint8_t              x,
+    uint8_t              y);
+
+/**
+ * @brief 64-bit FNV-1a hash of the screen, for comparing runs.
+ * @param[in] p_cpu, Pointer to CHIP-8 CPU. Must not be NULL.
+ * @return Hash of the screen contents.
+ */
+uint64_t c8_hash_screen(
+    const struct c8_cpu* p_cpu);
+
+/**
+ * @brief Tells an exit apart from an error after c8_step or c8_run stopped.
+ * @param[in] p_cpu, Pointer to CHIP-8 CPU. Must not be NULL.
+ * @return C8_TRUE if the CPU stopped on SUPER-CHIP exit (00FD), C8_FALSE otherwise.
+ */
+int c8_has_exited(
+    const struct c8_cpu* p_cpu);
+
+/**
+ * @brief Steps the CPU for a single instruction, sets waiting_for_key.
  * @param[in] p_cpu Pointer to CHIP-8 CPU.
  * @return C8_TRUE if CPU is still running, C8_FALSE if error is encountered or on exit.
  */
 int c8_step(struct c8_cpu* p_cpu);
 
+/**
+ * @brief Run a batch of instructions in one call. Same result as calling
+ *        c8_step for each instruction, without the per call overhead.
+ * @param[in] p_cpu, Pointer to CHIP-8 CPU. Must not be NULL.
+ * @param[in] budget, maximum number of instructions to execute.
+ * @param[in] flags, C8_RUN_* flags.
+ * @param[out] p_executed, number of instructions executed, may be NULL.
+ * @return Reason for returning. The instruction that caused a stop
+ *         is counted as executed, except for C8_RUN_ERROR. waiting_for_key
+ *         is set if the reason is C8_RUN_KEY_WAIT.
+ */
+enum c8_run_stop c8_run(
+    struct c8_cpu* p_cpu,
+    uint32_t       budget,
+    uint32_t       flags,
+    uint32_t*      p_executed);
+
 #endif /* C8_CPU_H */
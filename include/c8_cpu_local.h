@@ -4,6 +4,53 @@
 #include "c8_inttypes.h"
 
 struct c8_cpu;
+struct c8_idle;
+enum c8_run_stop;
+
+static uint8_t c8_decode(
+    uint16_t op);
+
+static uint8_t c8_random(
+    struct c8_cpu* p_cpu);
+
+#if C8_DISPATCH_THREADED
+static uint32_t c8_exec_threaded(
+    struct c8_cpu*     p_cpu,
+    uint32_t           count,
+    uint32_t           flags,
+    enum c8_run_stop*  p_stop);
+#else
+static int c8_step_switch(
+    struct c8_cpu* p_cpu);
+#endif
+
+static uint32_t c8_idle_skip(
+    const struct c8_cpu* p_cpu,
+    struct c8_idle*      p_idle,
+    uint16_t             jump,
+    uint16_t             target,
+    uint32_t             executed,
+    uint32_t             remaining);
+
+static int c8_idle_body_is_pure(
+    const struct c8_cpu* p_cpu,
+    uint16_t             target,
+    uint16_t             jump);
+
+#if C8_PROFILE
+static void c8_profile_step(
+    struct c8_cpu* p_cpu,
+    uint16_t       pc);
+
+static uint64_t c8_profile_ticks(
+    void);
+#endif
+
+#if C8_TRACE
+static void c8_trace_step(
+    struct c8_cpu* p_cpu,
+    uint16_t       pc);
+#endif
 
 static void c8_draw(
     struct c8_cpu* p_cpu,
@@ -11,6 +58,20 @@ static void c8_draw(
     uint8_t y,
     uint8_t n);
 
+/* SUPER-CHIP scrolling, in pixels of the current resolution */
+static void c8_scroll_down(
+    struct c8_cpu* p_cpu,
+    uint8_t        n);
+
+static void c8_scroll_side(
+    struct c8_cpu* p_cpu,
+    int            left);
+
+/* Switch between lo-res and hi-res, clears the screen */
+static void c8_set_resolution(
+    struct c8_cpu* p_cpu,
+    int            hires);
+
 static void c8_reg_dump(
     struct c8_cpu* p_cpu,
     uint8_t x);
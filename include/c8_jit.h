@@ -0,0 +1,52 @@
+#ifndef C8_JIT_H
+#define C8_JIT_H
+
+#include "c8_inttypes.h"
+
+struct c8_cpu;
+
+/**
+ * Dynamic recompiler for x86-64. Basic blocks of register and control
+ * flow instructions are translated to native code and chained together,
+ * everything else (DXYN, FX0A, CXNN, memory ops, calls, ...) runs
+ * through c8_step. The CPU state stays in struct c8_cpu throughout.
+ */
+struct c8_jit;
+
+/**
+ * @brief Create a recompiler.
+ * @return Pointer to recompiler, NULL if the host is not supported or
+ *         executable memory could not be mapped.
+ */
+struct c8_jit* c8_jit_create(
+    void);
+
+/**
+ * @brief Release a recompiler and its code buffer.
+ * @param[in] p_jit, Pointer to recompiler, may be NULL.
+ */
+void c8_jit_destroy(
+    struct c8_jit* p_jit);
+
+/**
+ * @brief Drop all compiled blocks. Must be called after loading a new
+ *        ROM, switching CPUs or writing p_cpu->ram from outside c8_step.
+ * @param[in] p_jit, Pointer to recompiler. Must not be NULL.
+ */
+void c8_jit_flush(
+    struct c8_jit* p_jit);
+
+/**
+ * @brief Execute exactly budget instructions, same result as calling
+ *        c8_step budget times.
+ * @param[in] p_jit, Pointer to recompiler. Must not be NULL.
+ * @param[in] p_cpu, Pointer to CHIP-8 CPU. Must not be NULL.
+ * @param[in] budget, number of instructions to execute
+ * @return C8_TRUE if CPU is still running, C8_FALSE if error is encountered or on exit.
+ */
+int c8_jit_run(
+    struct c8_jit* p_jit,
+    struct c8_cpu* p_cpu,
+    uint32_t       budget);
+
+#endif /* C8_JIT_H */
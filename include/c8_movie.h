@@ -0,0 +1,147 @@
+#ifndef C8_MOVIE_H
+#define C8_MOVIE_H
+
+#include "c8_cpu.h"
+
+/* Input recording. A movie holds everything a run depends on besides
+ * the ROM: the CXNN seed, the instructions per second the frontend paced
+ * at and the keys held down in every frame. Replaying it from the same
+ * ROM reaches the same final state, which is stored as a hash.
+ *
+ * A frame is one c8_pacer_budget worth of instructions followed by
+ * c8_decrement_timers. The frontend's first frame is frame 0 of the
+ * pacer, with no rewinding in between.
+ */
+
+/* File layout, all fields little endian:
+ *   "C8MV", u16 version, u16 event size, u32 ips, u32 events, u64 seed,
+ *   u64 ROM hash, u64 frames, u64 final state hash, then the events.
+ * An event is u32 frames, u16 keys: key i is held when bit i is set.
+ * Version 2 state hashes cover the SUPER-CHIP screen, flags and font.
+ */
+#define C8_MOVIE_MAGIC       "C8MV"
+#define C8_MOVIE_VERSION     (2)
+#define C8_MOVIE_HEADER_SIZE (48)
+#define C8_MOVIE_EVENT_SIZE  (6)
+
+/**
+ * Keys held for a run of frames.
+ */
+struct c8_movie_event {
+    uint32_t frames;
+    uint16_t keys;
+};
+
+struct c8_movie {
+    uint32_t ips;
+    uint64_t seed;
+    /* c8_movie_hash_rom of the CPU the movie starts from */
+    uint64_t rom_hash;
+    /* Frames recorded and c8_movie_hash_state after the last one */
+    uint64_t frames;
+    uint64_t state_hash;
+
+    /* Run-length encoded keys */
+    struct c8_movie_event* p_events;
+    uint32_t event_count;
+    uint32_t event_capacity;
+
+    /* Replay position, next event and frames played of it */
+    uint32_t play_event;
+    uint32_t play_frame;
+};
+
+/**
+ * @brief Start an empty recording.
+ * @param[in] p_cpu, CPU with the ROM loaded, before its first frame. Must not be NULL.
+ * @param[in] seed, seed given to c8_seed.
+ * @param[in] ips, instructions per second given to c8_pacer_init.
+ * @return Pointer to movie, NULL on allocation failure.
+ */
+struct c8_movie* c8_movie_create(
+    const struct c8_cpu* p_cpu,
+    uint64_t             seed,
+    uint32_t             ips);
+
+/**
+ * @brief Release a movie.
+ * @param[in] p_movie, Pointer to movie, may be NULL.
+ */
+void c8_movie_destroy(
+    struct c8_movie* p_movie);
+
+/**
+ * @brief Append a frame, with the keys currently down on the CPU.
+ * @param[in,out] p_movie, Pointer to movie. Must not be NULL.
+ * @param[in] p_cpu, CPU after the frame. Must not be NULL.
+ * @return C8_TRUE on success, C8_FALSE on allocation failure.
+ */
+int c8_movie_record(
+    struct c8_movie*     p_movie,
+    const struct c8_cpu* p_cpu);
+
+/**
+ * @brief Store the state reached after the frames recorded so far.
+ * @param[in,out] p_movie, Pointer to movie. Must not be NULL.
+ * @param[in] p_cpu, CPU after the last recorded frame. Must not be NULL.
+ */
+void c8_movie_finish(
+    struct c8_movie*     p_movie,
+    const struct c8_cpu* p_cpu);
+
+/**
+ * @brief Write a movie to a file.
+ * @param[in] p_movie, Pointer to movie. Must not be NULL.
+ * @param[in] p_path, output file. Must not be NULL.
+ * @return C8_TRUE on success, C8_FALSE on write failure.
+ */
+int c8_movie_save(
+    const struct c8_movie* p_movie,
+    const char*            p_path);
+
+/**
+ * @brief Read a movie written by c8_movie_save, ready to replay.
+ * @param[in] p_path, input file. Must not be NULL.
+ * @return Pointer to movie, NULL if the file could not be read or is not
+ *         a movie of this version.
+ */
+struct c8_movie* c8_movie_load(
+    const char* p_path);
+
+/**
+ * @brief Replay from the first frame again.
+ * @param[in,out] p_movie, Pointer to movie. Must not be NULL.
+ */
+void c8_movie_rewind(
+    struct c8_movie* p_movie);
+
+/**
+ * @brief Set the keys of the next frame on a CPU.
+ * @param[in,out] p_movie, Pointer to movie. Must not be NULL.
+ * @param[out] p_cpu, CPU whose keyboard is set. Must not be NULL.
+ * @return C8_TRUE if there was a frame left, C8_FALSE at the end.
+ */
+int c8_movie_next(
+    struct c8_movie* p_movie,
+    struct c8_cpu*   p_cpu);
+
+/**
+ * @brief 64-bit FNV-1a hash of the loaded program, ram from
+ *        C8_PROGRAM_START_ADDR up to pc_max.
+ * @param[in] p_cpu, Pointer to CPU. Must not be NULL.
+ * @return Hash of the program.
+ */
+uint64_t c8_movie_hash_rom(
+    const struct c8_cpu* p_cpu);
+
+/**
+ * @brief 64-bit FNV-1a hash of everything a program can observe: ram,
+ *        registers, flag registers, stack, timers, screen and the CXNN
+ *        state.
+ * @param[in] p_cpu, Pointer to CPU. Must not be NULL.
+ * @return Hash of the state.
+ */
+uint64_t c8_movie_hash_state(
+    const struct c8_cpu* p_cpu);
+
+#endif /* C8_MOVIE_H */
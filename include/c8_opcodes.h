@@ -0,0 +1,76 @@
+#ifndef C8_OPCODES_H
+#define C8_OPCODES_H
+
+#include "c8_inttypes.h"
+
+/**
+ * Decoded CHIP-8 instructions. One entry per handler, operands are
+ * taken from the opcode itself (X, Y, N, NN, NNN).
+ */
+enum c8_op {
+    C8_OP_INVALID = 0,
+    C8_OP_SYS,        /* 0NNN */
+    C8_OP_CLS,        /* 00E0 */
+    C8_OP_RET,        /* 00EE */
+    C8_OP_JP,         /* 1NNN */
+    C8_OP_CALL,       /* 2NNN */
+    C8_OP_SE_IMM,     /* 3XNN */
+    C8_OP_SNE_IMM,    /* 4XNN */
+    C8_OP_SE_REG,     /* 5XY0 */
+    C8_OP_LD_IMM,     /* 6XNN */
+    C8_OP_ADD_IMM,    /* 7XNN */
+    C8_OP_LD_REG,     /* 8XY0 */
+    C8_OP_OR,         /* 8XY1 */
+    C8_OP_AND,        /* 8XY2 */
+    C8_OP_XOR,        /* 8XY3 */
+    C8_OP_ADD_REG,    /* 8XY4 */
+    C8_OP_SUB,        /* 8XY5 */
+    C8_OP_SHR,        /* 8XY6 */
+    C8_OP_SUBN,       /* 8XY7 */
+    C8_OP_SHL,        /* 8XYE */
+    C8_OP_SNE_REG,    /* 9XY0 */
+    C8_OP_LD_I,       /* ANNN */
+    C8_OP_JP_V0,      /* BNNN */
+    C8_OP_RND,        /* CXNN */
+    C8_OP_DRW,        /* DXYN */
+    C8_OP_SKP,        /* EX9E */
+    C8_OP_SKNP,       /* EXA1 */
+    C8_OP_LD_VX_DT,   /* FX07 */
+    C8_OP_LD_VX_K,    /* FX0A */
+    C8_OP_LD_DT_VX,   /* FX15 */
+    C8_OP_LD_ST_VX,   /* FX18 */
+    C8_OP_ADD_I,      /* FX1E */
+    C8_OP_LD_F,       /* FX29 */
+    C8_OP_LD_B,       /* FX33 */
+    C8_OP_LD_MEM_VX,  /* FX55 */
+    C8_OP_LD_VX_MEM,  /* FX65 */
+    /* SUPER-CHIP */
+    C8_OP_SCD,        /* 00CN */
+    C8_OP_SCR,        /* 00FB */
+    C8_OP_SCL,        /* 00FC */
+    C8_OP_EXIT,       /* 00FD */
+    C8_OP_LOW,        /* 00FE */
+    C8_OP_HIGH,       /* 00FF */
+    C8_OP_LD_HF,      /* FX30 */
+    C8_OP_LD_R_VX,    /* FX75 */
+    C8_OP_LD_VX_R,    /* FX85 */
+    C8_OP_COUNT
+};
+
+/**
+ * @brief Decode an opcode into its instruction.
+ * @param[in] op, 16-bit opcode as fetched from memory (big endian).
+ * @return Instruction, C8_OP_INVALID for unknown opcodes.
+ */
+enum c8_op c8_decode_op(
+    uint16_t op);
+
+/**
+ * @brief Mnemonic for an instruction, e.g "DRW" or "LD B, VX".
+ * @param[in] op, decoded instruction.
+ * @return Static string, never NULL.
+ */
+const char* c8_op_name(
+    enum c8_op op);
+
+#endif /* C8_OPCODES_H */
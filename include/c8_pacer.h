@@ -0,0 +1,111 @@
+#ifndef C8_PACER_H
+#define C8_PACER_H
+
+#include "c8_inttypes.h"
+
+/**
+ * Frame pacing for the interactive frontends. Frames are due on absolute
+ * deadlines at C8_PACER_HZ, so the time spent emulating and drawing does
+ * not add up to drift. A frontend that falls behind runs the missed
+ * frames without drawing them, up to C8_PACER_MAX_CATCH_UP at once, and
+ * drops the rest.
+ *
+ * In turbo mode the instruction rate is not limited. Each display period
+ * runs as many frames as fit in it and draws once, the frame count is
+ * adjusted to the time the previous batch took.
+ */
+
+/* Frame rate, also the rate of the delay and sound timers */
+#define C8_PACER_HZ (60)
+
+/* Instructions per second, 10 per frame */
+#define C8_PACER_DEFAULT_IPS (600)
+
+/* Most frames run at once when behind, more are dropped */
+#define C8_PACER_MAX_CATCH_UP (4)
+
+/* Most frames run per display period in turbo mode */
+#define C8_PACER_MAX_TURBO (1u << 16)
+
+/**
+ * Frame timing, measured when c8_pacer_wait returns.
+ */
+struct c8_pacer_stats {
+    /* Frames waited for */
+    uint64_t frames;
+    /* Frames run late to catch up, and frames dropped */
+    uint64_t caught_up;
+    uint64_t dropped;
+    /* Frames emulated in turbo mode */
+    uint64_t turbo_frames;
+    /* Time from a deadline to the return of c8_pacer_wait */
+    uint64_t late_ns_total;
+    uint64_t late_ns_max;
+    /* Deviation of the time between two frames from the period */
+    uint64_t jitter_ns_total;
+    uint64_t jitter_ns_max;
+};
+
+struct c8_pacer {
+    uint64_t period_ns;
+    uint64_t deadline_ns;
+    uint64_t last_ns;
+    uint32_t ips;
+    /* Emulated frames, for spreading ips over frames */
+    uint64_t frame;
+
+    /* Turbo mode, frames per display period and frame at its start */
+    int      turbo;
+    uint32_t turbo_batch;
+    uint64_t batch_start;
+
+    struct c8_pacer_stats stats;
+};
+
+/**
+ * @brief Start pacing, the first frame is due one period from now.
+ * @param[out] p_pacer, Pointer to pacer. Must not be NULL.
+ * @param[in] ips, instructions per second, at least 1.
+ */
+void c8_pacer_init(
+    struct c8_pacer* p_pacer,
+    uint32_t         ips);
+
+/**
+ * @brief Instruction budget of the next emulated frame. When ips is not
+ *        a multiple of C8_PACER_HZ the remainder is spread over frames.
+ * @param[in,out] p_pacer, Pointer to pacer. Must not be NULL.
+ * @return Number of instructions to run.
+ */
+uint32_t c8_pacer_budget(
+    struct c8_pacer* p_pacer);
+
+/**
+ * @brief Restart the deadlines from now, after the frontend blocked on
+ *        something else. The time spent blocked is not caught up.
+ * @param[in,out] p_pacer, Pointer to pacer. Must not be NULL.
+ */
+void c8_pacer_restart(
+    struct c8_pacer* p_pacer);
+
+/**
+ * @brief Switch turbo mode on or off. Leaving turbo mode restarts the
+ *        deadlines from now instead of catching up.
+ * @param[in,out] p_pacer, Pointer to pacer. Must not be NULL.
+ * @param[in] turbo, C8_TRUE to run unthrottled.
+ */
+void c8_pacer_set_turbo(
+    struct c8_pacer* p_pacer,
+    int              turbo);
+
+/**
+ * @brief Sleep until the next deadline.
+ * @param[in,out] p_pacer, Pointer to pacer. Must not be NULL.
+ * @return Frames to emulate before waiting again, 1 when on time and up
+ *         to C8_PACER_MAX_CATCH_UP when behind. In turbo mode the frames
+ *         that fit in one display period, up to C8_PACER_MAX_TURBO.
+ */
+uint32_t c8_pacer_wait(
+    struct c8_pacer* p_pacer);
+
+#endif /* C8_PACER_H */
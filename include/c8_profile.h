@@ -0,0 +1,82 @@
+#ifndef C8_PROFILE_H
+#define C8_PROFILE_H
+
+#include "c8_cpu.h"
+#include "c8_opcodes.h"
+
+/* Instruction profiler, compiled into c8_step and c8_run only when
+ * C8_PROFILE is 1 (cmake -DC8_PROFILE=ON). Without it the functions
+ * below still exist, c8_profile_attach just fails.
+ */
+
+/* Deepest call stack followed for subroutine counts, same as the CPU */
+#define C8_PROFILE_MAX_DEPTH (16)
+
+/**
+ * Counters gathered while attached to a CPU. Skipped passes of idle loops
+ * (C8_RUN_SKIP_IDLE) are not executed and not counted.
+ */
+struct c8_profile {
+    /* Instructions executed */
+    uint64_t instructions;
+    /* Executions per enum c8_op */
+    uint64_t ops[C8_OP_COUNT];
+    /* Executions per address, and the enum c8_op last executed there */
+    uint64_t pc[4096];
+    uint8_t  pc_op[4096];
+
+    /* DXYN executed and the host time spent drawing them. Ticks are
+     * TSC cycles on x86-64 and clock() ticks elsewhere.
+     */
+    uint64_t draws;
+    uint64_t draw_ticks;
+
+    /* Per subroutine entry address, calls and instructions executed
+     * until the matching 00EE, including nested calls
+     */
+    uint64_t calls[4096];
+    uint64_t inclusive[4096];
+
+    /* Calls in progress, entry address and instruction count at the call */
+    uint32_t depth;
+    uint16_t entry[C8_PROFILE_MAX_DEPTH];
+    uint64_t start[C8_PROFILE_MAX_DEPTH];
+};
+
+/**
+ * @brief Allocate a zeroed profile.
+ * @return Pointer to profile, NULL on allocation failure.
+ */
+struct c8_profile* c8_profile_create(
+    void);
+
+/**
+ * @brief Release a profile. Detach it from its CPU first.
+ * @param[in] p_profile, Pointer to profile, may be NULL.
+ */
+void c8_profile_destroy(
+    struct c8_profile* p_profile);
+
+/**
+ * @brief Count everything the CPU executes into a profile.
+ * @param[in,out] p_cpu, Pointer to CPU. Must not be NULL.
+ * @param[in] p_profile, profile to count into, NULL to detach.
+ * @return C8_TRUE on success, C8_FALSE if built without C8_PROFILE.
+ */
+int c8_profile_attach(
+    struct c8_cpu*     p_cpu,
+    struct c8_profile* p_profile);
+
+/**
+ * @brief Write a report sorted by count: opcodes, hottest addresses,
+ *        draw time and subroutines. JSON if the path ends in ".json",
+ *        text otherwise, "-" writes text to stdout.
+ * @param[in] p_profile, Pointer to profile. Must not be NULL.
+ * @param[in] p_path, output file. Must not be NULL.
+ * @return C8_TRUE on success, C8_FALSE if the file could not be written.
+ */
+int c8_profile_write(
+    const struct c8_profile* p_profile,
+    const char*              p_path);
+
+#endif /* C8_PROFILE_H */
@@ -0,0 +1,91 @@
+#ifndef C8_REWIND_H
+#define C8_REWIND_H
+
+#include "c8_inttypes.h"
+
+struct c8_cpu;
+
+/**
+ * History of recent frames for stepping backwards. The newest state is
+ * kept in full, every older frame as the XOR against the frame after it,
+ * run-length encoded. Between two frames only a few registers, screen
+ * rows and RAM bytes change, so a frame typically costs tens of bytes.
+ *
+ * Frames are dropped oldest first when either the frame or the byte
+ * limit is reached, memory never grows after c8_rewind_create. Stepping
+ * back decodes a single frame.
+ *
+ * The keyboard is not part of the history, it always reflects the
+ * current input.
+ */
+struct c8_rewind;
+
+/* 60 seconds at 60 frames per second */
+#define C8_REWIND_DEFAULT_FRAMES (60 * 60)
+
+/* Byte budget for the encoded frames */
+#define C8_REWIND_DEFAULT_BYTES  (768 * 1024)
+
+/**
+ * @brief Create an empty history.
+ * @param[in] frames, most frames kept, at least 1.
+ * @param[in] bytes, most bytes used for encoded frames.
+ * @return Pointer to history, NULL on allocation failure.
+ */
+struct c8_rewind* c8_rewind_create(
+    uint32_t frames,
+    uint32_t bytes);
+
+/**
+ * @brief Release a history.
+ * @param[in] p_rewind, Pointer to history, may be NULL.
+ */
+void c8_rewind_destroy(
+    struct c8_rewind* p_rewind);
+
+/**
+ * @brief Record the state at the end of a frame. The first call after
+ *        create or c8_rewind_clear only sets the starting point.
+ * @param[in] p_rewind, Pointer to history. Must not be NULL.
+ * @param[in] p_cpu, CPU to record. Must not be NULL.
+ */
+void c8_rewind_push(
+    struct c8_rewind*    p_rewind,
+    const struct c8_cpu* p_cpu);
+
+/**
+ * @brief Go back one frame and restore that state into a CPU. The frame
+ *        that was stepped over is forgotten, recording continues from
+ *        the restored state.
+ * @param[in] p_rewind, Pointer to history. Must not be NULL.
+ * @param[out] p_cpu, CPU to restore into, keyboard is left as is. Must not be NULL.
+ * @return C8_TRUE on success, C8_FALSE if there is no older frame.
+ */
+int c8_rewind_step_back(
+    struct c8_rewind* p_rewind,
+    struct c8_cpu*    p_cpu);
+
+/**
+ * @brief Forget all frames.
+ * @param[in] p_rewind, Pointer to history. Must not be NULL.
+ */
+void c8_rewind_clear(
+    struct c8_rewind* p_rewind);
+
+/**
+ * @brief Number of frames that can be stepped back.
+ * @param[in] p_rewind, Pointer to history. Must not be NULL.
+ * @return Number of frames.
+ */
+uint32_t c8_rewind_frames(
+    const struct c8_rewind* p_rewind);
+
+/**
+ * @brief Bytes used by the encoded frames.
+ * @param[in] p_rewind, Pointer to history. Must not be NULL.
+ * @return Number of bytes, at most the byte limit given to create.
+ */
+uint32_t c8_rewind_bytes(
+    const struct c8_rewind* p_rewind);
+
+#endif /* C8_REWIND_H */
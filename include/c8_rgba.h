@@ -0,0 +1,50 @@
+#ifndef C8_RGBA_H
+#define C8_RGBA_H
+
+#include "c8_inttypes.h"
+
+struct c8_cpu;
+
+/**
+ * Colors of unlit and lit pixels as 32-bit RGBA8888 values (0xRRGGBBAA),
+ * the layout of SDL_PIXELFORMAT_RGBA8888.
+ */
+struct c8_palette {
+    uint32_t off;
+    uint32_t on;
+};
+
+/**
+ * @brief Built-in palette by name.
+ * @param[in] p_name, "green", "amber", "white" or "blue". Must not be NULL.
+ * @return Pointer to palette, NULL if the name is unknown.
+ */
+const struct c8_palette* c8_palette_find(
+    const char* p_name);
+
+/**
+ * @brief Names of the built-in palettes for usage text.
+ * @return Names separated by '|'.
+ */
+const char* c8_palette_names(
+    void);
+
+/**
+ * @brief Expand the packed screen to one 32-bit color per pixel. Uses
+ *        vector code where the compiler supports it (AVX2 or SSE2 on
+ *        x86-64) and a plain loop otherwise.
+ * @param[in] p_cpu, CPU whose screen is expanded. Must not be NULL.
+ * @param[in] p_palette, colors. Must not be NULL.
+ * @param[out] p_pixels, screen_h rows of screen_w pixels, for example
+ *             locked texture memory. Need not be aligned. Room for
+ *             C8_SCREEN_HIRES_H rows covers both resolutions.
+ * @param[in] pitch, bytes from one row to the next, at least
+ *            screen_w * 4.
+ */
+void c8_rgba_expand(
+    const struct c8_cpu*     p_cpu,
+    const struct c8_palette* p_palette,
+    void*                    p_pixels,
+    uint32_t                 pitch);
+
+#endif /* C8_RGBA_H */
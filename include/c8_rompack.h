@@ -0,0 +1,127 @@
+#ifndef C8_ROMPACK_H
+#define C8_ROMPACK_H
+
+#include "c8_cpu.h"
+
+/* Many ROMs in one file, opened once and mapped read-only. Loading a ROM
+ * from the pack is a single copy from the mapping into ram, without file
+ * I/O or logging, so starting an instance costs about as much as
+ * c8_init.
+ *
+ * File layout, all fields little endian:
+ *   "C8RP", u16 version, u16 entry size, u32 entries, u32 0,
+ *   then the index sorted by name, then the ROM data.
+ * An index entry is a NUL padded name of C8_ROMPACK_NAME_SIZE bytes,
+ * u64 FNV-1a hash of the data, u32 offset from the start of the file,
+ * u32 size, u32 instructions per frame (0 for the default), u32 0.
+ */
+#define C8_ROMPACK_MAGIC       "C8RP"
+#define C8_ROMPACK_VERSION     (1)
+#define C8_ROMPACK_HEADER_SIZE (16)
+#define C8_ROMPACK_ENTRY_SIZE  (56)
+
+/* Longest name is one less, for the NUL */
+#define C8_ROMPACK_NAME_SIZE   (32)
+
+struct c8_rompack;
+
+/**
+ * A ROM in an open pack. Name and data point into the mapping and stay
+ * valid until c8_rompack_close.
+ */
+struct c8_rompack_entry {
+    const char*    p_name;
+    const uint8_t* p_data;
+    uint32_t       size;
+    uint64_t       hash;
+    /* Instructions per frame, 0 for the caller's default */
+    uint32_t       ipf;
+};
+
+/**
+ * A ROM to write into a pack.
+ */
+struct c8_rompack_source {
+    const char*    p_name;
+    const uint8_t* p_data;
+    uint32_t       size;
+    uint32_t       ipf;
+};
+
+/**
+ * @brief Map a pack and check its index.
+ * @param[in] p_path, pack file. Must not be NULL.
+ * @return Pointer to pack, NULL if the file could not be mapped or its
+ *         index is out of bounds, unsorted or from another version.
+ */
+struct c8_rompack* c8_rompack_open(
+    const char* p_path);
+
+/**
+ * @brief Unmap a pack. Entries taken from it become invalid.
+ * @param[in] p_pack, Pointer to pack, may be NULL.
+ */
+void c8_rompack_close(
+    struct c8_rompack* p_pack);
+
+/**
+ * @brief Number of ROMs in a pack.
+ * @param[in] p_pack, Pointer to pack. Must not be NULL.
+ * @return Number of entries.
+ */
+uint32_t c8_rompack_count(
+    const struct c8_rompack* p_pack);
+
+/**
+ * @brief Entry by position, in name order.
+ * @param[in] p_pack, Pointer to pack. Must not be NULL.
+ * @param[in] index, 0 to c8_rompack_count - 1.
+ * @return Pointer to entry, NULL if index is out of range.
+ */
+const struct c8_rompack_entry* c8_rompack_get(
+    const struct c8_rompack* p_pack,
+    uint32_t                 index);
+
+/**
+ * @brief Look up a ROM by name, binary search on the sorted index.
+ * @param[in] p_pack, Pointer to pack. Must not be NULL.
+ * @param[in] p_name, name as stored in the pack. Must not be NULL.
+ * @return Pointer to entry, NULL if there is none of that name.
+ */
+const struct c8_rompack_entry* c8_rompack_find(
+    const struct c8_rompack* p_pack,
+    const char*              p_name);
+
+/**
+ * @brief Check an entry's data against its hash. Reads the whole ROM.
+ * @param[in] p_entry, Pointer to entry. Must not be NULL.
+ * @return C8_TRUE if the data matches.
+ */
+int c8_rompack_verify(
+    const struct c8_rompack_entry* p_entry);
+
+/**
+ * @brief Load a ROM from the pack, same as c8_load_rom.
+ * @param[in] p_entry, Pointer to entry. Must not be NULL.
+ * @param[in,out] p_cpu, Pointer to CPU. Must not be NULL.
+ * @return C8_TRUE on success, C8_FALSE if the ROM does not fit into memory.
+ */
+int c8_rompack_load(
+    const struct c8_rompack_entry* p_entry,
+    struct c8_cpu*                 p_cpu);
+
+/**
+ * @brief Write a pack. Names must be unique and shorter than
+ *        C8_ROMPACK_NAME_SIZE.
+ * @param[in] p_path, output file. Must not be NULL.
+ * @param[in] p_sources, ROMs to write, in any order.
+ * @param[in] count, number of ROMs.
+ * @return C8_TRUE on success, C8_FALSE on a bad name, allocation or
+ *         write failure.
+ */
+int c8_rompack_write(
+    const char*                     p_path,
+    const struct c8_rompack_source* p_sources,
+    uint32_t                        count);
+
+#endif /* C8_ROMPACK_H */
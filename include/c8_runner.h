@@ -0,0 +1,87 @@
+#ifndef C8_RUNNER_H
+#define C8_RUNNER_H
+
+#include "c8_inttypes.h"
+
+/**
+ * Runs many headless emulator jobs on a pool of worker threads. Jobs are
+ * dealt out to per-worker queues up front, a worker that runs dry steals
+ * from the other end of another worker's queue. Every worker owns its
+ * struct c8_cpu, no emulator state is shared between threads.
+ */
+
+/* Frame budget of a job, same pacing as the frontends */
+#define C8_RUNNER_DEFAULT_IPF (10)
+
+/**
+ * One ROM run headless for a number of frames.
+ */
+struct c8_job {
+    /* ROM to load, or its name when p_rom_data is set */
+    const char* p_rom_path;
+    /* ROM already in memory, e.g. in a c8_rompack. NULL to read
+     * p_rom_path instead.
+     */
+    const uint8_t* p_rom_data;
+    uint32_t    rom_size;
+    /* Instructions per frame, 0 for the runner's */
+    uint32_t    ipf;
+    /* Key script, NULL for none. One "<frame> <key> <0|1>" event per
+     * line, key in hex, frames in increasing order, '#' starts a comment.
+     */
+    const char* p_script_path;
+    /* Number of 60 Hz frames to run */
+    uint32_t    frames;
+    /* c8_seed value, the same seed gives the same result */
+    uint64_t    seed;
+};
+
+/**
+ * Outcome of a job, handed to the result callback as soon as it finishes.
+ */
+struct c8_job_result {
+    /* Index into the job array */
+    uint32_t job;
+    /* Worker that ran the job */
+    uint32_t worker;
+    /* C8_FALSE if the ROM or script could not be loaded */
+    int      loaded;
+    /* C8_TRUE if the program counter left the program before the end */
+    int      halted;
+    /* c8_hash_screen of the final frame */
+    uint64_t screen_hash;
+    /* Instructions executed */
+    uint64_t cycles;
+    /* Frames run */
+    uint32_t frames;
+    /* Wall time of the job including loading */
+    double   seconds;
+};
+
+/**
+ * Called once per job from the worker that ran it. Calls are serialised,
+ * the callback does not need its own locking.
+ */
+typedef void (*c8_runner_result_fn)(
+    const struct c8_job_result* p_result,
+    void*                       p_user);
+
+/**
+ * @brief Run all jobs and wait for them to finish.
+ * @param[in] p_jobs, jobs to run. Must not be NULL if job_count > 0.
+ * @param[in] job_count, number of jobs.
+ * @param[in] threads, number of worker threads, at least 1.
+ * @param[in] ipf, instructions per frame.
+ * @param[in] result_fn, result callback, may be NULL.
+ * @param[in] p_user, passed to result_fn.
+ * @return C8_TRUE if all workers ran, C8_FALSE if threads could not be created.
+ */
+int c8_runner_run(
+    const struct c8_job* p_jobs,
+    uint32_t             job_count,
+    uint32_t             threads,
+    uint32_t             ipf,
+    c8_runner_result_fn  result_fn,
+    void*                p_user);
+
+#endif /* C8_RUNNER_H */
@@ -0,0 +1,91 @@
+#ifndef C8_SNAPSHOT_H
+#define C8_SNAPSHOT_H
+
+#include "c8_inttypes.h"
+
+struct c8_cpu;
+
+/**
+ * Save states for struct c8_cpu. A snapshot is a flat little-endian byte
+ * string:
+ *
+ *   header    "C8SS", version, stack depth
+ *   registers pc, pc_max, I, timers, V0-VF, keys as a 16 bit mask,
+ *             generator state, screen dirty flag, hi-res flag,
+ *             SUPER-CHIP flag registers, 64 bit mask of the screen rows
+ *             with pixels set
+ *   stack     the used entries only
+ *   screen    the rows in the row mask, one 64 bit word per row in
+ *             lo-res and two in hi-res
+ *   ram       run count, then (address, length, bytes) runs of the RAM
+ *             that differ from a base image
+ *
+ * The base image is the RAM right after loading (font and ROM), kept by
+ * the caller. Save and load must use the same base. A running program
+ * touches little of its RAM, so a snapshot is usually a few hundred
+ * bytes and restoring one is a copy of the base plus a few runs.
+ *
+ * Saving and loading work on caller provided buffers and never allocate.
+ */
+
+#define C8_SNAPSHOT_VERSION (2)
+
+/* Largest snapshot, a buffer of this size always fits */
+#define C8_SNAPSHOT_MAX_SIZE (68 + 16 * 2 + 64 * 2 * 8 + 2 + 4 + 4096)
+
+/**
+ * @brief Write the state of a CPU to a buffer.
+ * @param[in] p_cpu, CPU to save. Must not be NULL.
+ * @param[in] p_base_ram, 4096 byte RAM image the delta is taken against,
+ *            NULL for all zero.
+ * @param[out] p_buffer, destination. Must not be NULL.
+ * @param[in] size, size of p_buffer, C8_SNAPSHOT_MAX_SIZE always fits.
+ * @return Number of bytes written, 0 if the buffer is too small.
+ */
+uint32_t c8_snapshot_save(
+    const struct c8_cpu* p_cpu,
+    const uint8_t*       p_base_ram,
+    uint8_t*             p_buffer,
+    uint32_t             size);
+
+/**
+ * @brief Restore a CPU from a snapshot. The CPU is left untouched if the
+ *        snapshot is truncated, corrupt or from another version.
+ * @param[out] p_cpu, CPU to restore into. Must not be NULL.
+ * @param[in] p_base_ram, same base image as given to c8_snapshot_save,
+ *            NULL for all zero.
+ * @param[in] p_buffer, snapshot. Must not be NULL.
+ * @param[in] size, number of bytes in p_buffer.
+ * @return C8_TRUE on success, C8_FALSE otherwise.
+ */
+int c8_snapshot_load(
+    struct c8_cpu* p_cpu,
+    const uint8_t* p_base_ram,
+    const uint8_t* p_buffer,
+    uint32_t       size);
+
+/**
+ * @brief Save the state of a CPU to a file.
+ * @param[in] p_cpu, CPU to save. Must not be NULL.
+ * @param[in] p_base_ram, base image, NULL for all zero.
+ * @param[in] p_path, path/to/file. Must not be NULL.
+ * @return C8_TRUE on success, C8_FALSE otherwise.
+ */
+int c8_snapshot_save_to_file(
+    const struct c8_cpu* p_cpu,
+    const uint8_t*       p_base_ram,
+    const char*          p_path);
+
+/**
+ * @brief Restore a CPU from a file written by c8_snapshot_save_to_file.
+ * @param[out] p_cpu, CPU to restore into. Must not be NULL.
+ * @param[in] p_base_ram, base image, NULL for all zero.
+ * @param[in] p_path, path/to/file. Must not be NULL.
+ * @return C8_TRUE on success, C8_FALSE otherwise.
+ */
+int c8_snapshot_load_from_file(
+    struct c8_cpu* p_cpu,
+    const uint8_t* p_base_ram,
+    const char*    p_path);
+
+#endif /* C8_SNAPSHOT_H */
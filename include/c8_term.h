@@ -0,0 +1,91 @@
+#ifndef C8_TERM_H
+#define C8_TERM_H
+
+#include "c8_inttypes.h"
+
+struct c8_cpu;
+
+/**
+ * Terminal renderer for the CHIP-8 screen. The screen is drawn as a grid
+ * of character cells and the cells shown last are kept, so a frame only
+ * sends cursor moves, color changes and glyphs for the cells that
+ * changed. Each frame is built in a buffer allocated up front and sent
+ * with a single write().
+ */
+struct c8_term;
+
+/**
+ * How pixels map to character cells.
+ */
+enum c8_term_mode {
+    /* One pixel per two columns, unlit pixels shaded */
+    C8_TERM_BLOCK = 0,
+    /* Two rows of pixels per cell with half blocks */
+    C8_TERM_HALF,
+    /* 2x4 pixels per cell with Braille patterns */
+    C8_TERM_BRAILLE
+};
+
+/**
+ * Output counters, per frame and in total since create.
+ */
+struct c8_term_stats {
+    /* Frames drawn */
+    uint64_t frames;
+    /* Bytes and write() calls over all frames */
+    uint64_t bytes;
+    uint64_t writes;
+    /* Bytes and write() calls of the last frame */
+    uint32_t last_bytes;
+    uint32_t last_writes;
+    /* Largest frame in bytes */
+    uint32_t max_bytes;
+};
+
+/**
+ * @brief Create a renderer.
+ * @param[in] fd, file descriptor to write to, usually STDOUT_FILENO.
+ * @param[in] mode, cell layout.
+ * @return Pointer to renderer, NULL on allocation failure.
+ */
+struct c8_term* c8_term_create(
+    int               fd,
+    enum c8_term_mode mode);
+
+/**
+ * @brief Release a renderer.
+ * @param[in] p_term, Pointer to renderer, may be NULL.
+ */
+void c8_term_destroy(
+    struct c8_term* p_term);
+
+/**
+ * @brief Forget what is on the terminal, the next frame redraws every
+ *        cell. Call after anything else has written to the terminal.
+ * @param[in] p_term, Pointer to renderer. Must not be NULL.
+ */
+void c8_term_invalidate(
+    struct c8_term* p_term);
+
+/**
+ * @brief Draw the screen of a CPU, only the cells that changed.
+ * @param[in] p_term, Pointer to renderer. Must not be NULL.
+ * @param[in] p_cpu, CPU to draw. Must not be NULL.
+ * @param[in] p_status, line shown below the screen, NULL for none. Not
+ *            counted in the stats.
+ * @return C8_TRUE on success, C8_FALSE if writing failed.
+ */
+int c8_term_draw(
+    struct c8_term*      p_term,
+    const struct c8_cpu* p_cpu,
+    const char*          p_status);
+
+/**
+ * @brief Output counters.
+ * @param[in] p_term, Pointer to renderer. Must not be NULL.
+ * @return Pointer to the counters, valid until c8_term_destroy.
+ */
+const struct c8_term_stats* c8_term_get_stats(
+    const struct c8_term* p_term);
+
+#endif /* C8_TERM_H */
@@ -0,0 +1,105 @@
+#ifndef C8_TRACE_H
+#define C8_TRACE_H
+
+#include "c8_cpu.h"
+
+/* Execution trace, recorded by c8_step and c8_run only when C8_TRACE is
+ * 1 (cmake -DC8_TRACE=ON). Without it the functions below still exist,
+ * c8_trace_attach just fails.
+ *
+ * Every instruction appends one fixed-size record to a ring that keeps
+ * the most recent ones. The emulator thread is the only writer, any
+ * thread may dump the ring while it runs.
+ */
+
+/* Dump file layout, all fields little endian:
+ *   "C8TR", u16 version, u16 record size, u32 records, u32 complete,
+ *   u64 index of the first record, then the records oldest first.
+ * A record is u16 pc, u16 opcode, then the results of the instruction:
+ * u16 I, u8 VX (X from the opcode), u8 VF. The newest records past
+ * "complete" have not finished executing and carry no results.
+ */
+#define C8_TRACE_MAGIC       "C8TR"
+#define C8_TRACE_VERSION     (1)
+#define C8_TRACE_HEADER_SIZE (24)
+#define C8_TRACE_RECORD_SIZE (8)
+
+/* Records kept by the frontends, 512 KB */
+#define C8_TRACE_DEFAULT_RECORDS (1u << 16)
+
+#if defined(__GNUC__)
+#define C8_TRACE_LOAD(p)     __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define C8_TRACE_STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#else
+#define C8_TRACE_LOAD(p)     (*(volatile uint64_t*)(p))
+#define C8_TRACE_STORE(p, v) (*(volatile uint64_t*)(p) = (v))
+#endif
+
+struct c8_trace_record {
+    uint16_t pc;
+    uint16_t op;
+    /* Results, filled in when the next instruction starts */
+    uint16_t I;
+    uint8_t  vx;
+    uint8_t  vf;
+};
+
+struct c8_trace {
+    /* Ring of mask + 1 records, a power of two */
+    struct c8_trace_record* p_records;
+    uint32_t mask;
+    /* Records written so far, only the writer stores it */
+    uint64_t head;
+
+    /* Dumped here on the first invalid instruction or stack fault, NULL
+     * for none */
+    const char* p_fault_path;
+    int         faulted;
+};
+
+/**
+ * @brief Allocate a trace.
+ * @param[in] records, records kept, rounded up to a power of two.
+ * @return Pointer to trace, NULL on allocation failure.
+ */
+struct c8_trace* c8_trace_create(
+    uint32_t records);
+
+/**
+ * @brief Release a trace. Detach it from its CPU first.
+ * @param[in] p_trace, Pointer to trace, may be NULL.
+ */
+void c8_trace_destroy(
+    struct c8_trace* p_trace);
+
+/**
+ * @brief Record everything the CPU executes into a trace.
+ * @param[in,out] p_cpu, Pointer to CPU. Must not be NULL.
+ * @param[in] p_trace, trace to record into, NULL to detach.
+ * @return C8_TRUE on success, C8_FALSE if built without C8_TRACE.
+ */
+int c8_trace_attach(
+    struct c8_cpu*   p_cpu,
+    struct c8_trace* p_trace);
+
+/**
+ * @brief Write the records in the ring to a file. Safe to call from
+ *        another thread while the CPU runs, records overwritten during
+ *        the copy are left out.
+ * @param[in] p_trace, Pointer to trace. Must not be NULL.
+ * @param[in] p_path, output file. Must not be NULL.
+ * @return C8_TRUE on success, C8_FALSE on allocation or write failure.
+ */
+int c8_trace_dump(
+    const struct c8_trace* p_trace,
+    const char*            p_path);
+
+/**
+ * @brief Called by the CPU on an invalid instruction or stack fault.
+ *        Dumps to p_fault_path the first time.
+ * @param[in,out] p_trace, Pointer to trace. Must not be NULL.
+ */
+void c8_trace_fault(
+    struct c8_trace* p_trace);
+
+#endif /* C8_TRACE_H */
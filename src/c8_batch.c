@@ -0,0 +1,913 @@
+#include "c8_batch.h"
+#include "c8_cpu.h"
+#include "c8_opcodes.h"
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+
+/* GCC / Clang vector extensions, lowered to AVX2 or SSE2 by the compiler */
+#if defined(__GNUC__)
+#define C8_BATCH_SIMD (1)
+#else
+#define C8_BATCH_SIMD (0)
+#endif
+
+/* Build the lockstep loop for AVX2 and baseline x86-64, picked at load time */
+#if C8_BATCH_SIMD && defined(__x86_64__) && defined(__GLIBC__)
+#define C8_BATCH_TARGETS __attribute__((target_clones("avx2", "default")))
+#else
+#define C8_BATCH_TARGETS
+#endif
+
+/* Lanes per vector */
+#define C8_BATCH_LANES (16)
+
+/* Instructions per lockstep pass, the per lane budget is 16-bit */
+#define C8_BATCH_MAX_PASS (0xFFFF)
+
+/* Lane not taking part in the pass, sorts after every real pc */
+#define C8_BATCH_IDLE (0xFFFF)
+
+#if C8_BATCH_SIMD
+
+/**
+ * 16 lanes of one register. Registers are widened to 16 bits per lane so
+ * that carries and borrows fall out of the vector add / subtract and pc,
+ * I and the timers share the same type.
+ */
+typedef uint16_t c8_lanes __attribute__((vector_size(32)));
+
+/* Same value in every lane */
+#define C8_SPLAT(v)                                                     \
+    ((c8_lanes){ (v), (v), (v), (v), (v), (v), (v), (v),                \
+                 (v), (v), (v), (v), (v), (v), (v), (v) })
+
+/* Per lane select, m is all ones or all zeros */
+#define C8_BLEND(m, a, b) (((a) & (m)) | ((b) & ~(m)))
+
+struct c8_batch {
+    uint32_t count;
+    /* Vectors per register, count rounded up to C8_BATCH_LANES */
+    uint32_t groups;
+    uint32_t flags;
+    uint16_t pc_max;
+
+    /* Cold state of every lane, registers are only valid while a lane
+     * is checked out or runs through c8_step
+     */
+    struct c8_cpu* p_cpus;
+    uint8_t*       p_checked_out;
+    uint32_t       checked_out;
+
+    /* Hot registers, [register][group] */
+    c8_lanes* p_v;
+    c8_lanes* p_pc;
+    c8_lanes* p_i;
+    c8_lanes* p_dt;
+    c8_lanes* p_st;
+    /* Instructions left in the current pass */
+    c8_lanes* p_rem;
+    void*     p_block;
+
+    /* RAM as loaded. Opcodes are fetched from here for all lanes at once
+     * unless some lane has written to the address.
+     */
+    uint8_t ram[4096];
+    uint8_t written[4096];
+};
+
+#else
+
+struct c8_batch {
+    uint32_t       count;
+    uint32_t       flags;
+    struct c8_cpu* p_cpus;
+};
+
+#endif /* C8_BATCH_SIMD */
+
+/* --- Local Function Declarations --- */
+
+#if C8_BATCH_SIMD
+
+static uint16_t c8_batch_lead(
+    const struct c8_batch* p_batch);
+
+static void c8_batch_lane_out(
+    struct c8_batch* p_batch,
+    uint32_t         lane);
+
+static void c8_batch_lane_in(
+    struct c8_batch* p_batch,
+    uint32_t         lane);
+
+static void c8_batch_check_in(
+    struct c8_batch* p_batch);
+
+static void c8_batch_mark_written(
+    struct c8_batch* p_batch,
+    uint16_t         addr,
+    uint32_t         size);
+
+static void c8_batch_step_lanes(
+    struct c8_batch* p_batch,
+    uint16_t         lead);
+
+static void c8_batch_exec_lanes(
+    struct c8_batch* p_batch,
+    uint16_t         lead,
+    uint16_t         op);
+
+static void c8_batch_pass(
+    struct c8_batch* p_batch,
+    uint16_t         budget);
+
+#endif
+
+/* --- Function Definitions --- */
+
+#if C8_BATCH_SIMD
+
+struct c8_batch* c8_batch_create(
+    const struct c8_cpu* p_template,
+    uint32_t             count,
+    uint32_t             flags)
+{
+    struct c8_batch* p_batch;
+    uint8_t* p_aligned;
+    uint32_t groups;
+    uint32_t lane;
+    uint32_t r;
+
+    assert(0 != count);
+
+    groups = (count + C8_BATCH_LANES - 1) / C8_BATCH_LANES;
+
+    p_batch = calloc(1, sizeof(*p_batch));
+
+    if (NULL == p_batch)
+    {
+        return NULL;
+    }
+
+    p_batch->count = count;
+    p_batch->groups = groups;
+    p_batch->flags = flags;
+    p_batch->pc_max = p_template->pc_max;
+    p_batch->p_cpus = malloc(count * sizeof(struct c8_cpu));
+    p_batch->p_checked_out = calloc(count, 1);
+    /* V0-VF, pc, I, DT, ST, rem, plus room for alignment */
+    p_batch->p_block = calloc(1, (16 + 5) * groups * sizeof(c8_lanes) + sizeof(c8_lanes));
+
+    if (NULL == p_batch->p_cpus ||
+        NULL == p_batch->p_checked_out ||
+        NULL == p_batch->p_block)
+    {
+        c8_batch_destroy(p_batch);
+        return NULL;
+    }
+
+    p_aligned = (uint8_t*)p_batch->p_block;
+    p_aligned += (sizeof(c8_lanes) - ((uintptr_t)p_aligned % sizeof(c8_lanes))) % sizeof(c8_lanes);
+
+    p_batch->p_v = (c8_lanes*)p_aligned;
+    p_batch->p_pc = p_batch->p_v + 16 * groups;
+    p_batch->p_i = p_batch->p_pc + groups;
+    p_batch->p_dt = p_batch->p_i + groups;
+    p_batch->p_st = p_batch->p_dt + groups;
+    p_batch->p_rem = p_batch->p_st + groups;
+
+    memcpy(p_batch->ram, p_template->ram, sizeof(p_batch->ram));
+
+    for (lane = 0; lane < count; lane++)
+    {
+        memcpy(&p_batch->p_cpus[lane], p_template, sizeof(*p_template));
+    }
+
+    /* Padding lanes start out idle with a zero budget and never run */
+    for (lane = 0; lane < groups * C8_BATCH_LANES; lane++)
+    {
+        for (r = 0; r < 16; r++)
+        {
+            p_batch->p_v[r * groups + lane / C8_BATCH_LANES][lane % C8_BATCH_LANES] = p_template->V[r];
+        }
+
+        p_batch->p_pc[lane / C8_BATCH_LANES][lane % C8_BATCH_LANES] = p_template->pc;
+        p_batch->p_i[lane / C8_BATCH_LANES][lane % C8_BATCH_LANES] = p_template->I;
+        p_batch->p_dt[lane / C8_BATCH_LANES][lane % C8_BATCH_LANES] = p_template->delay_timer;
+        p_batch->p_st[lane / C8_BATCH_LANES][lane % C8_BATCH_LANES] = p_template->sound_timer;
+    }
+
+    return p_batch;
+}
+
+void c8_batch_destroy(
+    struct c8_batch* p_batch)
+{
+    if (NULL == p_batch)
+    {
+        return;
+    }
+
+    free(p_batch->p_block);
+    free(p_batch->p_checked_out);
+    free(p_batch->p_cpus);
+    free(p_batch);
+}
+
+uint32_t c8_batch_count(
+    const struct c8_batch* p_batch)
+{
+    return p_batch->count;
+}
+
+struct c8_cpu* c8_batch_cpu(
+    struct c8_batch* p_batch,
+    uint32_t         lane)
+{
+    assert(lane < p_batch->count);
+
+    if (!p_batch->p_checked_out[lane])
+    {
+        c8_batch_lane_out(p_batch, lane);
+        p_batch->p_checked_out[lane] = 1;
+        p_batch->checked_out++;
+    }
+
+    return &p_batch->p_cpus[lane];
+}
+
+void c8_batch_run(
+    struct c8_batch* p_batch,
+    uint32_t         budget)
+{
+    uint32_t pass;
+
+    c8_batch_check_in(p_batch);
+
+    while (budget > 0)
+    {
+        pass = (budget < C8_BATCH_MAX_PASS) ? budget : C8_BATCH_MAX_PASS;
+        c8_batch_pass(p_batch, (uint16_t)pass);
+        budget -= pass;
+    }
+}
+
+void c8_batch_decrement_timers(
+    struct c8_batch* p_batch)
+{
+    const c8_lanes zero = { 0 };
+    c8_lanes* const p_dt = p_batch->p_dt;
+    c8_lanes* const p_st = p_batch->p_st;
+    uint32_t g;
+
+    c8_batch_check_in(p_batch);
+
+    /* The compare is all ones for non-zero timers, adding it subtracts one */
+    for (g = 0; g < p_batch->groups; g++)
+    {
+        p_dt[g] += (c8_lanes)(p_dt[g] != zero);
+        p_st[g] += (c8_lanes)(p_st[g] != zero);
+    }
+}
+
+#else
+
+struct c8_batch* c8_batch_create(
+    const struct c8_cpu* p_template,
+    uint32_t             count,
+    uint32_t             flags)
+{
+    struct c8_batch* p_batch;
+    uint32_t lane;
+
+    assert(0 != count);
+
+    p_batch = calloc(1, sizeof(*p_batch));
+
+    if (NULL == p_batch)
+    {
+        return NULL;
+    }
+
+    p_batch->count = count;
+    p_batch->flags = flags;
+    p_batch->p_cpus = malloc(count * sizeof(struct c8_cpu));
+
+    if (NULL == p_batch->p_cpus)
+    {
+        free(p_batch);
+        return NULL;
+    }
+
+    for (lane = 0; lane < count; lane++)
+    {
+        memcpy(&p_batch->p_cpus[lane], p_template, sizeof(*p_template));
+    }
+
+    return p_batch;
+}
+
+void c8_batch_destroy(
+    struct c8_batch* p_batch)
+{
+    if (NULL != p_batch)
+    {
+        free(p_batch->p_cpus);
+        free(p_batch);
+    }
+}
+
+uint32_t c8_batch_count(
+    const struct c8_batch* p_batch)
+{
+    return p_batch->count;
+}
+
+struct c8_cpu* c8_batch_cpu(
+    struct c8_batch* p_batch,
+    uint32_t         lane)
+{
+    assert(lane < p_batch->count);
+
+    return &p_batch->p_cpus[lane];
+}
+
+void c8_batch_run(
+    struct c8_batch* p_batch,
+    uint32_t         budget)
+{
+    uint32_t lane;
+    uint32_t i;
+
+    /* No vector support, lanes run one after the other */
+    for (lane = 0; lane < p_batch->count; lane++)
+    {
+        for (i = 0; i < budget; i++)
+        {
+            c8_step(&p_batch->p_cpus[lane]);
+        }
+    }
+}
+
+void c8_batch_decrement_timers(
+    struct c8_batch* p_batch)
+{
+    uint32_t lane;
+
+    for (lane = 0; lane < p_batch->count; lane++)
+    {
+        c8_decrement_timers(&p_batch->p_cpus[lane]);
+    }
+}
+
+#endif /* C8_BATCH_SIMD */
+
+/* --- Local Function Definitions --- */
+
+#if C8_BATCH_SIMD
+
+/**
+ * Lowest pc of the lanes with budget left, C8_BATCH_IDLE if there are
+ * none. Running the lowest pc first lets lanes that skipped ahead wait
+ * for the others to catch up.
+ */
+static uint16_t c8_batch_lead(
+    const struct c8_batch* p_batch)
+{
+    const c8_lanes zero = { 0 };
+    c8_lanes lowest = C8_SPLAT(C8_BATCH_IDLE);
+    c8_lanes key;
+    uint16_t lead = C8_BATCH_IDLE;
+    uint32_t g;
+    int i;
+
+    for (g = 0; g < p_batch->groups; g++)
+    {
+        key = p_batch->p_pc[g] | (c8_lanes)(p_batch->p_rem[g] == zero);
+        lowest = C8_BLEND((c8_lanes)(key < lowest), key, lowest);
+    }
+
+    for (i = 0; i < C8_BATCH_LANES; i++)
+    {
+        lead = (lowest[i] < lead) ? lowest[i] : lead;
+    }
+
+    return lead;
+}
+
+static void c8_batch_lane_out(
+    struct c8_batch* p_batch,
+    uint32_t         lane)
+{
+    struct c8_cpu* p_cpu = &p_batch->p_cpus[lane];
+    const uint32_t g = lane / C8_BATCH_LANES;
+    const uint32_t i = lane % C8_BATCH_LANES;
+    uint32_t r;
+
+    for (r = 0; r < 16; r++)
+    {
+        p_cpu->V[r] = (uint8_t)p_batch->p_v[r * p_batch->groups + g][i];
+    }
+
+    p_cpu->pc = p_batch->p_pc[g][i];
+    p_cpu->I = p_batch->p_i[g][i];
+    p_cpu->delay_timer = p_batch->p_dt[g][i];
+    p_cpu->sound_timer = p_batch->p_st[g][i];
+}
+
+static void c8_batch_lane_in(
+    struct c8_batch* p_batch,
+    uint32_t         lane)
+{
+    const struct c8_cpu* p_cpu = &p_batch->p_cpus[lane];
+    const uint32_t g = lane / C8_BATCH_LANES;
+    const uint32_t i = lane % C8_BATCH_LANES;
+    uint32_t r;
+
+    for (r = 0; r < 16; r++)
+    {
+        p_batch->p_v[r * p_batch->groups + g][i] = p_cpu->V[r];
+    }
+
+    p_batch->p_pc[g][i] = p_cpu->pc;
+    p_batch->p_i[g][i] = p_cpu->I;
+    p_batch->p_dt[g][i] = p_cpu->delay_timer;
+    p_batch->p_st[g][i] = p_cpu->sound_timer;
+}
+
+/**
+ * Take back the registers of lanes handed out by c8_batch_cpu.
+ */
+static void c8_batch_check_in(
+    struct c8_batch* p_batch)
+{
+    uint32_t lane;
+
+    for (lane = 0; lane < p_batch->count && p_batch->checked_out > 0; lane++)
+    {
+        if (p_batch->p_checked_out[lane])
+        {
+            c8_batch_lane_in(p_batch, lane);
+            p_batch->p_checked_out[lane] = 0;
+            p_batch->checked_out--;
+        }
+    }
+}
+
+static void c8_batch_mark_written(
+    struct c8_batch* p_batch,
+    uint16_t         addr,
+    uint32_t         size)
+{
+    uint32_t i;
+
+    for (i = addr; i < (uint32_t)addr + size && i < sizeof(p_batch->written); i++)
+    {
+        p_batch->written[i] = 1;
+    }
+}
+
+/**
+ * Run the instruction at lead through c8_step on every lane that is
+ * there. Used for rare instructions, self-modified code and the scalar
+ * mode. Each lane fetches from its own RAM.
+ */
+static void c8_batch_step_lanes(
+    struct c8_batch* p_batch,
+    uint16_t         lead)
+{
+    struct c8_cpu* p_cpu;
+    uint32_t lane;
+    uint16_t op;
+    uint32_t g;
+    uint32_t i;
+
+    for (lane = 0; lane < p_batch->count; lane++)
+    {
+        g = lane / C8_BATCH_LANES;
+        i = lane % C8_BATCH_LANES;
+
+        if (p_batch->p_pc[g][i] != lead || 0 == p_batch->p_rem[g][i])
+        {
+            continue;
+        }
+
+        p_cpu = &p_batch->p_cpus[lane];
+        c8_batch_lane_out(p_batch, lane);
+
+        op = 0;
+        if (lead < p_batch->pc_max)
+        {
+            op = (p_cpu->ram[lead] << 8) | p_cpu->ram[lead + 1];
+        }
+
+        c8_step(p_cpu);
+
+        if (0xF033 == (op & 0xF0FF))
+        {
+            c8_batch_mark_written(p_batch, p_batch->p_i[g][i], 3);
+        }
+        else if (0xF055 == (op & 0xF0FF))
+        {
+            c8_batch_mark_written(p_batch, p_batch->p_i[g][i], ((op >> 8) & 0xF) + 1);
+        }
+
+        c8_batch_lane_in(p_batch, lane);
+        p_batch->p_rem[g][i]--;
+    }
+}
+
+/**
+ * Per lane handlers for instructions that touch the lane's stack, RAM,
+ * screen, keyboard or random generator. Cheaper than c8_batch_step_lanes since only
+ * the registers involved are moved.
+ */
+static void c8_batch_exec_lanes(
+    struct c8_batch* p_batch,
+    uint16_t         lead,
+    uint16_t         op)
+{
+    const uint32_t groups = p_batch->groups;
+    const uint8_t x = (op >> 8) & 0xF;
+    const uint8_t y = (op >> 4) & 0xF;
+    const uint16_t nnn = op & 0xFFF;
+    const enum c8_op id = c8_decode_op(op);
+    struct c8_cpu* p_cpu;
+    uint16_t* p_pc;
+    uint16_t value;
+    uint16_t addr;
+    uint32_t lane;
+    uint32_t g;
+    uint32_t i;
+    uint32_t r;
+
+    for (lane = 0; lane < p_batch->count; lane++)
+    {
+        g = lane / C8_BATCH_LANES;
+        i = lane % C8_BATCH_LANES;
+
+        if (p_batch->p_pc[g][i] != lead || 0 == p_batch->p_rem[g][i])
+        {
+            continue;
+        }
+
+        p_cpu = &p_batch->p_cpus[lane];
+        value = p_batch->p_v[x * groups + g][i];
+        addr = p_batch->p_i[g][i];
+        p_pc = &p_batch->p_pc[g][i];
+        *p_pc += 2;
+
+        switch (id)
+        {
+        case C8_OP_CLS:
+            memset(p_cpu->screen, 0x00, sizeof(p_cpu->screen));
+            p_cpu->screen_is_dirty = 1;
+            break;
+
+        case C8_OP_DRW:
+            /* Let c8_step draw, it only needs VX, VY and I */
+            p_cpu->pc = lead;
+            p_cpu->V[x] = (uint8_t)value;
+            p_cpu->V[y] = (uint8_t)p_batch->p_v[y * groups + g][i];
+            p_cpu->I = addr;
+            c8_step(p_cpu);
+            p_batch->p_v[15 * groups + g][i] = p_cpu->V[15];
+            break;
+
+        case C8_OP_RET:
+            assert(0 != p_cpu->sp);
+
+            p_cpu->sp--;
+            *p_pc = p_cpu->stack[p_cpu->sp];
+            break;
+
+        case C8_OP_CALL:
+            assert(p_cpu->sp < C8_ARRAY_SIZE(p_cpu->stack));
+
+            p_cpu->stack[p_cpu->sp] = *p_pc;
+            p_cpu->sp++;
+            *p_pc = nnn;
+            break;
+
+        case C8_OP_RND:
+            /* The generator state lives in the lane's CPU */
+            p_cpu->pc = lead;
+            c8_step(p_cpu);
+            p_batch->p_v[x * groups + g][i] = p_cpu->V[x];
+            break;
+
+        case C8_OP_SKP:
+            if (p_cpu->keyboard[value & 0xF])
+            {
+                *p_pc += 2;
+            }
+            break;
+
+        case C8_OP_SKNP:
+            if (!p_cpu->keyboard[value & 0xF])
+            {
+                *p_pc += 2;
+            }
+            break;
+
+        case C8_OP_LD_B:
+            p_cpu->ram[addr]     = value / 100;
+            p_cpu->ram[addr + 1] = (value / 10) % 10;
+            p_cpu->ram[addr + 2] = value % 10;
+            c8_invalidate(p_cpu, addr, 3);
+            c8_batch_mark_written(p_batch, addr, 3);
+            break;
+
+        case C8_OP_LD_MEM_VX:
+            for (r = 0; r <= x; r++)
+            {
+                p_cpu->ram[addr + r] = (uint8_t)p_batch->p_v[r * groups + g][i];
+            }
+            c8_invalidate(p_cpu, addr, x + 1);
+            c8_batch_mark_written(p_batch, addr, x + 1);
+            break;
+
+        case C8_OP_LD_VX_MEM:
+            for (r = 0; r <= x; r++)
+            {
+                p_batch->p_v[r * groups + g][i] = p_cpu->ram[addr + r];
+            }
+            break;
+
+        default:
+            assert(0);
+            break;
+        }
+
+        p_batch->p_rem[g][i]--;
+    }
+}
+
+/* Loop over all vectors, m selects the lanes sitting on the lead pc.
+ * The body computes next, the new pc of the selected lanes. The end of
+ * the loop retires the instruction and finds the next lead on the way.
+ */
+#define C8_LANES_BEGIN()                                                \
+    lowest = C8_SPLAT(C8_BATCH_IDLE);                                   \
+    for (g = 0; g < groups; g++)                                        \
+    {                                                                   \
+        const c8_lanes m = (c8_lanes)(p_pc[g] == lead_lanes) &          \
+                           (c8_lanes)(p_rem[g] != zero);                \
+        c8_lanes next = p_pc[g] + two;
+
+#define C8_LANES_END()                                                  \
+        p_pc[g] = C8_BLEND(m, next, p_pc[g]);                           \
+        p_rem[g] += m;                                                  \
+        key = p_pc[g] | (c8_lanes)(p_rem[g] == zero);                   \
+        lowest = C8_BLEND((c8_lanes)(key < lowest), key, lowest);       \
+    }                                                                   \
+    lead = C8_BATCH_IDLE;                                               \
+    for (i = 0; i < C8_BATCH_LANES; i++)                                \
+    {                                                                   \
+        lead = (lowest[i] < lead) ? lowest[i] : lead;                   \
+    }
+
+/* VX = f(VX, VY), VF left alone */
+#define C8_LANES_ALU(expr)                                              \
+    C8_LANES_BEGIN()                                                    \
+        const c8_lanes vx = p_vx[g];                                    \
+        const c8_lanes vy = p_vy[g];                                    \
+        p_vx[g] = C8_BLEND(m, (expr), vx);                              \
+    C8_LANES_END()
+
+/* VX = f(VX, VY), then VF = flag. VF is written last so that it wins
+ * when X is F, same as c8_step.
+ */
+#define C8_LANES_ALU_FLAG(expr, flag)                                   \
+    C8_LANES_BEGIN()                                                    \
+        const c8_lanes vx = p_vx[g];                                    \
+        const c8_lanes vy = p_vy[g];                                    \
+        const c8_lanes f = (flag);                                      \
+        (void)vy;                                                       \
+        p_vx[g] = C8_BLEND(m, (expr) & byte, vx);                       \
+        p_vf[g] = C8_BLEND(m, f, p_vf[g]);                              \
+    C8_LANES_END()
+
+/**
+ * Execute budget instructions on every lane. All lanes sitting on the
+ * lead pc run the instruction in one vector loop when the opcode is the
+ * same for all of them, which holds unless a lane wrote to it.
+ */
+C8_BATCH_TARGETS
+static void c8_batch_pass(
+    struct c8_batch* p_batch,
+    uint16_t         budget)
+{
+    const uint32_t groups = p_batch->groups;
+    const c8_lanes zero = { 0 };
+    const c8_lanes one = C8_SPLAT(1);
+    const c8_lanes two = C8_SPLAT(2);
+    const c8_lanes byte = C8_SPLAT(0xFF);
+    c8_lanes* const p_pc = p_batch->p_pc;
+    c8_lanes* const p_rem = p_batch->p_rem;
+    c8_lanes* const p_vf = &p_batch->p_v[15 * groups];
+    c8_lanes* p_vx;
+    c8_lanes* p_vy;
+    c8_lanes lead_lanes;
+    c8_lanes lowest;
+    c8_lanes key;
+    c8_lanes imm;
+    uint16_t lead;
+    uint16_t op;
+    uint32_t lane;
+    uint32_t g;
+    int i;
+
+    for (lane = 0; lane < groups * C8_BATCH_LANES; lane++)
+    {
+        p_rem[lane / C8_BATCH_LANES][lane % C8_BATCH_LANES] = (lane < p_batch->count) ? budget : 0;
+    }
+
+    lead = c8_batch_lead(p_batch);
+
+    while (C8_BATCH_IDLE != lead)
+    {
+        /* Both bytes of the opcode have to be inside the program, with
+         * pc_max at 4096 the second byte of pc 0xFFF is past ram
+         */
+        if ((p_batch->flags & C8_BATCH_SCALAR) ||
+            lead + 1 >= p_batch->pc_max ||
+            p_batch->written[lead] ||
+            p_batch->written[lead + 1])
+        {
+            c8_batch_step_lanes(p_batch, lead);
+            lead = c8_batch_lead(p_batch);
+            continue;
+        }
+
+        op = (p_batch->ram[lead] << 8) | p_batch->ram[lead + 1];
+        p_vx = &p_batch->p_v[((op >> 8) & 0xF) * groups];
+        p_vy = &p_batch->p_v[((op >> 4) & 0xF) * groups];
+        lead_lanes = C8_SPLAT(lead);
+
+        switch (c8_decode_op(op))
+        {
+        case C8_OP_SYS:
+            C8_LANES_BEGIN()
+            C8_LANES_END()
+            break;
+
+        case C8_OP_JP:
+            imm = C8_SPLAT(op & 0xFFF);
+            C8_LANES_BEGIN()
+                next = imm;
+            C8_LANES_END()
+            break;
+
+        case C8_OP_SE_IMM:
+            imm = C8_SPLAT(op & 0xFF);
+            C8_LANES_BEGIN()
+                next += two & (c8_lanes)(p_vx[g] == imm);
+            C8_LANES_END()
+            break;
+
+        case C8_OP_SNE_IMM:
+            imm = C8_SPLAT(op & 0xFF);
+            C8_LANES_BEGIN()
+                next += two & (c8_lanes)(p_vx[g] != imm);
+            C8_LANES_END()
+            break;
+
+        case C8_OP_SE_REG:
+            C8_LANES_BEGIN()
+                next += two & (c8_lanes)(p_vx[g] == p_vy[g]);
+            C8_LANES_END()
+            break;
+
+        case C8_OP_SNE_REG:
+            C8_LANES_BEGIN()
+                next += two & (c8_lanes)(p_vx[g] != p_vy[g]);
+            C8_LANES_END()
+            break;
+
+        case C8_OP_LD_IMM:
+            imm = C8_SPLAT(op & 0xFF);
+            C8_LANES_BEGIN()
+                p_vx[g] = C8_BLEND(m, imm, p_vx[g]);
+            C8_LANES_END()
+            break;
+
+        case C8_OP_ADD_IMM:
+            imm = C8_SPLAT(op & 0xFF);
+            C8_LANES_BEGIN()
+                p_vx[g] = C8_BLEND(m, (p_vx[g] + imm) & byte, p_vx[g]);
+            C8_LANES_END()
+            break;
+
+        case C8_OP_LD_REG:
+            C8_LANES_ALU(vy)
+            break;
+
+        case C8_OP_OR:
+            C8_LANES_ALU(vx | vy)
+            break;
+
+        case C8_OP_AND:
+            C8_LANES_ALU(vx & vy)
+            break;
+
+        case C8_OP_XOR:
+            C8_LANES_ALU(vx ^ vy)
+            break;
+
+        case C8_OP_ADD_REG:
+            C8_LANES_ALU_FLAG(vx + vy, (vx + vy) >> 8)
+            break;
+
+        case C8_OP_SUB:
+            C8_LANES_ALU_FLAG(vx - vy, one & (c8_lanes)(vx >= vy))
+            break;
+
+        case C8_OP_SHR:
+            C8_LANES_ALU_FLAG(vx >> 1, vx & one)
+            break;
+
+        case C8_OP_SUBN:
+            C8_LANES_ALU_FLAG(vy - vx, one & (c8_lanes)(vy >= vx))
+            break;
+
+        case C8_OP_SHL:
+            C8_LANES_ALU_FLAG(vx << 1, vx >> 7)
+            break;
+
+        case C8_OP_LD_I:
+            imm = C8_SPLAT(op & 0xFFF);
+            C8_LANES_BEGIN()
+                p_batch->p_i[g] = C8_BLEND(m, imm, p_batch->p_i[g]);
+            C8_LANES_END()
+            break;
+
+        case C8_OP_JP_V0:
+            imm = C8_SPLAT(op & 0xFFF);
+            C8_LANES_BEGIN()
+                next = imm + p_batch->p_v[g];
+            C8_LANES_END()
+            break;
+
+        case C8_OP_LD_VX_DT:
+            C8_LANES_BEGIN()
+                p_vx[g] = C8_BLEND(m, p_batch->p_dt[g] & byte, p_vx[g]);
+            C8_LANES_END()
+            break;
+
+        case C8_OP_LD_DT_VX:
+            C8_LANES_BEGIN()
+                p_batch->p_dt[g] = C8_BLEND(m, p_vx[g], p_batch->p_dt[g]);
+            C8_LANES_END()
+            break;
+
+        case C8_OP_LD_ST_VX:
+            C8_LANES_BEGIN()
+                p_batch->p_st[g] = C8_BLEND(m, p_vx[g], p_batch->p_st[g]);
+            C8_LANES_END()
+            break;
+
+        case C8_OP_ADD_I:
+            C8_LANES_BEGIN()
+                p_batch->p_i[g] = C8_BLEND(m, p_batch->p_i[g] + p_vx[g], p_batch->p_i[g]);
+            C8_LANES_END()
+            break;
+
+        case C8_OP_LD_F:
+            C8_LANES_BEGIN()
+                p_batch->p_i[g] = C8_BLEND(m, p_vx[g] * 5, p_batch->p_i[g]);
+            C8_LANES_END()
+            break;
+
+        case C8_OP_CLS:
+        case C8_OP_DRW:
+        case C8_OP_RET:
+        case C8_OP_CALL:
+        case C8_OP_RND:
+        case C8_OP_SKP:
+        case C8_OP_SKNP:
+        case C8_OP_LD_B:
+        case C8_OP_LD_MEM_VX:
+        case C8_OP_LD_VX_MEM:
+            c8_batch_exec_lanes(p_batch, lead, op);
+            lead = c8_batch_lead(p_batch);
+            break;
+
+        default:
+            /* FX0A, the SUPER-CHIP instructions and invalid opcodes */
+            c8_batch_step_lanes(p_batch, lead);
+            lead = c8_batch_lead(p_batch);
+            break;
+        }
+    }
+}
+
+#undef C8_LANES_BEGIN
+#undef C8_LANES_END
+#undef C8_LANES_ALU
+#undef C8_LANES_ALU_FLAG
+
+#endif /* C8_BATCH_SIMD */
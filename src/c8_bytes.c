@@ -0,0 +1,49 @@
+#include "c8_bytes.h"
+
+/* --- Function Definitions --- */
+
+uint64_t c8_fnv(
+    uint64_t       hash,
+    const uint8_t* p_data,
+    size_t         size)
+{
+    size_t i;
+
+    for (i = 0; i < size; i++)
+    {
+        hash ^= p_data[i];
+        hash *= C8_FNV_PRIME;
+    }
+
+    return hash;
+}
+
+uint8_t* c8_put_le(
+    uint8_t* p_out,
+    uint64_t value,
+    int      bytes)
+{
+    int i;
+
+    for (i = 0; i < bytes; i++)
+    {
+        p_out[i] = (uint8_t)(value >> (8 * i));
+    }
+
+    return p_out + bytes;
+}
+
+uint64_t c8_get_le(
+    const uint8_t* p_in,
+    int            bytes)
+{
+    uint64_t value = 0;
+    int i;
+
+    for (i = bytes - 1; i >= 0; i--)
+    {
+        value = (value << 8) | p_in[i];
+    }
+
+    return value;
+}
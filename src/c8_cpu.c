@@ -1,18 +1,216 @@
 #include "c8_cpu.h"
 #include "c8_cpu_local.h"
+#include "c8_opcodes.h"
+#include "c8_bytes.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
 #include <assert.h>
 
+#if C8_PROFILE
+#include "c8_profile.h"
+#include <time.h>
+
+/* Count the instruction at pc before executing it */
+#define C8_PROFILE_STEP(p_cpu, pc)                                      \
+    do {                                                                \
+        if (NULL != (p_cpu)->p_profile)                                 \
+        {                                                               \
+            c8_profile_step((p_cpu), (pc));                             \
+        }                                                               \
+    } while (0)
+#else
+#define C8_PROFILE_STEP(p_cpu, pc) do { } while (0)
+#endif
+
+#if C8_TRACE
+#include "c8_trace.h"
+
+/* Record the instruction at pc before executing it */
+#define C8_TRACE_STEP(p_cpu, pc)                                        \
+    do {                                                                \
+        if (NULL != (p_cpu)->p_trace)                                   \
+        {                                                               \
+            c8_trace_step((p_cpu), (pc));                               \
+        }                                                               \
+    } while (0)
+
+#define C8_TRACE_FAULT(p_cpu)                                           \
+    do {                                                                \
+        if (NULL != (p_cpu)->p_trace)                                   \
+        {                                                               \
+            c8_trace_fault((p_cpu)->p_trace);                           \
+        }                                                               \
+    } while (0)
+#else
+#define C8_TRACE_STEP(p_cpu, pc) do { } while (0)
+#define C8_TRACE_FAULT(p_cpu) do { } while (0)
+#endif
+
+/* Invalid instruction or stack fault, dump the trace before asserting */
+#define C8_CHECK(p_cpu, cond)                                           \
+    do {                                                                \
+        if (!(cond))                                                    \
+        {                                                               \
+            C8_TRACE_FAULT(p_cpu);                                      \
+        }                                                               \
+        assert(cond);                                                   \
+    } while (0)
+
+#if defined(__GNUC__)
+#define C8_COMPUTED_GOTO (1)
+#else
+#define C8_COMPUTED_GOTO (0)
+#endif
+
+#define C8_REP4(...)   __VA_ARGS__, __VA_ARGS__, __VA_ARGS__, __VA_ARGS__
+#define C8_REP16(...)  C8_REP4(C8_REP4(__VA_ARGS__))
+#define C8_REP256(...) C8_REP16(C8_REP16(__VA_ARGS__))
+
+/* Row of the 8XYN group, indexed by N */
+#define C8_ALU_ROW                                                      \
+    C8_OP_LD_REG, C8_OP_OR,      C8_OP_AND,     C8_OP_XOR,              \
+    C8_OP_ADD_REG, C8_OP_SUB,    C8_OP_SHR,     C8_OP_SUBN,             \
+    C8_OP_INVALID, C8_OP_INVALID, C8_OP_INVALID, C8_OP_INVALID,         \
+    C8_OP_INVALID, C8_OP_INVALID, C8_OP_SHL,     C8_OP_INVALID
+
+/* Longest loop body, in instructions, checked for C8_RUN_SKIP_IDLE */
+#define C8_IDLE_MAX_BODY (16)
+
+/* Passes with changing registers before a loop is no longer checked */
+#define C8_IDLE_MAX_MISSES (2)
+
+/**
+ * Loop seen by C8_RUN_SKIP_IDLE, lives for one c8_run call. Within a call
+ * the timers and keys do not change, so a loop whose body has no side
+ * effects and comes back to the same registers repeats until the call
+ * returns.
+ */
+struct c8_idle {
+    /* Backward jump closing the loop and its target, jump is 0 for none */
+    uint16_t jump;
+    uint16_t target;
+    /* C8_TRUE while the body only reads memory and writes registers and
+       has not missed too often */
+    int      pure;
+    uint32_t misses;
+    /* Instructions executed and registers at the last pass of the jump */
+    uint32_t executed;
+    uint16_t I;
+    uint8_t  V[16];
+};
+
+/* Two-level decode table, indexed by the high nibble and the low byte.
+ * The 0NNN group is decoded separately since it depends on all 12 bits.
+ */
+static const uint8_t c8_op_table[16][256] = {
+    [0x1] = { C8_REP256(C8_OP_JP) },
+    [0x2] = { C8_REP256(C8_OP_CALL) },
+    [0x3] = { C8_REP256(C8_OP_SE_IMM) },
+    [0x4] = { C8_REP256(C8_OP_SNE_IMM) },
+    [0x5] = { C8_REP256(C8_OP_SE_REG) },
+    [0x6] = { C8_REP256(C8_OP_LD_IMM) },
+    [0x7] = { C8_REP256(C8_OP_ADD_IMM) },
+    [0x8] = { C8_REP16(C8_ALU_ROW) },
+    [0x9] = { C8_REP256(C8_OP_SNE_REG) },
+    [0xA] = { C8_REP256(C8_OP_LD_I) },
+    [0xB] = { C8_REP256(C8_OP_JP_V0) },
+    [0xC] = { C8_REP256(C8_OP_RND) },
+    [0xD] = { C8_REP256(C8_OP_DRW) },
+    [0xE] = {
+        [0x9E] = C8_OP_SKP,
+        [0xA1] = C8_OP_SKNP
+    },
+    [0xF] = {
+        [0x07] = C8_OP_LD_VX_DT,
+        [0x0A] = C8_OP_LD_VX_K,
+        [0x15] = C8_OP_LD_DT_VX,
+        [0x18] = C8_OP_LD_ST_VX,
+        [0x1E] = C8_OP_ADD_I,
+        [0x29] = C8_OP_LD_F,
+        [0x30] = C8_OP_LD_HF,
+        [0x33] = C8_OP_LD_B,
+        [0x55] = C8_OP_LD_MEM_VX,
+        [0x65] = C8_OP_LD_VX_MEM,
+        [0x75] = C8_OP_LD_R_VX,
+        [0x85] = C8_OP_LD_VX_R
+    }
+};
+
+static const char* const c8_op_names[C8_OP_COUNT] = {
+    [C8_OP_INVALID]   = "INVALID",
+    [C8_OP_SYS]       = "SYS",
+    [C8_OP_CLS]       = "CLS",
+    [C8_OP_RET]       = "RET",
+    [C8_OP_JP]        = "JP",
+    [C8_OP_CALL]      = "CALL",
+    [C8_OP_SE_IMM]    = "SE VX, NN",
+    [C8_OP_SNE_IMM]   = "SNE VX, NN",
+    [C8_OP_SE_REG]    = "SE VX, VY",
+    [C8_OP_LD_IMM]    = "LD VX, NN",
+    [C8_OP_ADD_IMM]   = "ADD VX, NN",
+    [C8_OP_LD_REG]    = "LD VX, VY",
+    [C8_OP_OR]        = "OR",
+    [C8_OP_AND]       = "AND",
+    [C8_OP_XOR]       = "XOR",
+    [C8_OP_ADD_REG]   = "ADD VX, VY",
+    [C8_OP_SUB]       = "SUB",
+    [C8_OP_SHR]       = "SHR",
+    [C8_OP_SUBN]      = "SUBN",
+    [C8_OP_SHL]       = "SHL",
+    [C8_OP_SNE_REG]   = "SNE VX, VY",
+    [C8_OP_LD_I]      = "LD I, NNN",
+    [C8_OP_JP_V0]     = "JP V0, NNN",
+    [C8_OP_RND]       = "RND",
+    [C8_OP_DRW]       = "DRW",
+    [C8_OP_SKP]       = "SKP",
+    [C8_OP_SKNP]      = "SKNP",
+    [C8_OP_LD_VX_DT]  = "LD VX, DT",
+    [C8_OP_LD_VX_K]   = "LD VX, K",
+    [C8_OP_LD_DT_VX]  = "LD DT, VX",
+    [C8_OP_LD_ST_VX]  = "LD ST, VX",
+    [C8_OP_ADD_I]     = "ADD I, VX",
+    [C8_OP_LD_F]      = "LD F, VX",
+    [C8_OP_LD_B]      = "LD B, VX",
+    [C8_OP_LD_MEM_VX] = "LD [I], VX",
+    [C8_OP_LD_VX_MEM] = "LD VX, [I]",
+    [C8_OP_SCD]       = "SCD",
+    [C8_OP_SCR]       = "SCR",
+    [C8_OP_SCL]       = "SCL",
+    [C8_OP_EXIT]      = "EXIT",
+    [C8_OP_LOW]       = "LOW",
+    [C8_OP_HIGH]      = "HIGH",
+    [C8_OP_LD_HF]     = "LD HF, VX",
+    [C8_OP_LD_R_VX]   = "LD R, VX",
+    [C8_OP_LD_VX_R]   = "LD VX, R"
+};
+
 void c8_init(
     struct c8_cpu* p_cpu)
 {
     memset(p_cpu, 0x00, sizeof(*p_cpu));
 
-    srand(time(NULL));
+    p_cpu->screen_w = C8_SCREEN_LORES_W;
+    p_cpu->screen_h = C8_SCREEN_LORES_H;
+
+    c8_seed(p_cpu, C8_DEFAULT_SEED);
+}
+
+void c8_seed(
+    struct c8_cpu* p_cpu,
+    uint64_t       seed)
+{
+    /* splitmix64 spreads nearby seeds apart. It is a bijection, the one
+     * seed that lands on 0 (stuck xorshift state) is patched up.
+     */
+    uint64_t z = seed + 0x9e3779b97f4a7c15ull;
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    z = z ^ (z >> 31);
+
+    p_cpu->rng_state = (0 != z) ? z : 0x9e3779b97f4a7c15ull;
 }
 
 int c8_load_rom(
@@ -25,9 +223,8 @@ int c8_load_rom(
         memcpy(&p_cpu->ram[C8_PROGRAM_START_ADDR],
                p_program,
                program_size);
-    
-        printf("Program Size: %"PRIu64" B\n", program_size);
-        
+        c8_invalidate(p_cpu, C8_PROGRAM_START_ADDR, program_size);
+
         /* Set Program Counter */
         p_cpu->pc = C8_PROGRAM_START_ADDR;
         p_cpu->pc_max = program_size + C8_PROGRAM_START_ADDR;
@@ -50,11 +247,9 @@ int c8_load_rom_from_file(
     size_t file_size;
     size_t program_size;
 
-    printf("Loading rom: [path='%s']\n", p_path);
-
     if (NULL == f)
     {
-        printf("Failed to open file.\n");
+        printf("Failed to open file [path='%s']\n", p_path);
         result = C8_FALSE;
     }
     
@@ -115,8 +310,30 @@ void c8_load_font(
         0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
         0xF0, 0x80, 0xF0, 0x80, 0x80  // F
     };
+    const uint8_t big_fontset[160] = {
+        0x3C, 0x7E, 0xE7, 0xC3, 0xC3, 0xC3, 0xC3, 0xE7, 0x7E, 0x3C, // 0
+        0x18, 0x38, 0x58, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x3C, // 1
+        0x3E, 0x7F, 0xC3, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xFF, 0xFF, // 2
+        0x3C, 0x7E, 0xC3, 0x03, 0x0E, 0x0E, 0x03, 0xC3, 0x7E, 0x3C, // 3
+        0x06, 0x0E, 0x1E, 0x36, 0x66, 0xC6, 0xFF, 0xFF, 0x06, 0x06, // 4
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFE, 0x03, 0xC3, 0x7E, 0x3C, // 5
+        0x3E, 0x7C, 0xC0, 0xC0, 0xFC, 0xFE, 0xC3, 0xC3, 0x7E, 0x3C, // 6
+        0xFF, 0xFF, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x60, 0x60, // 7
+        0x3C, 0x7E, 0xC3, 0xC3, 0x7E, 0x7E, 0xC3, 0xC3, 0x7E, 0x3C, // 8
+        0x3C, 0x7E, 0xC3, 0xC3, 0x7F, 0x3F, 0x03, 0x03, 0x3E, 0x7C, // 9
+        0x3C, 0x7E, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, // A
+        0xFC, 0xFE, 0xC3, 0xC3, 0xFE, 0xFE, 0xC3, 0xC3, 0xFE, 0xFC, // B
+        0x3C, 0x7E, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0x7E, 0x3C, // C
+        0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // E
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0  // F
+    };
     
     memcpy(p_cpu->ram, fontset, sizeof(fontset));
+    c8_invalidate(p_cpu, 0, sizeof(fontset));
+
+    memcpy(&p_cpu->ram[C8_BIG_FONT_ADDR], big_fontset, sizeof(big_fontset));
+    c8_invalidate(p_cpu, C8_BIG_FONT_ADDR, sizeof(big_fontset));
 }
 
 void c8_decrement_timers(
@@ -133,8 +350,268 @@ void c8_decrement_timers(
     }
 }
 
+void c8_invalidate(
+    struct c8_cpu* p_cpu,
+    uint32_t       addr,
+    uint32_t       size)
+{
+#if C8_DISPATCH_THREADED
+    uint32_t last;
+    uint32_t i;
+
+    if (0 == size || addr >= sizeof(p_cpu->ram))
+    {
+        return;
+    }
+
+    last = addr + size - 1;
+
+    if (last >= sizeof(p_cpu->ram))
+    {
+        last = sizeof(p_cpu->ram) - 1;
+    }
+
+    /* An instruction at an even address covers that byte and the next */
+    for (i = addr >> 1; i <= (last >> 1); i++)
+    {
+        p_cpu->decoded[i].handler = 0;
+    }
+#else
+    (void)p_cpu;
+    (void)addr;
+    (void)size;
+#endif
+}
+
+int c8_get_pixel(
+    const struct c8_cpu* p_cpu,
+    uint8_t              x,
+    uint8_t              y)
+{
+    return (int)((p_cpu->screen[y][x >> 6] >> (63 - (x & 63))) & 1);
+}
+
+uint64_t c8_hash_screen(
+    const struct c8_cpu* p_cpu)
+{
+    static const uint8_t hires_mark = 0xFF;
+    const int words = p_cpu->screen_w / 64;
+    uint8_t row[C8_SCREEN_WORDS * 8];
+    uint64_t hash = C8_FNV_OFFSET;
+    int shift;
+    int word;
+    int y;
+
+    if (words > 1)
+    {
+        /* Lo-res only hashes the words it uses, hi-res is marked so
+         * that a screen never hashes like the other mode
+         */
+        hash = c8_fnv(hash, &hires_mark, 1);
+    }
+
+    /* Bytes are taken from the left edge so that the hash does not
+     * depend on the host byte order
+     */
+    for (y = 0; y < p_cpu->screen_h; y++)
+    {
+        for (word = 0; word < words; word++)
+        {
+            for (shift = 56; shift >= 0; shift -= 8)
+            {
+                row[word * 8 + (7 - shift / 8)] = (uint8_t)(p_cpu->screen[y][word] >> shift);
+            }
+        }
+
+        hash = c8_fnv(hash, row, (size_t)words * 8);
+    }
+
+    return hash;
+}
+
+int c8_has_exited(
+    const struct c8_cpu* p_cpu)
+{
+    const uint16_t pc = p_cpu->pc;
+
+    /* 00FD stops without advancing the program counter */
+    return (pc < p_cpu->pc_max && pc + 1u < sizeof(p_cpu->ram) &&
+            0x00 == p_cpu->ram[pc] && 0xFD == p_cpu->ram[pc + 1]) ? C8_TRUE : C8_FALSE;
+}
+
+enum c8_op c8_decode_op(
+    uint16_t op)
+{
+    return (enum c8_op)c8_decode(op);
+}
+
+const char* c8_op_name(
+    enum c8_op op)
+{
+    if ((unsigned)op >= C8_OP_COUNT)
+    {
+        op = C8_OP_INVALID;
+    }
+
+    return c8_op_names[op];
+}
+
 int c8_step(
     struct c8_cpu* p_cpu)
+{
+#if C8_DISPATCH_THREADED
+    enum c8_run_stop stop;
+
+    if (p_cpu->pc >= p_cpu->pc_max)
+    {
+        printf("unexpected program counter %d / %d \n", p_cpu->pc, p_cpu->pc_max);
+        return C8_TRUE;
+    }
+
+    c8_exec_threaded(p_cpu, 1, 0, &stop);
+    p_cpu->waiting_for_key = (C8_RUN_KEY_WAIT == stop);
+
+    /* The program counter was checked above, only 00FD stops here */
+    return (C8_RUN_ERROR != stop);
+#else
+    const uint16_t pc = p_cpu->pc;
+    int result;
+
+    result = c8_step_switch(p_cpu);
+
+    /* FX0A rewinds the program counter while waiting */
+    p_cpu->waiting_for_key = (pc == p_cpu->pc && pc < p_cpu->pc_max &&
+                              C8_OP_LD_VX_K == c8_decode((p_cpu->ram[pc] << 8) | p_cpu->ram[pc + 1]));
+
+    return result;
+#endif
+}
+
+enum c8_run_stop c8_run(
+    struct c8_cpu* p_cpu,
+    uint32_t       budget,
+    uint32_t       flags,
+    uint32_t*      p_executed)
+{
+    enum c8_run_stop stop = C8_RUN_BUDGET;
+    uint32_t executed;
+
+#if C8_DISPATCH_THREADED
+    executed = c8_exec_threaded(p_cpu, budget, flags, &stop);
+#else
+    struct c8_idle idle;
+    uint16_t pc;
+    uint8_t id;
+
+    idle.jump = 0;
+
+    for (executed = 0; executed < budget; executed++)
+    {
+        pc = p_cpu->pc;
+
+        if (pc >= p_cpu->pc_max)
+        {
+            stop = C8_RUN_ERROR;
+            break;
+        }
+
+        id = c8_decode((p_cpu->ram[pc] << 8) | p_cpu->ram[pc + 1]);
+
+        if (C8_FALSE == c8_step_switch(p_cpu))
+        {
+            stop = C8_RUN_ERROR;
+            break;
+        }
+
+        if (C8_OP_LD_VX_K == id && pc == p_cpu->pc)
+        {
+            /* FX0A rewinds the program counter while waiting */
+            stop = C8_RUN_KEY_WAIT;
+            executed++;
+            break;
+        }
+
+        if ((flags & C8_RUN_STOP_ON_DRAW) &&
+            (C8_OP_DRW == id || C8_OP_CLS == id))
+        {
+            stop = C8_RUN_DRAW;
+            executed++;
+            break;
+        }
+
+        if ((flags & C8_RUN_SKIP_IDLE) && C8_OP_JP == id && p_cpu->pc <= pc)
+        {
+            executed += c8_idle_skip(p_cpu, &idle, pc, p_cpu->pc,
+                                     executed + 1, budget - executed - 1);
+        }
+        else if (C8_OP_CALL == id || C8_OP_RET == id || C8_OP_JP_V0 == id)
+        {
+            /* Could come back into the loop without passing its jump */
+            idle.jump = 0;
+        }
+    }
+#endif
+
+    p_cpu->waiting_for_key = (C8_RUN_KEY_WAIT == stop);
+
+    if (NULL != p_executed)
+    {
+        *p_executed = executed;
+    }
+
+    return stop;
+}
+
+/* --- Local Function Definitions --- */
+
+static uint8_t c8_decode(
+    uint16_t op)
+{
+    if (op < 0x1000)
+    {
+        /* 00E0, 00EE and the SUPER-CHIP 00CN and 00FB-00FF, everything
+         * else in the group is 0NNN
+         */
+        switch (op)
+        {
+        case 0x00E0: return C8_OP_CLS;
+        case 0x00EE: return C8_OP_RET;
+        case 0x00FB: return C8_OP_SCR;
+        case 0x00FC: return C8_OP_SCL;
+        case 0x00FD: return C8_OP_EXIT;
+        case 0x00FE: return C8_OP_LOW;
+        case 0x00FF: return C8_OP_HIGH;
+        default:
+            return (0x00C0 == (op & 0xFFF0)) ? C8_OP_SCD : C8_OP_SYS;
+        }
+    }
+
+    return c8_op_table[op >> 12][op & 0xFF];
+}
+
+/**
+ * xorshift64*, returns the top byte which has the best statistics.
+ */
+static uint8_t c8_random(
+    struct c8_cpu* p_cpu)
+{
+    uint64_t x = p_cpu->rng_state;
+
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    p_cpu->rng_state = x;
+
+    return (uint8_t)((x * 0x2545f4914f6cdd1dull) >> 56);
+}
+
+#if !C8_DISPATCH_THREADED
+
+/**
+ * Reference interpreter, decodes with a nested switch.
+ */
+static int c8_step_switch(
+    struct c8_cpu* p_cpu)
 {
     int result = C8_TRUE;
 
@@ -142,6 +619,8 @@ int c8_step(
     int key_pressed;
     uint16_t tmp;
     uint8_t cx, cy;
+
+    key_pressed = -1;
     
     if (p_cpu->pc >= p_cpu->pc_max)
     {
@@ -149,6 +628,9 @@ int c8_step(
         return result;
     }
         
+    C8_PROFILE_STEP(p_cpu, p_cpu->pc);
+    C8_TRACE_STEP(p_cpu, p_cpu->pc);
+
     /* Fetch */
     uint16_t op = (p_cpu->ram[p_cpu->pc] << 8) | p_cpu->ram[p_cpu->pc + 1];
     p_cpu->pc += 2;
@@ -178,11 +660,41 @@ int c8_step(
             /* Opcode: 00EE
              * Returns from a subroutine
              */
-            assert(0 != p_cpu->sp);
+            C8_CHECK(p_cpu, 0 != p_cpu->sp);
 
             p_cpu->sp--;
             p_cpu->pc = p_cpu->stack[p_cpu->sp];
         }
+        else if ((op & 0xFFF0) == 0x00C0)
+        {
+            /* Opcode: 00CN
+             * Scrolls the screen down by N pixels
+             */
+            c8_scroll_down(p_cpu, n);
+        }
+        else if (op == 0x00FB || op == 0x00FC)
+        {
+            /* Opcode: 00FB, 00FC
+             * Scrolls the screen right (00FB) or left (00FC) by 4 pixels
+             */
+            c8_scroll_side(p_cpu, op == 0x00FC);
+        }
+        else if (op == 0x00FD)
+        {
+            /* Opcode: 00FD
+             * Exits the interpreter, the program counter stays on it
+             */
+            p_cpu->pc -= 2;
+            result = C8_FALSE;
+        }
+        else if (op == 0x00FE || op == 0x00FF)
+        {
+            /* Opcode: 00FE, 00FF
+             * Switches to lo-res (00FE) or hi-res (00FF) and clears the
+             * screen
+             */
+            c8_set_resolution(p_cpu, op == 0x00FF);
+        }
         else
         {
             /* Opcode: 0NNN
@@ -205,7 +717,7 @@ int c8_step(
         /* Opcode: 0x2NNN
          * Calls subroutine at NNN
          */
-        assert(p_cpu->sp < C8_ARRAY_SIZE(p_cpu->stack));
+        C8_CHECK(p_cpu, p_cpu->sp < C8_ARRAY_SIZE(p_cpu->stack));
 
         p_cpu->stack[p_cpu->sp] = p_cpu->pc;
         p_cpu->sp++;
@@ -348,7 +860,7 @@ int c8_step(
             break;
                 
         default:
-            assert(0);
+            C8_CHECK(p_cpu, 0);
             break;
         }
         break;
@@ -382,15 +894,15 @@ int c8_step(
     case 0xC:
         /* Opcode: 0xCXNN
          * Sets VX to the result of a bitwise and operation on a random number and NN
-         * (VX = rand() & NN)
+         * (VX = random & NN)
          */
-        // 2. Perform the bitwise AND with the constant NN
-        p_cpu->V[x] = rand() & nn;
+        p_cpu->V[x] = c8_random(p_cpu) & nn;
         break;
 
     case 0xD:
         /* Opcode: 0xDXYN
          * Draws a sprite at coordinate (VX, VY) that has a width of 8 pixels and a height of N pixels
+         * DXY0 draws a 16x16 sprite, two bytes per row.
          *
          * Each row of 8 pixels is read as bit-coded starting from memory location I.
          * VF is set to 1 if any screen pixels are flipped from set to unset when the sprite is drawn
@@ -424,7 +936,7 @@ int c8_step(
         }
         else
         {
-            assert(0);
+            C8_CHECK(p_cpu, 0);
         }
         break;
     case 0xF:
@@ -490,6 +1002,14 @@ int c8_step(
              */
             p_cpu->I = p_cpu->V[x] * 5;
         }
+        else if (0x30 == nn)
+        {
+            /* Opcode: 0xFX30
+             * Sets I to the location of the large 8x10 sprite for the
+             * digit in the low nibble of VX.
+             */
+            p_cpu->I = C8_BIG_FONT_ADDR + (p_cpu->V[x] & 0xF) * 10;
+        }
         else if (0x33 == nn)
         {
             /* Opcode: 0xFX33
@@ -503,6 +1023,7 @@ int c8_step(
             p_cpu->ram[p_cpu->I]     = value / 100;         
             p_cpu->ram[p_cpu->I + 1] = (value / 10) % 10;   
             p_cpu->ram[p_cpu->I + 2] = value % 10;          
+            c8_invalidate(p_cpu, p_cpu->I, 3);
         }
         else if (0x55 == nn)
         {
@@ -522,20 +1043,595 @@ int c8_step(
              */
             c8_reg_load(p_cpu, x);
         }
+        else if (0x75 == nn)
+        {
+            /* Opcode: 0xFX75
+             *
+             * Stores from V0 to VX (including) in the flag registers.
+             */
+            memcpy(p_cpu->flags, p_cpu->V, x + 1);
+        }
+        else if (0x85 == nn)
+        {
+            /* Opcode: 0xFX85
+             *
+             * Fills from V0 to VX (including) from the flag registers.
+             */
+            memcpy(p_cpu->V, p_cpu->flags, x + 1);
+        }
         else
         {
-            assert(0);
+            C8_CHECK(p_cpu, 0);
         }
         break;
     default:
-        assert(0);
+        C8_CHECK(p_cpu, 0);
         break;
     }
     
     return result;
 }
 
-/* --- Local Function Definitions --- */
+#endif /* !C8_DISPATCH_THREADED */
+
+#if C8_DISPATCH_THREADED
+
+/* Operand fields of the current instruction */
+#define C8_X   (p_dec->x)
+#define C8_Y   (p_dec->y)
+#define C8_N   (p_dec->nn & 0x0F)
+#define C8_NN  (p_dec->nn)
+#define C8_NNN ((uint16_t)((p_dec->x << 8) | p_dec->nn))
+
+/* Handler ids in the decode cache are shifted by one, 0 means not decoded */
+#define C8_HANDLER(op) ((op) + 1)
+
+#if C8_COMPUTED_GOTO
+#define C8_DISPATCH(id) goto *c8_labels[(id)]
+#else
+#define C8_DISPATCH(id) do { dispatch_id = (id); goto dispatch; } while (0)
+#endif
+
+/* Look up the predecoded instruction at pc and jump to its handler. With
+ * computed goto every handler ends in its own indirect jump, which
+ * predicts far better than a single shared dispatch branch. Odd
+ * addresses are never cached and always take the decode path.
+ */
+#define C8_NEXT()                                                       \
+    do {                                                                \
+        if (0 == remaining)                                             \
+        {                                                               \
+            goto done;                                                  \
+        }                                                               \
+        if (pc >= pc_max)                                               \
+        {                                                               \
+            stop = C8_RUN_ERROR;                                        \
+            goto done;                                                  \
+        }                                                               \
+        remaining--;                                                    \
+        C8_PROFILE_STEP(p_cpu, pc);                                     \
+        C8_TRACE_STEP(p_cpu, pc);                                       \
+        p_dec = &p_decoded[pc >> 1];                                    \
+        if (pc & 1)                                                     \
+        {                                                               \
+            p_dec = &uncached;                                          \
+            p_dec->handler = 0;                                         \
+        }                                                               \
+        pc += 2;                                                        \
+        C8_DISPATCH(p_dec->handler);                                    \
+    } while (0)
+
+/* Stop after a draw if the caller asked for it */
+#define C8_NEXT_AFTER_DRAW()                                            \
+    do {                                                                \
+        if (flags & C8_RUN_STOP_ON_DRAW)                                \
+        {                                                               \
+            stop = C8_RUN_DRAW;                                         \
+            goto done;                                                  \
+        }                                                               \
+        C8_NEXT();                                                      \
+    } while (0)
+
+/**
+ * Threaded interpreter, executes up to count instructions with the
+ * program counter kept in a local. Behaves exactly like count calls to
+ * c8_step_switch, see c8_run for flags and stop reasons.
+ */
+static uint32_t c8_exec_threaded(
+    struct c8_cpu*     p_cpu,
+    uint32_t           count,
+    uint32_t           flags,
+    enum c8_run_stop*  p_stop)
+{
+#if C8_COMPUTED_GOTO
+    static const void* const c8_labels[C8_HANDLER(C8_OP_COUNT)] = {
+        [0]                           = &&op_decode,
+        [C8_HANDLER(C8_OP_INVALID)]   = &&op_invalid,
+        [C8_HANDLER(C8_OP_SYS)]       = &&op_sys,
+        [C8_HANDLER(C8_OP_CLS)]       = &&op_cls,
+        [C8_HANDLER(C8_OP_RET)]       = &&op_ret,
+        [C8_HANDLER(C8_OP_JP)]        = &&op_jp,
+        [C8_HANDLER(C8_OP_CALL)]      = &&op_call,
+        [C8_HANDLER(C8_OP_SE_IMM)]    = &&op_se_imm,
+        [C8_HANDLER(C8_OP_SNE_IMM)]   = &&op_sne_imm,
+        [C8_HANDLER(C8_OP_SE_REG)]    = &&op_se_reg,
+        [C8_HANDLER(C8_OP_LD_IMM)]    = &&op_ld_imm,
+        [C8_HANDLER(C8_OP_ADD_IMM)]   = &&op_add_imm,
+        [C8_HANDLER(C8_OP_LD_REG)]    = &&op_ld_reg,
+        [C8_HANDLER(C8_OP_OR)]        = &&op_or,
+        [C8_HANDLER(C8_OP_AND)]       = &&op_and,
+        [C8_HANDLER(C8_OP_XOR)]       = &&op_xor,
+        [C8_HANDLER(C8_OP_ADD_REG)]   = &&op_add_reg,
+        [C8_HANDLER(C8_OP_SUB)]       = &&op_sub,
+        [C8_HANDLER(C8_OP_SHR)]       = &&op_shr,
+        [C8_HANDLER(C8_OP_SUBN)]      = &&op_subn,
+        [C8_HANDLER(C8_OP_SHL)]       = &&op_shl,
+        [C8_HANDLER(C8_OP_SNE_REG)]   = &&op_sne_reg,
+        [C8_HANDLER(C8_OP_LD_I)]      = &&op_ld_i,
+        [C8_HANDLER(C8_OP_JP_V0)]     = &&op_jp_v0,
+        [C8_HANDLER(C8_OP_RND)]       = &&op_rnd,
+        [C8_HANDLER(C8_OP_DRW)]       = &&op_drw,
+        [C8_HANDLER(C8_OP_SKP)]       = &&op_skp,
+        [C8_HANDLER(C8_OP_SKNP)]      = &&op_sknp,
+        [C8_HANDLER(C8_OP_LD_VX_DT)]  = &&op_ld_vx_dt,
+        [C8_HANDLER(C8_OP_LD_VX_K)]   = &&op_ld_vx_k,
+        [C8_HANDLER(C8_OP_LD_DT_VX)]  = &&op_ld_dt_vx,
+        [C8_HANDLER(C8_OP_LD_ST_VX)]  = &&op_ld_st_vx,
+        [C8_HANDLER(C8_OP_ADD_I)]     = &&op_add_i,
+        [C8_HANDLER(C8_OP_LD_F)]      = &&op_ld_f,
+        [C8_HANDLER(C8_OP_LD_B)]      = &&op_ld_b,
+        [C8_HANDLER(C8_OP_LD_MEM_VX)] = &&op_ld_mem_vx,
+        [C8_HANDLER(C8_OP_LD_VX_MEM)] = &&op_ld_vx_mem,
+        [C8_HANDLER(C8_OP_SCD)]       = &&op_scd,
+        [C8_HANDLER(C8_OP_SCR)]       = &&op_scr,
+        [C8_HANDLER(C8_OP_SCL)]       = &&op_scl,
+        [C8_HANDLER(C8_OP_EXIT)]      = &&op_exit,
+        [C8_HANDLER(C8_OP_LOW)]       = &&op_low,
+        [C8_HANDLER(C8_OP_HIGH)]      = &&op_high,
+        [C8_HANDLER(C8_OP_LD_HF)]     = &&op_ld_hf,
+        [C8_HANDLER(C8_OP_LD_R_VX)]   = &&op_ld_r_vx,
+        [C8_HANDLER(C8_OP_LD_VX_R)]   = &&op_ld_vx_r
+    };
+#else
+    uint8_t dispatch_id;
+#endif
+    struct c8_decoded* const p_decoded = p_cpu->decoded;
+    const uint16_t pc_max = p_cpu->pc_max;
+    enum c8_run_stop stop = C8_RUN_BUDGET;
+    uint32_t remaining = count;
+    uint16_t pc = p_cpu->pc;
+    struct c8_decoded* p_dec;
+    struct c8_decoded uncached;
+    struct c8_idle idle;
+    uint16_t op;
+    uint16_t tmp;
+    int i;
+    int key_pressed;
+
+    idle.jump = 0;
+
+    C8_NEXT();
+
+#if !C8_COMPUTED_GOTO
+dispatch:
+    switch (dispatch_id)
+    {
+    case 0:                            goto op_decode;
+    case C8_HANDLER(C8_OP_SYS):        goto op_sys;
+    case C8_HANDLER(C8_OP_CLS):        goto op_cls;
+    case C8_HANDLER(C8_OP_RET):        goto op_ret;
+    case C8_HANDLER(C8_OP_JP):         goto op_jp;
+    case C8_HANDLER(C8_OP_CALL):       goto op_call;
+    case C8_HANDLER(C8_OP_SE_IMM):     goto op_se_imm;
+    case C8_HANDLER(C8_OP_SNE_IMM):    goto op_sne_imm;
+    case C8_HANDLER(C8_OP_SE_REG):     goto op_se_reg;
+    case C8_HANDLER(C8_OP_LD_IMM):     goto op_ld_imm;
+    case C8_HANDLER(C8_OP_ADD_IMM):    goto op_add_imm;
+    case C8_HANDLER(C8_OP_LD_REG):     goto op_ld_reg;
+    case C8_HANDLER(C8_OP_OR):         goto op_or;
+    case C8_HANDLER(C8_OP_AND):        goto op_and;
+    case C8_HANDLER(C8_OP_XOR):        goto op_xor;
+    case C8_HANDLER(C8_OP_ADD_REG):    goto op_add_reg;
+    case C8_HANDLER(C8_OP_SUB):        goto op_sub;
+    case C8_HANDLER(C8_OP_SHR):        goto op_shr;
+    case C8_HANDLER(C8_OP_SUBN):       goto op_subn;
+    case C8_HANDLER(C8_OP_SHL):        goto op_shl;
+    case C8_HANDLER(C8_OP_SNE_REG):    goto op_sne_reg;
+    case C8_HANDLER(C8_OP_LD_I):       goto op_ld_i;
+    case C8_HANDLER(C8_OP_JP_V0):      goto op_jp_v0;
+    case C8_HANDLER(C8_OP_RND):        goto op_rnd;
+    case C8_HANDLER(C8_OP_DRW):        goto op_drw;
+    case C8_HANDLER(C8_OP_SKP):        goto op_skp;
+    case C8_HANDLER(C8_OP_SKNP):       goto op_sknp;
+    case C8_HANDLER(C8_OP_LD_VX_DT):   goto op_ld_vx_dt;
+    case C8_HANDLER(C8_OP_LD_VX_K):    goto op_ld_vx_k;
+    case C8_HANDLER(C8_OP_LD_DT_VX):   goto op_ld_dt_vx;
+    case C8_HANDLER(C8_OP_LD_ST_VX):   goto op_ld_st_vx;
+    case C8_HANDLER(C8_OP_ADD_I):      goto op_add_i;
+    case C8_HANDLER(C8_OP_LD_F):       goto op_ld_f;
+    case C8_HANDLER(C8_OP_LD_B):       goto op_ld_b;
+    case C8_HANDLER(C8_OP_LD_MEM_VX):  goto op_ld_mem_vx;
+    case C8_HANDLER(C8_OP_LD_VX_MEM):  goto op_ld_vx_mem;
+    case C8_HANDLER(C8_OP_SCD):        goto op_scd;
+    case C8_HANDLER(C8_OP_SCR):        goto op_scr;
+    case C8_HANDLER(C8_OP_SCL):        goto op_scl;
+    case C8_HANDLER(C8_OP_EXIT):       goto op_exit;
+    case C8_HANDLER(C8_OP_LOW):        goto op_low;
+    case C8_HANDLER(C8_OP_HIGH):       goto op_high;
+    case C8_HANDLER(C8_OP_LD_HF):      goto op_ld_hf;
+    case C8_HANDLER(C8_OP_LD_R_VX):    goto op_ld_r_vx;
+    case C8_HANDLER(C8_OP_LD_VX_R):    goto op_ld_vx_r;
+    default:              goto op_invalid;
+    }
+#endif
+
+done:
+    p_cpu->pc = pc;
+    *p_stop = stop;
+    return count - remaining;
+
+op_decode:
+    /* Slow path, fill the cache entry (or the uncached record) */
+    op = (p_cpu->ram[pc - 2] << 8) | p_cpu->ram[pc - 1];
+    p_dec->handler = C8_HANDLER(c8_decode(op));
+    p_dec->x = (op >> 8) & 0xF;
+    p_dec->y = (op >> 4) & 0xF;
+    p_dec->nn = op & 0xFF;
+    C8_DISPATCH(p_dec->handler);
+
+op_invalid:
+    C8_CHECK(p_cpu, 0);
+    C8_NEXT();
+
+op_sys:
+    /* 0NNN, treated as NOP */
+    C8_NEXT();
+
+op_cls:
+    memset(p_cpu->screen, 0x00, sizeof(p_cpu->screen));
+    p_cpu->screen_is_dirty = 1;
+    C8_NEXT_AFTER_DRAW();
+
+op_ret:
+    C8_CHECK(p_cpu, 0 != p_cpu->sp);
+    p_cpu->sp--;
+    pc = p_cpu->stack[p_cpu->sp];
+    idle.jump = 0;
+    C8_NEXT();
+
+op_jp:
+    tmp = C8_NNN;
+
+    if ((flags & C8_RUN_SKIP_IDLE) && tmp < pc)
+    {
+        /* Backward jump, pc is already past it */
+        remaining -= c8_idle_skip(p_cpu, &idle, pc - 2, tmp,
+                                  count - remaining, remaining);
+    }
+
+    pc = tmp;
+    C8_NEXT();
+
+op_call:
+    C8_CHECK(p_cpu, p_cpu->sp < C8_ARRAY_SIZE(p_cpu->stack));
+    p_cpu->stack[p_cpu->sp] = pc;
+    p_cpu->sp++;
+    pc = C8_NNN;
+    idle.jump = 0;
+    C8_NEXT();
+
+op_se_imm:
+    pc += (p_cpu->V[C8_X] == C8_NN) << 1;
+    C8_NEXT();
+
+op_sne_imm:
+    pc += (p_cpu->V[C8_X] != C8_NN) << 1;
+    C8_NEXT();
+
+op_se_reg:
+    pc += (p_cpu->V[C8_X] == p_cpu->V[C8_Y]) << 1;
+    C8_NEXT();
+
+op_ld_imm:
+    p_cpu->V[C8_X] = C8_NN;
+    C8_NEXT();
+
+op_add_imm:
+    p_cpu->V[C8_X] += C8_NN;
+    C8_NEXT();
+
+op_ld_reg:
+    p_cpu->V[C8_X] = p_cpu->V[C8_Y];
+    C8_NEXT();
+
+op_or:
+    p_cpu->V[C8_X] |= p_cpu->V[C8_Y];
+    C8_NEXT();
+
+op_and:
+    p_cpu->V[C8_X] &= p_cpu->V[C8_Y];
+    C8_NEXT();
+
+op_xor:
+    p_cpu->V[C8_X] ^= p_cpu->V[C8_Y];
+    C8_NEXT();
+
+op_add_reg:
+    tmp = p_cpu->V[C8_X] + p_cpu->V[C8_Y];
+    p_cpu->V[C8_X] = (uint8_t)tmp;
+    p_cpu->V[15] = (tmp > 0xff);
+    C8_NEXT();
+
+op_sub:
+    tmp = p_cpu->V[C8_X] >= p_cpu->V[C8_Y];
+    p_cpu->V[C8_X] = p_cpu->V[C8_X] - p_cpu->V[C8_Y];
+    p_cpu->V[15] = tmp;
+    C8_NEXT();
+
+op_shr:
+    tmp = p_cpu->V[C8_X] & 1;
+    p_cpu->V[C8_X] >>= 1;
+    p_cpu->V[15] = tmp;
+    C8_NEXT();
+
+op_subn:
+    tmp = p_cpu->V[C8_Y] >= p_cpu->V[C8_X];
+    p_cpu->V[C8_X] = p_cpu->V[C8_Y] - p_cpu->V[C8_X];
+    p_cpu->V[15] = tmp;
+    C8_NEXT();
+
+op_shl:
+    tmp = (p_cpu->V[C8_X] >> 7);
+    p_cpu->V[C8_X] <<= 1;
+    p_cpu->V[15] = tmp;
+    C8_NEXT();
+
+op_sne_reg:
+    pc += (p_cpu->V[C8_X] != p_cpu->V[C8_Y]) << 1;
+    C8_NEXT();
+
+op_ld_i:
+    p_cpu->I = C8_NNN;
+    C8_NEXT();
+
+op_jp_v0:
+    pc = C8_NNN + p_cpu->V[0];
+    idle.jump = 0;
+    C8_NEXT();
+
+op_rnd:
+    p_cpu->V[C8_X] = c8_random(p_cpu) & C8_NN;
+    C8_NEXT();
+
+op_drw:
+    c8_draw(p_cpu, C8_X, C8_Y, C8_N);
+    C8_NEXT_AFTER_DRAW();
+
+op_skp:
+    pc += (0 != p_cpu->keyboard[p_cpu->V[C8_X] & 0xF]) << 1;
+    C8_NEXT();
+
+op_sknp:
+    pc += (0 == p_cpu->keyboard[p_cpu->V[C8_X] & 0xF]) << 1;
+    C8_NEXT();
+
+op_ld_vx_dt:
+    p_cpu->V[C8_X] = p_cpu->delay_timer;
+    C8_NEXT();
+
+op_ld_vx_k:
+    key_pressed = -1;
+
+    for (i = 0; i < 16; i++)
+    {
+        if (p_cpu->keyboard[i])
+        {
+            key_pressed = i;
+            break;
+        }
+    }
+
+    if (key_pressed != -1)
+    {
+        p_cpu->V[C8_X] = (uint8_t)key_pressed;
+    }
+    else
+    {
+        /* Wait until key press */
+        pc -= 2;
+        stop = C8_RUN_KEY_WAIT;
+        goto done;
+    }
+    C8_NEXT();
+
+op_ld_dt_vx:
+    p_cpu->delay_timer = p_cpu->V[C8_X];
+    C8_NEXT();
+
+op_ld_st_vx:
+    p_cpu->sound_timer = p_cpu->V[C8_X];
+    C8_NEXT();
+
+op_add_i:
+    p_cpu->I += p_cpu->V[C8_X];
+    C8_NEXT();
+
+op_ld_f:
+    p_cpu->I = p_cpu->V[C8_X] * 5;
+    C8_NEXT();
+
+op_ld_b:
+    tmp = p_cpu->V[C8_X];
+    p_cpu->ram[p_cpu->I]     = tmp / 100;
+    p_cpu->ram[p_cpu->I + 1] = (tmp / 10) % 10;
+    p_cpu->ram[p_cpu->I + 2] = tmp % 10;
+    c8_invalidate(p_cpu, p_cpu->I, 3);
+    C8_NEXT();
+
+op_ld_mem_vx:
+    c8_reg_dump(p_cpu, C8_X);
+    C8_NEXT();
+
+op_ld_vx_mem:
+    c8_reg_load(p_cpu, C8_X);
+    C8_NEXT();
+
+op_scd:
+    c8_scroll_down(p_cpu, C8_N);
+    C8_NEXT();
+
+op_scr:
+    c8_scroll_side(p_cpu, C8_FALSE);
+    C8_NEXT();
+
+op_scl:
+    c8_scroll_side(p_cpu, C8_TRUE);
+    C8_NEXT();
+
+op_exit:
+    /* Not counted as executed, like any other error */
+    pc -= 2;
+    remaining++;
+    stop = C8_RUN_ERROR;
+    goto done;
+
+op_low:
+    c8_set_resolution(p_cpu, C8_FALSE);
+    C8_NEXT();
+
+op_high:
+    c8_set_resolution(p_cpu, C8_TRUE);
+    C8_NEXT();
+
+op_ld_hf:
+    p_cpu->I = C8_BIG_FONT_ADDR + (p_cpu->V[C8_X] & 0xF) * 10;
+    C8_NEXT();
+
+op_ld_r_vx:
+    memcpy(p_cpu->flags, p_cpu->V, C8_X + 1);
+    C8_NEXT();
+
+op_ld_vx_r:
+    memcpy(p_cpu->V, p_cpu->flags, C8_X + 1);
+    C8_NEXT();
+}
+
+#undef C8_NEXT
+#undef C8_NEXT_AFTER_DRAW
+#undef C8_DISPATCH
+#undef C8_HANDLER
+#undef C8_X
+#undef C8_Y
+#undef C8_N
+#undef C8_NN
+#undef C8_NNN
+
+#endif /* C8_DISPATCH_THREADED */
+
+/**
+ * Called after executing a backward jump, returns how many of the
+ * remaining instructions can be skipped. Only whole passes of the loop
+ * are skipped, so the program counter ends where stepping would leave it.
+ * Once control leaves a pure body it can only come back through another
+ * backward jump, a call, a return or BNNN, which all reset p_idle, so two
+ * passes of the same jump in a row are one pass of the body.
+ */
+static uint32_t c8_idle_skip(
+    const struct c8_cpu* p_cpu,
+    struct c8_idle*      p_idle,
+    uint16_t             jump,
+    uint16_t             target,
+    uint32_t             executed,
+    uint32_t             remaining)
+{
+    uint32_t length;
+
+    if (jump != p_idle->jump || target != p_idle->target)
+    {
+        p_idle->jump = jump;
+        p_idle->target = target;
+        p_idle->pure = c8_idle_body_is_pure(p_cpu, target, jump);
+        p_idle->misses = 0;
+    }
+    else if (C8_TRUE == p_idle->pure &&
+             p_idle->I == p_cpu->I &&
+             0 == memcmp(p_idle->V, p_cpu->V, sizeof(p_idle->V)))
+    {
+        /* Same registers as the last pass, every pass from here on is
+         * the same as the one just executed */
+        length = executed - p_idle->executed;
+        return (remaining / length) * length;
+    }
+    else if (C8_TRUE == p_idle->pure &&
+             ++p_idle->misses > C8_IDLE_MAX_MISSES)
+    {
+        /* Counting or otherwise making progress, stop comparing */
+        p_idle->pure = C8_FALSE;
+    }
+
+    if (C8_TRUE == p_idle->pure)
+    {
+        p_idle->executed = executed;
+        p_idle->I = p_cpu->I;
+        memcpy(p_idle->V, p_cpu->V, sizeof(p_idle->V));
+    }
+
+    return 0;
+}
+
+/**
+ * True if every instruction from target up to the jump only reads
+ * memory, the keys and the delay timer and writes registers. Control
+ * flow inside the body is limited to skips.
+ */
+static int c8_idle_body_is_pure(
+    const struct c8_cpu* p_cpu,
+    uint16_t             target,
+    uint16_t             jump)
+{
+    uint16_t addr;
+
+    if ((jump - target) & 1 || (jump - target) / 2 > C8_IDLE_MAX_BODY)
+    {
+        return C8_FALSE;
+    }
+
+    for (addr = target; addr < jump; addr += 2)
+    {
+        switch (c8_decode((p_cpu->ram[addr] << 8) | p_cpu->ram[addr + 1]))
+        {
+        case C8_OP_SYS:
+        case C8_OP_SE_IMM:
+        case C8_OP_SNE_IMM:
+        case C8_OP_SE_REG:
+        case C8_OP_SNE_REG:
+        case C8_OP_LD_IMM:
+        case C8_OP_ADD_IMM:
+        case C8_OP_LD_REG:
+        case C8_OP_OR:
+        case C8_OP_AND:
+        case C8_OP_XOR:
+        case C8_OP_ADD_REG:
+        case C8_OP_SUB:
+        case C8_OP_SHR:
+        case C8_OP_SUBN:
+        case C8_OP_SHL:
+        case C8_OP_LD_I:
+        case C8_OP_SKP:
+        case C8_OP_SKNP:
+        case C8_OP_LD_VX_DT:
+        case C8_OP_ADD_I:
+        case C8_OP_LD_F:
+        case C8_OP_LD_VX_MEM:
+            break;
+
+        default:
+            return C8_FALSE;
+        }
+    }
+
+    return C8_TRUE;
+}
 
 static void c8_draw(
     struct c8_cpu* p_cpu,
@@ -543,30 +1639,209 @@ static void c8_draw(
     uint8_t y,
     uint8_t n)
 {
-    uint8_t x_pos = p_cpu->V[x] % C8_SCREEN_W;
-    uint8_t y_pos = p_cpu->V[y] % C8_SCREEN_H;
+    /* Both resolutions are powers of two */
+    const uint32_t x_pos = p_cpu->V[x] & (p_cpu->screen_w - 1);
+    const uint32_t y_pos = p_cpu->V[y] & (p_cpu->screen_h - 1);
+    const uint32_t shift = x_pos & 63;
+    /* DXY0 draws 16x16, two bytes per row */
+    const uint32_t rows = (0 != n) ? n : 16;
+    uint64_t collision = 0;
+    uint64_t sprite_row;
+    uint64_t spill;
+    uint64_t* p_row;
+    uint32_t addr;
+#if C8_PROFILE
+    const uint64_t start = (NULL != p_cpu->p_profile) ? c8_profile_ticks() : 0;
+#endif
     
-    p_cpu->V[0xF] = 0;
+    for (uint32_t row = 0; row < rows; row++) {
+        /* Place the sprite row at x = 0 and shift it into position */
+        if (0 != n)
+        {
+            addr = (p_cpu->I + row) & 0xFFF;
+            sprite_row = (uint64_t)p_cpu->ram[addr] << 56;
+        }
+        else
+        {
+            addr = (p_cpu->I + row * 2) & 0xFFF;
+            sprite_row = ((uint64_t)p_cpu->ram[addr] << 56) |
+                         ((uint64_t)p_cpu->ram[(addr + 1) & 0xFFF] << 48);
+        }
 
-    for (int row = 0; row < n; row++) {
-        uint8_t sprite_byte = p_cpu->ram[p_cpu->I + row];
+        p_row = p_cpu->screen[(y_pos + row) & (p_cpu->screen_h - 1)];
 
-        for (int col = 0; col < 8; col++) {
-            if ((sprite_byte & (0x80 >> col)) != 0) {
-                uint16_t screen_idx = ((y_pos + row) % C8_SCREEN_H) * C8_SCREEN_W + ((x_pos + col) % C8_SCREEN_W);
+        if (C8_SCREEN_LORES_W == p_cpu->screen_w)
+        {
+            /* The rotation wraps the pixels that fall off the right edge */
+            sprite_row = (sprite_row >> shift) | (sprite_row << ((64 - shift) & 63));
 
-                if (p_cpu->screen[screen_idx] == 1) {
-                    p_cpu->V[0xF] = 1;
-                }
+            collision |= p_row[0] & sprite_row;
+            p_row[0] ^= sprite_row;
+        }
+        else
+        {
+            /* 128-bit rotation, the pixels shifted out of the word the
+             * sprite starts in go to the other one, which is the next
+             * word or the left edge
+             */
+            spill = (0 != shift) ? sprite_row << (64 - shift) : 0;
+            sprite_row >>= shift;
 
-                p_cpu->screen[screen_idx] ^= 1;
-            }
+            collision |= (p_row[x_pos >> 6] & sprite_row) |
+                         (p_row[(x_pos >> 6) ^ 1] & spill);
+            p_row[x_pos >> 6] ^= sprite_row;
+            p_row[(x_pos >> 6) ^ 1] ^= spill;
         }
     }
 
+    p_cpu->V[0xF] = (0 != collision);
+    p_cpu->screen_is_dirty = 1;
+
+#if C8_PROFILE
+    if (NULL != p_cpu->p_profile)
+    {
+        p_cpu->p_profile->draws++;
+        p_cpu->p_profile->draw_ticks += c8_profile_ticks() - start;
+    }
+#endif
+}
+
+static void c8_scroll_down(
+    struct c8_cpu* p_cpu,
+    uint8_t        n)
+{
+    const uint32_t rows = (n < p_cpu->screen_h) ? n : p_cpu->screen_h;
+
+    memmove(p_cpu->screen[rows], p_cpu->screen[0],
+            (p_cpu->screen_h - rows) * sizeof(p_cpu->screen[0]));
+    memset(p_cpu->screen[0], 0x00, rows * sizeof(p_cpu->screen[0]));
     p_cpu->screen_is_dirty = 1;
 }
 
+static void c8_scroll_side(
+    struct c8_cpu* p_cpu,
+    int            left)
+{
+    uint64_t* p_row;
+    uint32_t y;
+
+    /* 4 pixels, the word shifts carry across the middle in hi-res and
+     * drop what leaves the screen
+     */
+    for (y = 0; y < p_cpu->screen_h; y++)
+    {
+        p_row = p_cpu->screen[y];
+
+        if (C8_SCREEN_LORES_W == p_cpu->screen_w)
+        {
+            p_row[0] = left ? (p_row[0] << 4) : (p_row[0] >> 4);
+        }
+        else if (left)
+        {
+            p_row[0] = (p_row[0] << 4) | (p_row[1] >> 60);
+            p_row[1] <<= 4;
+        }
+        else
+        {
+            p_row[1] = (p_row[1] >> 4) | (p_row[0] << 60);
+            p_row[0] >>= 4;
+        }
+    }
+
+    p_cpu->screen_is_dirty = 1;
+}
+
+static void c8_set_resolution(
+    struct c8_cpu* p_cpu,
+    int            hires)
+{
+    p_cpu->screen_w = hires ? C8_SCREEN_HIRES_W : C8_SCREEN_LORES_W;
+    p_cpu->screen_h = hires ? C8_SCREEN_HIRES_H : C8_SCREEN_LORES_H;
+
+    memset(p_cpu->screen, 0x00, sizeof(p_cpu->screen));
+    p_cpu->screen_is_dirty = 1;
+}
+
+#if C8_PROFILE
+
+static void c8_profile_step(
+    struct c8_cpu* p_cpu,
+    uint16_t       pc)
+{
+    struct c8_profile* p_profile = p_cpu->p_profile;
+    const uint16_t op = (p_cpu->ram[pc & 0xFFF] << 8) | p_cpu->ram[(pc + 1) & 0xFFF];
+    const uint8_t id = c8_decode(op);
+
+    p_profile->instructions++;
+    p_profile->ops[id]++;
+    p_profile->pc[pc & 0xFFF]++;
+    p_profile->pc_op[pc & 0xFFF] = id;
+
+    if (C8_OP_CALL == id)
+    {
+        /* Deeper calls than the CPU allows only keep the depth in sync */
+        if (p_profile->depth < C8_PROFILE_MAX_DEPTH)
+        {
+            p_profile->entry[p_profile->depth] = op & 0xFFF;
+            p_profile->start[p_profile->depth] = p_profile->instructions;
+            p_profile->calls[op & 0xFFF]++;
+        }
+
+        p_profile->depth++;
+    }
+    else if (C8_OP_RET == id && p_profile->depth > 0)
+    {
+        p_profile->depth--;
+
+        /* The 00EE is counted to the subroutine */
+        if (p_profile->depth < C8_PROFILE_MAX_DEPTH)
+        {
+            p_profile->inclusive[p_profile->entry[p_profile->depth]] +=
+                p_profile->instructions - p_profile->start[p_profile->depth];
+        }
+    }
+}
+
+static uint64_t c8_profile_ticks(void)
+{
+#if defined(__x86_64__) && defined(__GNUC__)
+    return __builtin_ia32_rdtsc();
+#else
+    return (uint64_t)clock();
+#endif
+}
+
+#endif /* C8_PROFILE */
+
+#if C8_TRACE
+
+static void c8_trace_step(
+    struct c8_cpu* p_cpu,
+    uint16_t       pc)
+{
+    struct c8_trace* p_trace = p_cpu->p_trace;
+    const uint64_t head = p_trace->head;
+    struct c8_trace_record* p_record;
+
+    if (0 != head)
+    {
+        /* The previous instruction has finished, store what it left */
+        p_record = &p_trace->p_records[(head - 1) & p_trace->mask];
+        p_record->I = p_cpu->I;
+        p_record->vx = p_cpu->V[(p_record->op >> 8) & 0xF];
+        p_record->vf = p_cpu->V[0xF];
+    }
+
+    p_record = &p_trace->p_records[head & p_trace->mask];
+    p_record->pc = pc;
+    p_record->op = (p_cpu->ram[pc & 0xFFF] << 8) | p_cpu->ram[(pc + 1) & 0xFFF];
+
+    /* Publish after the record is written, for c8_trace_dump */
+    C8_TRACE_STORE(&p_trace->head, head + 1);
+}
+
+#endif /* C8_TRACE */
+
 static void c8_reg_dump(
     struct c8_cpu* p_cpu,
     uint8_t x)
@@ -576,6 +1851,8 @@ static void c8_reg_dump(
     {
         p_cpu->ram[p_cpu->I + i] = p_cpu->V[i];
     }
+
+    c8_invalidate(p_cpu, p_cpu->I, x + 1);
 }
     
 static void c8_reg_load(
@@ -0,0 +1,640 @@
+#define _DEFAULT_SOURCE
+
+#include "c8_jit.h"
+#include "c8_cpu.h"
+#include "c8_opcodes.h"
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__unix__)
+#define C8_JIT_SUPPORTED (1)
+#include <sys/mman.h>
+#else
+#define C8_JIT_SUPPORTED (0)
+#endif
+
+#define C8_JIT_CODE_SIZE     (1u << 20)
+#define C8_JIT_MAX_BLOCK_OPS (64)
+#define C8_JIT_MAX_BLOCK_SIZE (C8_JIT_MAX_BLOCK_OPS * 32 + 64)
+#define C8_JIT_MAX_LINKS     (1024)
+
+/* Address flags */
+#define C8_JIT_NO_BLOCK (0x01) /* first instruction can not be compiled */
+#define C8_JIT_CODE     (0x02) /* byte is part of a compiled block */
+
+/**
+ * Jump at the end of a block whose target was not compiled yet. Patched
+ * to jump straight into the target block once it exists.
+ */
+struct c8_jit_link {
+    int32_t* p_rel;
+    uint16_t target;
+};
+
+struct c8_jit {
+    uint8_t* p_code;
+    size_t   code_used;
+
+    /* Trampoline: enter(p_cpu, budget, p_block) returns remaining budget */
+    uint8_t* p_enter;
+    /* Common block exit, returns to the caller of the trampoline */
+    uint8_t* p_exit;
+
+    uint8_t* blocks[4096];
+    uint8_t  flags[4096];
+
+    struct c8_jit_link links[C8_JIT_MAX_LINKS];
+    uint32_t           link_count;
+};
+
+typedef uint32_t (*c8_jit_enter_fn)(
+    struct c8_cpu* p_cpu,
+    uint32_t       budget,
+    const uint8_t* p_block);
+
+/* --- Local Function Declarations --- */
+
+#if C8_JIT_SUPPORTED
+
+static void c8_jit_reset(
+    struct c8_jit* p_jit);
+
+static uint8_t* c8_jit_compile(
+    struct c8_jit*       p_jit,
+    const struct c8_cpu* p_cpu,
+    uint16_t             pc);
+
+static int c8_jit_interpret(
+    struct c8_jit* p_jit,
+    struct c8_cpu* p_cpu);
+
+#endif
+
+/* --- Function Definitions --- */
+
+#if C8_JIT_SUPPORTED
+
+struct c8_jit* c8_jit_create(void)
+{
+    struct c8_jit* p_jit = calloc(1, sizeof(*p_jit));
+    void* p_code;
+
+    if (NULL == p_jit)
+    {
+        return NULL;
+    }
+
+    p_code = mmap(NULL,
+                  C8_JIT_CODE_SIZE,
+                  PROT_READ | PROT_WRITE | PROT_EXEC,
+                  MAP_PRIVATE | MAP_ANONYMOUS,
+                  -1,
+                  0);
+
+    if (MAP_FAILED == p_code)
+    {
+        free(p_jit);
+        return NULL;
+    }
+
+    p_jit->p_code = p_code;
+    c8_jit_reset(p_jit);
+
+    return p_jit;
+}
+
+void c8_jit_destroy(
+    struct c8_jit* p_jit)
+{
+    if (NULL != p_jit)
+    {
+        munmap(p_jit->p_code, C8_JIT_CODE_SIZE);
+        free(p_jit);
+    }
+}
+
+void c8_jit_flush(
+    struct c8_jit* p_jit)
+{
+    c8_jit_reset(p_jit);
+}
+
+int c8_jit_run(
+    struct c8_jit* p_jit,
+    struct c8_cpu* p_cpu,
+    uint32_t       budget)
+{
+    c8_jit_enter_fn enter;
+    uint8_t* p_block;
+    uint32_t left;
+    uint16_t pc;
+
+    memcpy(&enter, &p_jit->p_enter, sizeof(enter));
+
+    while (budget > 0)
+    {
+        pc = p_cpu->pc;
+        p_block = NULL;
+
+        if (pc < p_cpu->pc_max &&
+            pc + 1 < (int)sizeof(p_cpu->ram) &&
+            0 == (p_jit->flags[pc] & C8_JIT_NO_BLOCK))
+        {
+            p_block = p_jit->blocks[pc];
+
+            if (NULL == p_block)
+            {
+                p_block = c8_jit_compile(p_jit, p_cpu, pc);
+            }
+        }
+
+        if (NULL != p_block)
+        {
+            left = enter(p_cpu, budget, p_block);
+
+            if (left != budget)
+            {
+                budget = left;
+                continue;
+            }
+
+            /* Budget is smaller than the block, finish with single steps */
+        }
+
+        if (C8_FALSE == c8_jit_interpret(p_jit, p_cpu))
+        {
+            return C8_FALSE;
+        }
+
+        budget--;
+    }
+
+    return C8_TRUE;
+}
+
+/* --- Local Function Definitions --- */
+
+/* Register use inside generated code:
+ *   rbx  struct c8_cpu*
+ *   r12d remaining instruction budget
+ *   eax, ecx scratch
+ */
+#define C8_JIT_MODRM_RBX(reg) (0x80 | ((reg) << 3) | 3)
+
+#define C8_OFF_V(i)    ((int32_t)(offsetof(struct c8_cpu, V) + (i)))
+#define C8_OFF_VF      C8_OFF_V(0xF)
+#define C8_OFF_I       ((int32_t)offsetof(struct c8_cpu, I))
+#define C8_OFF_PC      ((int32_t)offsetof(struct c8_cpu, pc))
+#define C8_OFF_DT      ((int32_t)offsetof(struct c8_cpu, delay_timer))
+#define C8_OFF_ST      ((int32_t)offsetof(struct c8_cpu, sound_timer))
+
+/* x86 register numbers for the ModRM reg field */
+#define C8_JIT_EAX (0)
+#define C8_JIT_ECX (1)
+
+static void emit8(
+    struct c8_jit* p_jit,
+    uint8_t        value)
+{
+    p_jit->p_code[p_jit->code_used++] = value;
+}
+
+static void emit16(
+    struct c8_jit* p_jit,
+    uint16_t       value)
+{
+    memcpy(&p_jit->p_code[p_jit->code_used], &value, sizeof(value));
+    p_jit->code_used += sizeof(value);
+}
+
+static void emit32(
+    struct c8_jit* p_jit,
+    uint32_t       value)
+{
+    memcpy(&p_jit->p_code[p_jit->code_used], &value, sizeof(value));
+    p_jit->code_used += sizeof(value);
+}
+
+static uint8_t* emit_pos(
+    struct c8_jit* p_jit)
+{
+    return &p_jit->p_code[p_jit->code_used];
+}
+
+/* <opcode> modrm [rbx + disp32] */
+static void emit_mem(
+    struct c8_jit* p_jit,
+    uint8_t        opcode,
+    uint8_t        reg,
+    int32_t        disp)
+{
+    emit8(p_jit, opcode);
+    emit8(p_jit, C8_JIT_MODRM_RBX(reg));
+    emit32(p_jit, (uint32_t)disp);
+}
+
+/* Point a rel32 field at p_target */
+static void patch_rel32(
+    int32_t*       p_rel,
+    const uint8_t* p_target)
+{
+    int32_t rel = (int32_t)(p_target - ((const uint8_t*)p_rel + 4));
+    memcpy(p_rel, &rel, sizeof(rel));
+}
+
+/* mov word [rbx + pc], target; jmp <block or exit> */
+static void emit_link(
+    struct c8_jit* p_jit,
+    uint16_t       target)
+{
+    int32_t* p_rel;
+
+    emit8(p_jit, 0x66);
+    emit_mem(p_jit, 0xC7, 0, C8_OFF_PC);
+    emit16(p_jit, target);
+
+    emit8(p_jit, 0xE9);
+    p_rel = (int32_t*)emit_pos(p_jit);
+    emit32(p_jit, 0);
+
+    if (target < C8_ARRAY_SIZE(p_jit->blocks) &&
+        NULL != p_jit->blocks[target])
+    {
+        patch_rel32(p_rel, p_jit->blocks[target]);
+    }
+    else
+    {
+        patch_rel32(p_rel, p_jit->p_exit);
+
+        if (p_jit->link_count < C8_JIT_MAX_LINKS)
+        {
+            p_jit->links[p_jit->link_count].p_rel = p_rel;
+            p_jit->links[p_jit->link_count].target = target;
+            p_jit->link_count++;
+        }
+    }
+}
+
+/* VX op= VY through al, optional carry/borrow into VF */
+static void emit_alu(
+    struct c8_jit* p_jit,
+    uint8_t        alu_opcode,
+    uint8_t        dst,
+    uint8_t        src,
+    int            set_vf)
+{
+    emit_mem(p_jit, 0x8A, C8_JIT_EAX, C8_OFF_V(dst));
+    emit_mem(p_jit, alu_opcode, C8_JIT_EAX, C8_OFF_V(src));
+
+    if (set_vf)
+    {
+        /* setc cl for add, setnc cl for sub */
+        emit8(p_jit, 0x0F);
+        emit8(p_jit, (0x02 == alu_opcode) ? 0x92 : 0x93);
+        emit8(p_jit, 0xC1);
+    }
+
+    emit_mem(p_jit, 0x88, C8_JIT_EAX, C8_OFF_V(dst));
+
+    if (set_vf)
+    {
+        emit_mem(p_jit, 0x88, C8_JIT_ECX, C8_OFF_VF);
+    }
+}
+
+/* VX = VX shifted by one, shifted out bit into VF */
+static void emit_shift(
+    struct c8_jit* p_jit,
+    uint8_t        x,
+    uint8_t        modrm)
+{
+    emit_mem(p_jit, 0x8A, C8_JIT_EAX, C8_OFF_V(x));
+    emit8(p_jit, 0xD0);
+    emit8(p_jit, modrm);
+    emit8(p_jit, 0x0F);
+    emit8(p_jit, 0x92);
+    emit8(p_jit, 0xC1);
+    emit_mem(p_jit, 0x88, C8_JIT_EAX, C8_OFF_V(x));
+    emit_mem(p_jit, 0x88, C8_JIT_ECX, C8_OFF_VF);
+}
+
+/* movzx eax, byte [VX]; mov word [rbx + disp], ax */
+static void emit_store_vx16(
+    struct c8_jit* p_jit,
+    uint8_t        x,
+    int32_t        disp)
+{
+    emit8(p_jit, 0x0F);
+    emit_mem(p_jit, 0xB6, C8_JIT_EAX, C8_OFF_V(x));
+    emit8(p_jit, 0x66);
+    emit_mem(p_jit, 0x89, C8_JIT_EAX, disp);
+}
+
+/* Conditional skip, jcc over the skip link to the fall through link */
+static void emit_skip(
+    struct c8_jit* p_jit,
+    uint8_t        jcc_noskip,
+    uint16_t       pc)
+{
+    uint8_t* p_rel8;
+    uint8_t* p_from;
+
+    emit8(p_jit, jcc_noskip);
+    p_rel8 = emit_pos(p_jit);
+    emit8(p_jit, 0);
+    p_from = emit_pos(p_jit);
+
+    emit_link(p_jit, pc + 4);
+    *p_rel8 = (uint8_t)(emit_pos(p_jit) - p_from);
+    emit_link(p_jit, pc + 2);
+}
+
+static void c8_jit_reset(
+    struct c8_jit* p_jit)
+{
+    p_jit->code_used = 0;
+    p_jit->link_count = 0;
+    memset(p_jit->blocks, 0x00, sizeof(p_jit->blocks));
+    memset(p_jit->flags, 0x00, sizeof(p_jit->flags));
+
+    /* Trampoline */
+    p_jit->p_enter = emit_pos(p_jit);
+    emit8(p_jit, 0x53);                                   /* push rbx      */
+    emit8(p_jit, 0x41); emit8(p_jit, 0x54);               /* push r12      */
+    emit8(p_jit, 0x55);                                   /* push rbp      */
+    emit8(p_jit, 0x48); emit8(p_jit, 0x89); emit8(p_jit, 0xFB); /* mov rbx, rdi  */
+    emit8(p_jit, 0x41); emit8(p_jit, 0x89); emit8(p_jit, 0xF4); /* mov r12d, esi */
+    emit8(p_jit, 0xFF); emit8(p_jit, 0xE2);               /* jmp rdx       */
+
+    p_jit->p_exit = emit_pos(p_jit);
+    emit8(p_jit, 0x44); emit8(p_jit, 0x89); emit8(p_jit, 0xE0); /* mov eax, r12d */
+    emit8(p_jit, 0x5D);                                   /* pop rbp       */
+    emit8(p_jit, 0x41); emit8(p_jit, 0x5C);               /* pop r12       */
+    emit8(p_jit, 0x5B);                                   /* pop rbx       */
+    emit8(p_jit, 0xC3);                                   /* ret           */
+}
+
+static uint8_t* c8_jit_compile(
+    struct c8_jit*       p_jit,
+    const struct c8_cpu* p_cpu,
+    uint16_t             start)
+{
+    uint32_t links_before;
+    uint8_t* p_block;
+    uint8_t* p_len;
+    uint32_t count = 0;
+    uint16_t pc = start;
+    uint16_t op;
+    enum c8_op id;
+    uint8_t x, y, nn;
+    uint32_t i;
+    int done = C8_FALSE;
+
+    if (p_jit->code_used + C8_JIT_MAX_BLOCK_SIZE > C8_JIT_CODE_SIZE)
+    {
+        c8_jit_reset(p_jit);
+    }
+
+    p_block = emit_pos(p_jit);
+    links_before = p_jit->link_count;
+
+    /* cmp r12d, count; jb exit; sub r12d, count */
+    emit8(p_jit, 0x41); emit8(p_jit, 0x81); emit8(p_jit, 0xFC);
+    p_len = emit_pos(p_jit);
+    emit32(p_jit, 0);
+    emit8(p_jit, 0x0F); emit8(p_jit, 0x82);
+    emit32(p_jit, 0);
+    patch_rel32((int32_t*)(emit_pos(p_jit) - 4), p_jit->p_exit);
+    emit8(p_jit, 0x41); emit8(p_jit, 0x81); emit8(p_jit, 0xEC);
+    emit32(p_jit, 0);
+
+    while (C8_FALSE == done)
+    {
+        if (count == C8_JIT_MAX_BLOCK_OPS ||
+            pc >= p_cpu->pc_max ||
+            pc + 1 >= (int)sizeof(p_cpu->ram))
+        {
+            emit_link(p_jit, pc);
+            break;
+        }
+
+        op = (p_cpu->ram[pc] << 8) | p_cpu->ram[pc + 1];
+        id = c8_decode_op(op);
+        x = (op >> 8) & 0xF;
+        y = (op >> 4) & 0xF;
+        nn = op & 0xFF;
+
+        switch (id)
+        {
+        case C8_OP_SYS:
+            break;
+
+        case C8_OP_LD_IMM:
+            emit_mem(p_jit, 0xC6, 0, C8_OFF_V(x));
+            emit8(p_jit, nn);
+            break;
+
+        case C8_OP_ADD_IMM:
+            emit_mem(p_jit, 0x80, 0, C8_OFF_V(x));
+            emit8(p_jit, nn);
+            break;
+
+        case C8_OP_LD_REG:
+            emit_mem(p_jit, 0x8A, C8_JIT_EAX, C8_OFF_V(y));
+            emit_mem(p_jit, 0x88, C8_JIT_EAX, C8_OFF_V(x));
+            break;
+
+        case C8_OP_OR:      emit_alu(p_jit, 0x0A, x, y, C8_FALSE); break;
+        case C8_OP_AND:     emit_alu(p_jit, 0x22, x, y, C8_FALSE); break;
+        case C8_OP_XOR:     emit_alu(p_jit, 0x32, x, y, C8_FALSE); break;
+        case C8_OP_ADD_REG: emit_alu(p_jit, 0x02, x, y, C8_TRUE);  break;
+        case C8_OP_SUB:     emit_alu(p_jit, 0x2A, x, y, C8_TRUE);  break;
+
+        case C8_OP_SUBN:
+            /* VX = VY - VX, VF = no borrow */
+            emit_mem(p_jit, 0x8A, C8_JIT_EAX, C8_OFF_V(y));
+            emit_mem(p_jit, 0x2A, C8_JIT_EAX, C8_OFF_V(x));
+            emit8(p_jit, 0x0F); emit8(p_jit, 0x93); emit8(p_jit, 0xC1);
+            emit_mem(p_jit, 0x88, C8_JIT_EAX, C8_OFF_V(x));
+            emit_mem(p_jit, 0x88, C8_JIT_ECX, C8_OFF_VF);
+            break;
+
+        case C8_OP_SHR: emit_shift(p_jit, x, 0xE8); break;
+        case C8_OP_SHL: emit_shift(p_jit, x, 0xE0); break;
+
+        case C8_OP_LD_I:
+            emit8(p_jit, 0x66);
+            emit_mem(p_jit, 0xC7, 0, C8_OFF_I);
+            emit16(p_jit, op & 0x0FFF);
+            break;
+
+        case C8_OP_ADD_I:
+            emit8(p_jit, 0x0F);
+            emit_mem(p_jit, 0xB6, C8_JIT_EAX, C8_OFF_V(x));
+            emit8(p_jit, 0x66);
+            emit_mem(p_jit, 0x01, C8_JIT_EAX, C8_OFF_I);
+            break;
+
+        case C8_OP_LD_F:
+            /* I = VX * 5 */
+            emit8(p_jit, 0x0F);
+            emit_mem(p_jit, 0xB6, C8_JIT_EAX, C8_OFF_V(x));
+            emit8(p_jit, 0x8D); emit8(p_jit, 0x04); emit8(p_jit, 0x80);
+            emit8(p_jit, 0x66);
+            emit_mem(p_jit, 0x89, C8_JIT_EAX, C8_OFF_I);
+            break;
+
+        case C8_OP_LD_VX_DT:
+            emit_mem(p_jit, 0x8A, C8_JIT_EAX, C8_OFF_DT);
+            emit_mem(p_jit, 0x88, C8_JIT_EAX, C8_OFF_V(x));
+            break;
+
+        case C8_OP_LD_DT_VX: emit_store_vx16(p_jit, x, C8_OFF_DT); break;
+        case C8_OP_LD_ST_VX: emit_store_vx16(p_jit, x, C8_OFF_ST); break;
+
+        case C8_OP_JP:
+            emit_link(p_jit, op & 0x0FFF);
+            done = C8_TRUE;
+            break;
+
+        case C8_OP_SE_IMM:
+        case C8_OP_SNE_IMM:
+            emit_mem(p_jit, 0x80, 7, C8_OFF_V(x));
+            emit8(p_jit, nn);
+            emit_skip(p_jit, (C8_OP_SE_IMM == id) ? 0x75 : 0x74, pc);
+            done = C8_TRUE;
+            break;
+
+        case C8_OP_SE_REG:
+        case C8_OP_SNE_REG:
+            emit_mem(p_jit, 0x8A, C8_JIT_EAX, C8_OFF_V(x));
+            emit_mem(p_jit, 0x3A, C8_JIT_EAX, C8_OFF_V(y));
+            emit_skip(p_jit, (C8_OP_SE_REG == id) ? 0x75 : 0x74, pc);
+            done = C8_TRUE;
+            break;
+
+        default:
+            /* Left to the interpreter, the block ends in front of it */
+            emit_link(p_jit, pc);
+            done = C8_TRUE;
+            continue;
+        }
+
+        pc += 2;
+        count++;
+    }
+
+    if (0 == count)
+    {
+        /* Nothing to compile, drop the code and remember */
+        p_jit->code_used = (size_t)(p_block - p_jit->p_code);
+        p_jit->link_count = links_before;
+        p_jit->flags[start] |= C8_JIT_NO_BLOCK;
+        return NULL;
+    }
+
+    /* Immediates of the cmp and the sub (past the 6 byte jb and sub opcode) */
+    memcpy(p_len, &count, sizeof(count));
+    memcpy(p_len + 4 + 6 + 3, &count, sizeof(count));
+
+    for (i = start; i < pc && i < C8_ARRAY_SIZE(p_jit->flags); i++)
+    {
+        p_jit->flags[i] |= C8_JIT_CODE;
+    }
+
+    p_jit->blocks[start] = p_block;
+
+    /* Chain earlier blocks that exit to this one */
+    for (i = 0; i < p_jit->link_count; )
+    {
+        if (p_jit->links[i].target == start)
+        {
+            patch_rel32(p_jit->links[i].p_rel, p_block);
+            p_jit->links[i] = p_jit->links[--p_jit->link_count];
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    return p_block;
+}
+
+static int c8_jit_interpret(
+    struct c8_jit* p_jit,
+    struct c8_cpu* p_cpu)
+{
+    uint32_t addr = p_cpu->I;
+    uint32_t size = 0;
+    uint32_t i;
+    uint16_t op;
+    int result;
+
+    if (p_cpu->pc + 1 < (int)sizeof(p_cpu->ram))
+    {
+        op = (p_cpu->ram[p_cpu->pc] << 8) | p_cpu->ram[p_cpu->pc + 1];
+
+        switch (c8_decode_op(op))
+        {
+        case C8_OP_LD_B:      size = 3; break;
+        case C8_OP_LD_MEM_VX: size = ((op >> 8) & 0xF) + 1; break;
+        default: break;
+        }
+    }
+
+    result = c8_step(p_cpu);
+
+    /* Self modifying code, drop everything if compiled bytes changed */
+    for (i = addr; i < addr + size && i < C8_ARRAY_SIZE(p_jit->flags); i++)
+    {
+        if (p_jit->flags[i] & C8_JIT_CODE)
+        {
+            c8_jit_reset(p_jit);
+            break;
+        }
+    }
+
+    return result;
+}
+
+#else /* !C8_JIT_SUPPORTED */
+
+struct c8_jit* c8_jit_create(void)
+{
+    return NULL;
+}
+
+void c8_jit_destroy(
+    struct c8_jit* p_jit)
+{
+    (void)p_jit;
+}
+
+void c8_jit_flush(
+    struct c8_jit* p_jit)
+{
+    (void)p_jit;
+}
+
+int c8_jit_run(
+    struct c8_jit* p_jit,
+    struct c8_cpu* p_cpu,
+    uint32_t       budget)
+{
+    (void)p_jit;
+
+    while (budget-- > 0)
+    {
+        if (C8_FALSE == c8_step(p_cpu))
+        {
+            return C8_FALSE;
+        }
+    }
+
+    return C8_TRUE;
+}
+
+#endif /* C8_JIT_SUPPORTED */
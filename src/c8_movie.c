@@ -0,0 +1,323 @@
+#include "c8_movie.h"
+#include "c8_bytes.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* --- Local Function Declarations --- */
+
+static uint64_t c8_movie_fnv_value(
+    uint64_t hash,
+    uint64_t value,
+    int      bytes);
+
+static uint16_t c8_movie_keys(
+    const struct c8_cpu* p_cpu);
+
+/* --- Function Definitions --- */
+
+struct c8_movie* c8_movie_create(
+    const struct c8_cpu* p_cpu,
+    uint64_t             seed,
+    uint32_t             ips)
+{
+    struct c8_movie* p_movie = calloc(1, sizeof(*p_movie));
+
+    if (NULL == p_movie)
+    {
+        return NULL;
+    }
+
+    p_movie->ips = ips;
+    p_movie->seed = seed;
+    p_movie->rom_hash = c8_movie_hash_rom(p_cpu);
+    p_movie->state_hash = c8_movie_hash_state(p_cpu);
+
+    return p_movie;
+}
+
+void c8_movie_destroy(
+    struct c8_movie* p_movie)
+{
+    if (NULL == p_movie)
+    {
+        return;
+    }
+
+    free(p_movie->p_events);
+    free(p_movie);
+}
+
+int c8_movie_record(
+    struct c8_movie*     p_movie,
+    const struct c8_cpu* p_cpu)
+{
+    const uint16_t keys = c8_movie_keys(p_cpu);
+    struct c8_movie_event* p_event = NULL;
+    struct c8_movie_event* p_events;
+    uint32_t capacity;
+
+    if (0 != p_movie->event_count)
+    {
+        p_event = &p_movie->p_events[p_movie->event_count - 1];
+    }
+
+    /* Same keys as the frame before, extend the run */
+    if (NULL != p_event && keys == p_event->keys && UINT32_MAX != p_event->frames)
+    {
+        p_event->frames++;
+        p_movie->frames++;
+        return C8_TRUE;
+    }
+
+    if (p_movie->event_count == p_movie->event_capacity)
+    {
+        capacity = (0 != p_movie->event_capacity) ? p_movie->event_capacity * 2 : 256;
+        p_events = realloc(p_movie->p_events, sizeof(*p_events) * capacity);
+
+        if (NULL == p_events)
+        {
+            return C8_FALSE;
+        }
+
+        p_movie->p_events = p_events;
+        p_movie->event_capacity = capacity;
+    }
+
+    p_event = &p_movie->p_events[p_movie->event_count++];
+    p_event->frames = 1;
+    p_event->keys = keys;
+    p_movie->frames++;
+
+    return C8_TRUE;
+}
+
+void c8_movie_finish(
+    struct c8_movie*     p_movie,
+    const struct c8_cpu* p_cpu)
+{
+    p_movie->state_hash = c8_movie_hash_state(p_cpu);
+}
+
+int c8_movie_save(
+    const struct c8_movie* p_movie,
+    const char*            p_path)
+{
+    const size_t size = C8_MOVIE_HEADER_SIZE + (size_t)C8_MOVIE_EVENT_SIZE * p_movie->event_count;
+    uint8_t* p_buffer = malloc(size);
+    uint8_t* p_out = p_buffer;
+    FILE* f;
+    uint32_t i;
+    int result = C8_FALSE;
+
+    if (NULL == p_buffer)
+    {
+        return C8_FALSE;
+    }
+
+    memcpy(p_out, C8_MOVIE_MAGIC, 4);
+    p_out += 4;
+    p_out = c8_put_le(p_out, C8_MOVIE_VERSION, 2);
+    p_out = c8_put_le(p_out, C8_MOVIE_EVENT_SIZE, 2);
+    p_out = c8_put_le(p_out, p_movie->ips, 4);
+    p_out = c8_put_le(p_out, p_movie->event_count, 4);
+    p_out = c8_put_le(p_out, p_movie->seed, 8);
+    p_out = c8_put_le(p_out, p_movie->rom_hash, 8);
+    p_out = c8_put_le(p_out, p_movie->frames, 8);
+    p_out = c8_put_le(p_out, p_movie->state_hash, 8);
+
+    for (i = 0; i < p_movie->event_count; i++)
+    {
+        p_out = c8_put_le(p_out, p_movie->p_events[i].frames, 4);
+        p_out = c8_put_le(p_out, p_movie->p_events[i].keys, 2);
+    }
+
+    f = fopen(p_path, "wb");
+
+    if (NULL != f)
+    {
+        result = (size == fwrite(p_buffer, 1, size, f));
+        result = (0 == fclose(f)) && result;
+    }
+
+    free(p_buffer);
+
+    return result ? C8_TRUE : C8_FALSE;
+}
+
+struct c8_movie* c8_movie_load(
+    const char* p_path)
+{
+    uint8_t header[C8_MOVIE_HEADER_SIZE];
+    uint8_t event[C8_MOVIE_EVENT_SIZE];
+    struct c8_movie* p_movie;
+    uint64_t frames = 0;
+    uint32_t count;
+    uint32_t i;
+    FILE* f = fopen(p_path, "rb");
+
+    if (NULL == f)
+    {
+        return NULL;
+    }
+
+    if (sizeof(header) != fread(header, 1, sizeof(header), f) ||
+        0 != memcmp(header, C8_MOVIE_MAGIC, 4) ||
+        C8_MOVIE_VERSION != c8_get_le(&header[4], 2) ||
+        C8_MOVIE_EVENT_SIZE != c8_get_le(&header[6], 2))
+    {
+        fclose(f);
+        return NULL;
+    }
+
+    count = (uint32_t)c8_get_le(&header[12], 4);
+    p_movie = calloc(1, sizeof(*p_movie));
+
+    if (NULL != p_movie)
+    {
+        p_movie->p_events = malloc(sizeof(*p_movie->p_events) * (count + 1));
+    }
+
+    if (NULL == p_movie || NULL == p_movie->p_events)
+    {
+        c8_movie_destroy(p_movie);
+        fclose(f);
+        return NULL;
+    }
+
+    p_movie->ips = (uint32_t)c8_get_le(&header[8], 4);
+    p_movie->seed = c8_get_le(&header[16], 8);
+    p_movie->rom_hash = c8_get_le(&header[24], 8);
+    p_movie->frames = c8_get_le(&header[32], 8);
+    p_movie->state_hash = c8_get_le(&header[40], 8);
+    p_movie->event_count = count;
+    p_movie->event_capacity = count + 1;
+
+    for (i = 0; i < count; i++)
+    {
+        if (sizeof(event) != fread(event, 1, sizeof(event), f))
+        {
+            break;
+        }
+
+        p_movie->p_events[i].frames = (uint32_t)c8_get_le(&event[0], 4);
+        p_movie->p_events[i].keys = (uint16_t)c8_get_le(&event[4], 2);
+        frames += p_movie->p_events[i].frames;
+    }
+
+    fclose(f);
+
+    /* Truncated, or the runs do not add up to the frame count */
+    if (i != count || frames != p_movie->frames || 0 == p_movie->ips)
+    {
+        c8_movie_destroy(p_movie);
+        return NULL;
+    }
+
+    return p_movie;
+}
+
+void c8_movie_rewind(
+    struct c8_movie* p_movie)
+{
+    p_movie->play_event = 0;
+    p_movie->play_frame = 0;
+}
+
+int c8_movie_next(
+    struct c8_movie* p_movie,
+    struct c8_cpu*   p_cpu)
+{
+    const struct c8_movie_event* p_event;
+    int i;
+
+    if (p_movie->play_event >= p_movie->event_count)
+    {
+        return C8_FALSE;
+    }
+
+    p_event = &p_movie->p_events[p_movie->play_event];
+
+    for (i = 0; i < 16; i++)
+    {
+        p_cpu->keyboard[i] = (p_event->keys >> i) & 1;
+    }
+
+    if (++p_movie->play_frame >= p_event->frames)
+    {
+        p_movie->play_event++;
+        p_movie->play_frame = 0;
+    }
+
+    return C8_TRUE;
+}
+
+uint64_t c8_movie_hash_rom(
+    const struct c8_cpu* p_cpu)
+{
+    const uint32_t end = (p_cpu->pc_max < sizeof(p_cpu->ram)) ? p_cpu->pc_max : sizeof(p_cpu->ram);
+
+    if (end <= C8_PROGRAM_START_ADDR)
+    {
+        return C8_FNV_OFFSET;
+    }
+
+    return c8_fnv(C8_FNV_OFFSET, &p_cpu->ram[C8_PROGRAM_START_ADDR],
+                  end - C8_PROGRAM_START_ADDR);
+}
+
+uint64_t c8_movie_hash_state(
+    const struct c8_cpu* p_cpu)
+{
+    uint64_t hash = C8_FNV_OFFSET;
+    int i;
+
+    /* Field by field, padding and host byte order stay out of the hash */
+    hash = c8_fnv(hash, p_cpu->ram, sizeof(p_cpu->ram));
+    hash = c8_fnv(hash, p_cpu->V, sizeof(p_cpu->V));
+    hash = c8_fnv(hash, p_cpu->flags, sizeof(p_cpu->flags));
+    hash = c8_movie_fnv_value(hash, p_cpu->I, 2);
+    hash = c8_movie_fnv_value(hash, p_cpu->pc, 2);
+    hash = c8_movie_fnv_value(hash, p_cpu->sp, 1);
+
+    for (i = 0; i < 16; i++)
+    {
+        hash = c8_movie_fnv_value(hash, p_cpu->stack[i], 2);
+    }
+
+    hash = c8_movie_fnv_value(hash, p_cpu->delay_timer, 2);
+    hash = c8_movie_fnv_value(hash, p_cpu->sound_timer, 2);
+    hash = c8_movie_fnv_value(hash, p_cpu->rng_state, 8);
+
+    return c8_movie_fnv_value(hash, c8_hash_screen(p_cpu), 8);
+}
+
+/* --- Local Function Definitions --- */
+
+static uint64_t c8_movie_fnv_value(
+    uint64_t hash,
+    uint64_t value,
+    int      bytes)
+{
+    uint8_t data[8];
+
+    c8_put_le(data, value, bytes);
+
+    return c8_fnv(hash, data, (size_t)bytes);
+}
+
+static uint16_t c8_movie_keys(
+    const struct c8_cpu* p_cpu)
+{
+    uint16_t keys = 0;
+    int i;
+
+    for (i = 0; i < 16; i++)
+    {
+        keys |= (uint16_t)((0 != p_cpu->keyboard[i]) << i);
+    }
+
+    return keys;
+}
+
@@ -0,0 +1,211 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include "c8_pacer.h"
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#define C8_PACER_NS_PER_SECOND (1000000000ull)
+
+/* --- Local Function Declarations --- */
+
+static uint64_t c8_pacer_now(
+    void);
+
+static void c8_pacer_sleep_until(
+    uint64_t deadline_ns);
+
+static void c8_pacer_update_batch(
+    struct c8_pacer* p_pacer,
+    uint64_t         now);
+
+/* --- Function Definitions --- */
+
+void c8_pacer_init(
+    struct c8_pacer* p_pacer,
+    uint32_t         ips)
+{
+    memset(p_pacer, 0x00, sizeof(*p_pacer));
+
+    p_pacer->period_ns = C8_PACER_NS_PER_SECOND / C8_PACER_HZ;
+    p_pacer->ips = (0 != ips) ? ips : 1;
+    p_pacer->last_ns = c8_pacer_now();
+    p_pacer->deadline_ns = p_pacer->last_ns + p_pacer->period_ns;
+    p_pacer->turbo = C8_FALSE;
+    p_pacer->turbo_batch = 1;
+}
+
+void c8_pacer_restart(
+    struct c8_pacer* p_pacer)
+{
+    p_pacer->last_ns = c8_pacer_now();
+    p_pacer->deadline_ns = p_pacer->last_ns + p_pacer->period_ns;
+}
+
+void c8_pacer_set_turbo(
+    struct c8_pacer* p_pacer,
+    int              turbo)
+{
+    if (turbo == p_pacer->turbo)
+    {
+        return;
+    }
+
+    p_pacer->turbo = turbo;
+    p_pacer->turbo_batch = 1;
+    p_pacer->batch_start = p_pacer->frame;
+
+    if (C8_FALSE == turbo)
+    {
+        /* Frames run ahead are not owed back */
+        c8_pacer_restart(p_pacer);
+    }
+}
+
+uint32_t c8_pacer_budget(
+    struct c8_pacer* p_pacer)
+{
+    const uint64_t frame = p_pacer->frame++;
+
+    return (uint32_t)(((frame + 1) * p_pacer->ips) / C8_PACER_HZ -
+                      (frame * p_pacer->ips) / C8_PACER_HZ);
+}
+
+uint32_t c8_pacer_wait(
+    struct c8_pacer* p_pacer)
+{
+    struct c8_pacer_stats* p_stats = &p_pacer->stats;
+    uint64_t now = c8_pacer_now();
+    uint64_t frames;
+    uint64_t late;
+    uint64_t interval;
+    uint64_t jitter;
+
+    if (C8_TRUE == p_pacer->turbo)
+    {
+        c8_pacer_update_batch(p_pacer, now);
+    }
+
+    if (now < p_pacer->deadline_ns)
+    {
+        c8_pacer_sleep_until(p_pacer->deadline_ns);
+        now = c8_pacer_now();
+    }
+
+    /* Every deadline that has passed is a frame to run */
+    late = (now > p_pacer->deadline_ns) ? now - p_pacer->deadline_ns : 0;
+    frames = 1 + late / p_pacer->period_ns;
+
+    if (C8_TRUE == p_pacer->turbo)
+    {
+        /* Display rate only, a late period is not made up */
+        p_stats->turbo_frames += p_pacer->frame - p_pacer->batch_start;
+        p_pacer->batch_start = p_pacer->frame;
+        p_pacer->deadline_ns = (frames > 1) ? now + p_pacer->period_ns :
+                               p_pacer->deadline_ns + p_pacer->period_ns;
+        frames = p_pacer->turbo_batch;
+    }
+    else if (frames > C8_PACER_MAX_CATCH_UP)
+    {
+        /* Too far behind, skip ahead instead of running in a burst */
+        p_stats->dropped += frames - C8_PACER_MAX_CATCH_UP;
+        frames = C8_PACER_MAX_CATCH_UP;
+        p_pacer->deadline_ns = now + p_pacer->period_ns;
+    }
+    else
+    {
+        p_pacer->deadline_ns += frames * p_pacer->period_ns;
+    }
+
+    interval = now - p_pacer->last_ns;
+    jitter = (interval > p_pacer->period_ns) ?
+             interval - p_pacer->period_ns : p_pacer->period_ns - interval;
+    p_pacer->last_ns = now;
+
+    p_stats->frames++;
+
+    if (C8_FALSE == p_pacer->turbo)
+    {
+        p_stats->caught_up += frames - 1;
+    }
+
+    p_stats->late_ns_total += late;
+    p_stats->jitter_ns_total += jitter;
+
+    if (late > p_stats->late_ns_max)
+    {
+        p_stats->late_ns_max = late;
+    }
+
+    if (jitter > p_stats->jitter_ns_max)
+    {
+        p_stats->jitter_ns_max = jitter;
+    }
+
+    return (uint32_t)frames;
+}
+
+/* --- Local Function Definitions --- */
+
+static uint64_t c8_pacer_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * C8_PACER_NS_PER_SECOND + (uint64_t)ts.tv_nsec;
+}
+
+static void c8_pacer_sleep_until(
+    uint64_t deadline_ns)
+{
+    struct timespec ts;
+
+    ts.tv_sec = (time_t)(deadline_ns / C8_PACER_NS_PER_SECOND);
+    ts.tv_nsec = (long)(deadline_ns % C8_PACER_NS_PER_SECOND);
+
+    /* Absolute deadline, EINTR restarts the sleep to the same deadline
+     * so a signal adds no drift
+     */
+    while (EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL))
+    {
+    }
+}
+
+static void c8_pacer_update_batch(
+    struct c8_pacer* p_pacer,
+    uint64_t         now)
+{
+    const uint64_t ran = p_pacer->frame - p_pacer->batch_start;
+    const uint64_t busy = now - p_pacer->last_ns;
+    uint64_t batch;
+
+    /* Nothing emulated, e.g. while rewinding, says nothing about speed */
+    if (0 == ran || 0 == busy)
+    {
+        return;
+    }
+
+    /* Frames that would have filled the period, at most doubling or
+       halving per period so a slow draw does not swing the batch */
+    batch = ran * p_pacer->period_ns / busy;
+
+    if (batch > ran * 2)
+    {
+        batch = ran * 2;
+    }
+    else if (batch < ran / 2)
+    {
+        batch = ran / 2;
+    }
+
+    if (batch < 1)
+    {
+        batch = 1;
+    }
+    else if (batch > C8_PACER_MAX_TURBO)
+    {
+        batch = C8_PACER_MAX_TURBO;
+    }
+
+    p_pacer->turbo_batch = (uint32_t)batch;
+}
@@ -0,0 +1,271 @@
+#include "c8_profile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Addresses listed in the text report, JSON lists all */
+#define C8_PROFILE_TOP_ADDRESSES (32)
+
+/**
+ * One row of a report section, sorted by count.
+ */
+struct c8_profile_row {
+    uint32_t key;
+    uint64_t count;
+};
+
+/* --- Local Function Declarations --- */
+
+static uint32_t c8_profile_rows(
+    const uint64_t*        p_counts,
+    uint32_t               size,
+    struct c8_profile_row* p_rows);
+
+static int c8_profile_compare(
+    const void* p_a,
+    const void* p_b);
+
+static double c8_profile_percent(
+    uint64_t part,
+    uint64_t total);
+
+static void c8_profile_write_text(
+    const struct c8_profile* p_profile,
+    FILE*                    p_file,
+    struct c8_profile_row*   p_rows);
+
+static void c8_profile_write_json(
+    const struct c8_profile* p_profile,
+    FILE*                    p_file,
+    struct c8_profile_row*   p_rows);
+
+/* --- Function Definitions --- */
+
+struct c8_profile* c8_profile_create(void)
+{
+    return calloc(1, sizeof(struct c8_profile));
+}
+
+void c8_profile_destroy(
+    struct c8_profile* p_profile)
+{
+    free(p_profile);
+}
+
+int c8_profile_attach(
+    struct c8_cpu*     p_cpu,
+    struct c8_profile* p_profile)
+{
+#if C8_PROFILE
+    p_cpu->p_profile = p_profile;
+    return C8_TRUE;
+#else
+    (void)p_cpu;
+    return (NULL == p_profile) ? C8_TRUE : C8_FALSE;
+#endif
+}
+
+int c8_profile_write(
+    const struct c8_profile* p_profile,
+    const char*              p_path)
+{
+    const size_t length = strlen(p_path);
+    struct c8_profile_row* p_rows;
+    FILE* p_file;
+    int result;
+
+    /* Largest section is the address table */
+    p_rows = malloc(sizeof(*p_rows) * C8_ARRAY_SIZE(p_profile->pc));
+
+    if (NULL == p_rows)
+    {
+        return C8_FALSE;
+    }
+
+    p_file = (0 == strcmp(p_path, "-")) ? stdout : fopen(p_path, "w");
+
+    if (NULL == p_file)
+    {
+        free(p_rows);
+        return C8_FALSE;
+    }
+
+    if (length > 5 && 0 == strcmp(&p_path[length - 5], ".json"))
+    {
+        c8_profile_write_json(p_profile, p_file, p_rows);
+    }
+    else
+    {
+        c8_profile_write_text(p_profile, p_file, p_rows);
+    }
+
+    result = (0 == ferror(p_file)) ? C8_TRUE : C8_FALSE;
+
+    if (stdout == p_file)
+    {
+        fflush(p_file);
+    }
+    else if (0 != fclose(p_file))
+    {
+        result = C8_FALSE;
+    }
+
+    free(p_rows);
+
+    return result;
+}
+
+/* --- Local Function Definitions --- */
+
+/**
+ * Collect the non-zero counts and sort them, highest first.
+ */
+static uint32_t c8_profile_rows(
+    const uint64_t*        p_counts,
+    uint32_t               size,
+    struct c8_profile_row* p_rows)
+{
+    uint32_t count = 0;
+    uint32_t i;
+
+    for (i = 0; i < size; i++)
+    {
+        if (0 != p_counts[i])
+        {
+            p_rows[count].key = i;
+            p_rows[count].count = p_counts[i];
+            count++;
+        }
+    }
+
+    qsort(p_rows, count, sizeof(*p_rows), c8_profile_compare);
+
+    return count;
+}
+
+static int c8_profile_compare(
+    const void* p_a,
+    const void* p_b)
+{
+    const struct c8_profile_row* p_row_a = p_a;
+    const struct c8_profile_row* p_row_b = p_b;
+
+    if (p_row_a->count != p_row_b->count)
+    {
+        return (p_row_a->count > p_row_b->count) ? -1 : 1;
+    }
+
+    /* Ties in address order, the output does not depend on qsort */
+    return (p_row_a->key < p_row_b->key) ? -1 : (p_row_a->key > p_row_b->key);
+}
+
+static double c8_profile_percent(
+    uint64_t part,
+    uint64_t total)
+{
+    return (0 != total) ? 100.0 * (double)part / (double)total : 0.0;
+}
+
+static void c8_profile_write_text(
+    const struct c8_profile* p_profile,
+    FILE*                    p_file,
+    struct c8_profile_row*   p_rows)
+{
+    const uint64_t total = p_profile->instructions;
+    uint32_t count;
+    uint32_t i;
+
+    fprintf(p_file, "instructions: %"PRIu64"\n\n", total);
+
+    fprintf(p_file, "opcodes:\n");
+    count = c8_profile_rows(p_profile->ops, C8_OP_COUNT, p_rows);
+
+    for (i = 0; i < count; i++)
+    {
+        fprintf(p_file, "  %-12s %14"PRIu64"  %6.2f%%\n",
+                c8_op_name((enum c8_op)p_rows[i].key),
+                p_rows[i].count,
+                c8_profile_percent(p_rows[i].count, total));
+    }
+
+    fprintf(p_file, "\nhot addresses:\n");
+    count = c8_profile_rows(p_profile->pc, C8_ARRAY_SIZE(p_profile->pc), p_rows);
+
+    for (i = 0; i < count && i < C8_PROFILE_TOP_ADDRESSES; i++)
+    {
+        fprintf(p_file, "  0x%03"PRIX32"  %-12s %14"PRIu64"  %6.2f%%\n",
+                p_rows[i].key,
+                c8_op_name((enum c8_op)p_profile->pc_op[p_rows[i].key]),
+                p_rows[i].count,
+                c8_profile_percent(p_rows[i].count, total));
+    }
+
+    fprintf(p_file, "\ndraw: %"PRIu64" DXYN, %"PRIu64" ticks, %.1f ticks/draw\n",
+            p_profile->draws, p_profile->draw_ticks,
+            (0 != p_profile->draws) ? (double)p_profile->draw_ticks / (double)p_profile->draws : 0.0);
+
+    fprintf(p_file, "\nsubroutines (inclusive):\n");
+    count = c8_profile_rows(p_profile->inclusive, C8_ARRAY_SIZE(p_profile->inclusive), p_rows);
+
+    for (i = 0; i < count; i++)
+    {
+        fprintf(p_file, "  0x%03"PRIX32"  %10"PRIu64" calls %14"PRIu64"  %6.2f%%  %10.1f/call\n",
+                p_rows[i].key,
+                p_profile->calls[p_rows[i].key],
+                p_rows[i].count,
+                c8_profile_percent(p_rows[i].count, total),
+                (double)p_rows[i].count / (double)p_profile->calls[p_rows[i].key]);
+    }
+}
+
+static void c8_profile_write_json(
+    const struct c8_profile* p_profile,
+    FILE*                    p_file,
+    struct c8_profile_row*   p_rows)
+{
+    uint32_t count;
+    uint32_t i;
+
+    fprintf(p_file, "{\n  \"instructions\": %"PRIu64",\n", p_profile->instructions);
+
+    fprintf(p_file, "  \"opcodes\": [");
+    count = c8_profile_rows(p_profile->ops, C8_OP_COUNT, p_rows);
+
+    for (i = 0; i < count; i++)
+    {
+        fprintf(p_file, "%s\n    { \"op\": \"%s\", \"count\": %"PRIu64" }",
+                (0 == i) ? "" : ",",
+                c8_op_name((enum c8_op)p_rows[i].key),
+                p_rows[i].count);
+    }
+
+    fprintf(p_file, "\n  ],\n  \"addresses\": [");
+    count = c8_profile_rows(p_profile->pc, C8_ARRAY_SIZE(p_profile->pc), p_rows);
+
+    for (i = 0; i < count; i++)
+    {
+        fprintf(p_file, "%s\n    { \"pc\": %"PRIu32", \"op\": \"%s\", \"count\": %"PRIu64" }",
+                (0 == i) ? "" : ",",
+                p_rows[i].key,
+                c8_op_name((enum c8_op)p_profile->pc_op[p_rows[i].key]),
+                p_rows[i].count);
+    }
+
+    fprintf(p_file, "\n  ],\n  \"draw\": { \"count\": %"PRIu64", \"ticks\": %"PRIu64" },\n",
+            p_profile->draws, p_profile->draw_ticks);
+
+    fprintf(p_file, "  \"subroutines\": [");
+    count = c8_profile_rows(p_profile->inclusive, C8_ARRAY_SIZE(p_profile->inclusive), p_rows);
+
+    for (i = 0; i < count; i++)
+    {
+        fprintf(p_file, "%s\n    { \"entry\": %"PRIu32", \"calls\": %"PRIu64", \"inclusive\": %"PRIu64" }",
+                (0 == i) ? "" : ",",
+                p_rows[i].key,
+                p_profile->calls[p_rows[i].key],
+                p_rows[i].count);
+    }
+
+    fprintf(p_file, "\n  ]\n}\n");
+}
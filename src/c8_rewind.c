@@ -0,0 +1,405 @@
+#include "c8_rewind.h"
+#include "c8_cpu.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Bytes per run header. Changes closer than this share a run. */
+#define C8_REWIND_RUN_HEADER (4)
+
+/**
+ * State recorded per frame, laid out without padding so that it can be
+ * XORed as plain bytes.
+ */
+struct c8_rewind_state {
+    uint8_t  ram[4096];
+    uint64_t screen[C8_SCREEN_HIRES_H][C8_SCREEN_WORDS];
+    uint64_t rng_state;
+    uint16_t stack[16];
+    uint16_t pc;
+    uint16_t pc_max;
+    uint16_t I;
+    uint16_t delay_timer;
+    uint16_t sound_timer;
+    uint16_t screen_w;
+    uint16_t screen_h;
+    uint8_t  V[16];
+    uint8_t  flags[16];
+    uint8_t  sp;
+    uint8_t  screen_is_dirty;
+};
+
+#define C8_REWIND_STATE_SIZE (sizeof(struct c8_rewind_state))
+
+/* Largest encoded frame, see c8_rewind_encode */
+#define C8_REWIND_MAX_FRAME (C8_REWIND_STATE_SIZE + C8_REWIND_RUN_HEADER)
+
+/* Location of an encoded frame in the byte ring */
+struct c8_rewind_entry {
+    uint32_t offset;
+    uint32_t size;
+};
+
+struct c8_rewind {
+    /* Newest state, valid once has_latest is set */
+    struct c8_rewind_state latest;
+    struct c8_rewind_state next;
+    int                    has_latest;
+
+    /* Ring of frames, oldest at first */
+    struct c8_rewind_entry* p_entries;
+    uint32_t                max_entries;
+    uint32_t                first;
+    uint32_t                count;
+
+    /* Ring of encoded bytes */
+    uint8_t*                p_data;
+    uint32_t                capacity;
+    uint32_t                used;
+
+    uint8_t                 scratch[C8_REWIND_MAX_FRAME];
+};
+
+/* --- Local Function Declarations --- */
+
+static void c8_rewind_capture(
+    const struct c8_cpu*    p_cpu,
+    struct c8_rewind_state* p_state);
+
+static uint32_t c8_rewind_encode(
+    const uint8_t* p_a,
+    const uint8_t* p_b,
+    uint8_t*       p_out);
+
+static void c8_rewind_apply(
+    uint8_t*       p_state,
+    const uint8_t* p_in,
+    uint32_t       size);
+
+static void c8_rewind_drop_oldest(
+    struct c8_rewind* p_rewind);
+
+/* --- Function Definitions --- */
+
+struct c8_rewind* c8_rewind_create(
+    uint32_t frames,
+    uint32_t bytes)
+{
+    struct c8_rewind* p_rewind = calloc(1, sizeof(struct c8_rewind));
+
+    if (NULL == p_rewind)
+    {
+        return NULL;
+    }
+
+    p_rewind->max_entries = (0 != frames) ? frames : 1;
+    p_rewind->capacity = (0 != bytes) ? bytes : 1;
+    p_rewind->p_entries = calloc(p_rewind->max_entries, sizeof(struct c8_rewind_entry));
+    p_rewind->p_data = malloc(p_rewind->capacity);
+
+    if (NULL == p_rewind->p_entries ||
+        NULL == p_rewind->p_data)
+    {
+        c8_rewind_destroy(p_rewind);
+        return NULL;
+    }
+
+    return p_rewind;
+}
+
+void c8_rewind_destroy(
+    struct c8_rewind* p_rewind)
+{
+    if (NULL == p_rewind)
+    {
+        return;
+    }
+
+    free(p_rewind->p_entries);
+    free(p_rewind->p_data);
+    free(p_rewind);
+}
+
+void c8_rewind_push(
+    struct c8_rewind*    p_rewind,
+    const struct c8_cpu* p_cpu)
+{
+    struct c8_rewind_entry* p_entry;
+    uint32_t offset;
+    uint32_t size;
+    uint32_t head;
+
+    if (C8_FALSE == p_rewind->has_latest)
+    {
+        c8_rewind_capture(p_cpu, &p_rewind->latest);
+        p_rewind->has_latest = C8_TRUE;
+        return;
+    }
+
+    c8_rewind_capture(p_cpu, &p_rewind->next);
+
+    /* Stored against the new state so that stepping back is one XOR */
+    size = c8_rewind_encode((const uint8_t*)&p_rewind->latest,
+                            (const uint8_t*)&p_rewind->next,
+                            p_rewind->scratch);
+
+    memcpy(&p_rewind->latest, &p_rewind->next, C8_REWIND_STATE_SIZE);
+
+    if (size > p_rewind->capacity)
+    {
+        /* Cannot be stored, older frames would not connect anymore */
+        p_rewind->count = 0;
+        p_rewind->used = 0;
+        return;
+    }
+
+    while (p_rewind->count == p_rewind->max_entries ||
+           p_rewind->capacity - p_rewind->used < size)
+    {
+        c8_rewind_drop_oldest(p_rewind);
+    }
+
+    offset = 0;
+
+    if (0 != p_rewind->count)
+    {
+        p_entry = &p_rewind->p_entries[(p_rewind->first + p_rewind->count - 1) % p_rewind->max_entries];
+        offset = (p_entry->offset + p_entry->size) % p_rewind->capacity;
+    }
+    else
+    {
+        p_rewind->first = 0;
+    }
+
+    /* Frames may wrap around the end of the ring */
+    head = p_rewind->capacity - offset;
+
+    if (size <= head)
+    {
+        memcpy(&p_rewind->p_data[offset], p_rewind->scratch, size);
+    }
+    else
+    {
+        memcpy(&p_rewind->p_data[offset], p_rewind->scratch, head);
+        memcpy(p_rewind->p_data, &p_rewind->scratch[head], size - head);
+    }
+
+    p_entry = &p_rewind->p_entries[(p_rewind->first + p_rewind->count) % p_rewind->max_entries];
+    p_entry->offset = offset;
+    p_entry->size = size;
+    p_rewind->count++;
+    p_rewind->used += size;
+}
+
+int c8_rewind_step_back(
+    struct c8_rewind* p_rewind,
+    struct c8_cpu*    p_cpu)
+{
+    const struct c8_rewind_state* p_state = &p_rewind->latest;
+    struct c8_rewind_entry* p_entry;
+    uint32_t head;
+
+    if (0 == p_rewind->count)
+    {
+        return C8_FALSE;
+    }
+
+    p_entry = &p_rewind->p_entries[(p_rewind->first + p_rewind->count - 1) % p_rewind->max_entries];
+    head = p_rewind->capacity - p_entry->offset;
+
+    if (p_entry->size <= head)
+    {
+        c8_rewind_apply((uint8_t*)&p_rewind->latest,
+                        &p_rewind->p_data[p_entry->offset], p_entry->size);
+    }
+    else
+    {
+        memcpy(p_rewind->scratch, &p_rewind->p_data[p_entry->offset], head);
+        memcpy(&p_rewind->scratch[head], p_rewind->p_data, p_entry->size - head);
+        c8_rewind_apply((uint8_t*)&p_rewind->latest, p_rewind->scratch, p_entry->size);
+    }
+
+    p_rewind->count--;
+    p_rewind->used -= p_entry->size;
+
+    memcpy(p_cpu->ram, p_state->ram, sizeof(p_cpu->ram));
+    memcpy(p_cpu->screen, p_state->screen, sizeof(p_cpu->screen));
+    memcpy(p_cpu->stack, p_state->stack, sizeof(p_cpu->stack));
+    memcpy(p_cpu->V, p_state->V, sizeof(p_cpu->V));
+    memcpy(p_cpu->flags, p_state->flags, sizeof(p_cpu->flags));
+    p_cpu->rng_state = p_state->rng_state;
+    p_cpu->pc = p_state->pc;
+    p_cpu->pc_max = p_state->pc_max;
+    p_cpu->I = p_state->I;
+    p_cpu->delay_timer = p_state->delay_timer;
+    p_cpu->sound_timer = p_state->sound_timer;
+    p_cpu->screen_w = p_state->screen_w;
+    p_cpu->screen_h = p_state->screen_h;
+    p_cpu->sp = p_state->sp;
+    p_cpu->screen_is_dirty = p_state->screen_is_dirty;
+
+    /* Not recorded, FX0A sets it again on the next step */
+    p_cpu->waiting_for_key = C8_FALSE;
+
+    c8_invalidate(p_cpu, 0, sizeof(p_cpu->ram));
+
+    return C8_TRUE;
+}
+
+void c8_rewind_clear(
+    struct c8_rewind* p_rewind)
+{
+    p_rewind->has_latest = C8_FALSE;
+    p_rewind->first = 0;
+    p_rewind->count = 0;
+    p_rewind->used = 0;
+}
+
+uint32_t c8_rewind_frames(
+    const struct c8_rewind* p_rewind)
+{
+    return p_rewind->count;
+}
+
+uint32_t c8_rewind_bytes(
+    const struct c8_rewind* p_rewind)
+{
+    return p_rewind->used;
+}
+
+/* --- Local Function Definitions --- */
+
+static void c8_rewind_capture(
+    const struct c8_cpu*    p_cpu,
+    struct c8_rewind_state* p_state)
+{
+    memcpy(p_state->ram, p_cpu->ram, sizeof(p_state->ram));
+    memcpy(p_state->screen, p_cpu->screen, sizeof(p_state->screen));
+    memcpy(p_state->stack, p_cpu->stack, sizeof(p_state->stack));
+    memcpy(p_state->V, p_cpu->V, sizeof(p_state->V));
+    memcpy(p_state->flags, p_cpu->flags, sizeof(p_state->flags));
+    p_state->rng_state = p_cpu->rng_state;
+    p_state->pc = p_cpu->pc;
+    p_state->pc_max = p_cpu->pc_max;
+    p_state->I = p_cpu->I;
+    p_state->delay_timer = p_cpu->delay_timer;
+    p_state->sound_timer = p_cpu->sound_timer;
+    p_state->screen_w = p_cpu->screen_w;
+    p_state->screen_h = p_cpu->screen_h;
+    p_state->sp = p_cpu->sp;
+    p_state->screen_is_dirty = (uint8_t)p_cpu->screen_is_dirty;
+}
+
+/**
+ * XOR of two states as runs of (skip, length, bytes), where skip counts
+ * the unchanged bytes since the previous run. Unchanged stretches are
+ * found a word at a time. Changes less than a run header apart are
+ * merged, which keeps the output within C8_REWIND_MAX_FRAME.
+ * @return Number of bytes written to p_out.
+ */
+static uint32_t c8_rewind_encode(
+    const uint8_t* p_a,
+    const uint8_t* p_b,
+    uint8_t*       p_out)
+{
+    const uint32_t end = C8_REWIND_STATE_SIZE;
+    uint32_t written = 0;
+    uint32_t previous = 0;
+    uint32_t addr = 0;
+    uint32_t start;
+    uint32_t last;
+    uint64_t a;
+    uint64_t b;
+    uint32_t i;
+
+    for (;;)
+    {
+        /* Bytes up to a word boundary, then whole words */
+        while (addr < end && 0 != (addr & 7) && p_a[addr] == p_b[addr])
+        {
+            addr++;
+        }
+
+        while (addr < end && 0 == (addr & 7))
+        {
+            memcpy(&a, &p_a[addr], sizeof(a));
+            memcpy(&b, &p_b[addr], sizeof(b));
+
+            if (a != b)
+            {
+                break;
+            }
+
+            addr += 8;
+        }
+
+        if (addr >= end)
+        {
+            return written;
+        }
+
+        while (p_a[addr] == p_b[addr])
+        {
+            addr++;
+        }
+
+        start = addr;
+        last = addr;
+
+        for (addr = start + 1; addr < end && addr - last <= C8_REWIND_RUN_HEADER; addr++)
+        {
+            if (p_a[addr] != p_b[addr])
+            {
+                last = addr;
+            }
+        }
+
+        p_out[written + 0] = (uint8_t)(start - previous);
+        p_out[written + 1] = (uint8_t)((start - previous) >> 8);
+        p_out[written + 2] = (uint8_t)(last + 1 - start);
+        p_out[written + 3] = (uint8_t)((last + 1 - start) >> 8);
+        written += C8_REWIND_RUN_HEADER;
+
+        for (i = start; i <= last; i++)
+        {
+            p_out[written++] = p_a[i] ^ p_b[i];
+        }
+
+        previous = last + 1;
+        addr = previous;
+    }
+}
+
+static void c8_rewind_apply(
+    uint8_t*       p_state,
+    const uint8_t* p_in,
+    uint32_t       size)
+{
+    uint32_t addr = 0;
+    uint32_t pos = 0;
+    uint32_t length;
+    uint32_t i;
+
+    while (pos + C8_REWIND_RUN_HEADER <= size)
+    {
+        addr += (uint32_t)(p_in[pos] | (p_in[pos + 1] << 8));
+        length = (uint32_t)(p_in[pos + 2] | (p_in[pos + 3] << 8));
+        pos += C8_REWIND_RUN_HEADER;
+
+        for (i = 0; i < length; i++)
+        {
+            p_state[addr + i] ^= p_in[pos + i];
+        }
+
+        addr += length;
+        pos += length;
+    }
+}
+
+static void c8_rewind_drop_oldest(
+    struct c8_rewind* p_rewind)
+{
+    p_rewind->used -= p_rewind->p_entries[p_rewind->first].size;
+    p_rewind->first = (p_rewind->first + 1) % p_rewind->max_entries;
+    p_rewind->count--;
+}
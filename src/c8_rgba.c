@@ -0,0 +1,126 @@
+#include "c8_rgba.h"
+#include "c8_cpu.h"
+
+#include <string.h>
+
+/* GCC / Clang vector extensions, lowered to AVX2 or SSE2 by the compiler */
+#if defined(__GNUC__)
+#define C8_RGBA_SIMD (1)
+#else
+#define C8_RGBA_SIMD (0)
+#endif
+
+/* Build the kernel for AVX2 and baseline x86-64, picked at load time */
+#if C8_RGBA_SIMD && defined(__x86_64__) && defined(__GLIBC__)
+#define C8_RGBA_TARGETS __attribute__((target_clones("avx2", "default")))
+#else
+#define C8_RGBA_TARGETS
+#endif
+
+struct c8_palette_entry {
+    const char*       p_name;
+    struct c8_palette palette;
+};
+
+/* First entry is the default of the frontends */
+static const struct c8_palette_entry c8_palettes[] = {
+    { "green", { 0x1A1A1AFF, 0x00FF00FF } },
+    { "amber", { 0x1A1000FF, 0xFFB000FF } },
+    { "white", { 0x000000FF, 0xFFFFFFFF } },
+    { "blue",  { 0x0B1E3AFF, 0x8FC7FFFF } }
+};
+
+#if C8_RGBA_SIMD
+
+/* Eight pixels */
+typedef uint32_t c8_rgba_pixels __attribute__((vector_size(32)));
+
+/* Same value in every pixel */
+#define C8_RGBA_SPLAT(v)                                                \
+    ((c8_rgba_pixels){ (v), (v), (v), (v), (v), (v), (v), (v) })
+
+#endif /* C8_RGBA_SIMD */
+
+/* --- Function Definitions --- */
+
+const struct c8_palette* c8_palette_find(
+    const char* p_name)
+{
+    uint32_t i;
+
+    for (i = 0; i < C8_ARRAY_SIZE(c8_palettes); i++)
+    {
+        if (0 == strcmp(p_name, c8_palettes[i].p_name))
+        {
+            return &c8_palettes[i].palette;
+        }
+    }
+
+    return NULL;
+}
+
+const char* c8_palette_names(void)
+{
+    return "green|amber|white|blue";
+}
+
+#if C8_RGBA_SIMD
+
+C8_RGBA_TARGETS
+void c8_rgba_expand(
+    const struct c8_cpu*     p_cpu,
+    const struct c8_palette* p_palette,
+    void*                    p_pixels,
+    uint32_t                 pitch)
+{
+    /* Pixel i of a group of eight is bit 7 - i of the screen byte */
+    const c8_rgba_pixels bits = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
+    const c8_rgba_pixels on = C8_RGBA_SPLAT(p_palette->on);
+    const c8_rgba_pixels off = C8_RGBA_SPLAT(p_palette->off);
+    c8_rgba_pixels mask;
+    c8_rgba_pixels out;
+    uint8_t* p_row;
+    uint32_t byte;
+    uint32_t x;
+    uint32_t y;
+
+    for (y = 0; y < p_cpu->screen_h; y++)
+    {
+        p_row = (uint8_t*)p_pixels + (size_t)y * pitch;
+
+        for (x = 0; x < p_cpu->screen_w; x += 8)
+        {
+            byte = (uint32_t)(p_cpu->screen[y][x >> 6] >> (56 - (x & 63))) & 0xFF;
+            mask = (c8_rgba_pixels)((C8_RGBA_SPLAT(byte) & bits) != 0);
+            out = (on & mask) | (off & ~mask);
+            memcpy(&p_row[x * 4], &out, sizeof(out));
+        }
+    }
+}
+
+#else
+
+void c8_rgba_expand(
+    const struct c8_cpu*     p_cpu,
+    const struct c8_palette* p_palette,
+    void*                    p_pixels,
+    uint32_t                 pitch)
+{
+    uint8_t* p_row;
+    uint32_t color;
+    uint32_t x;
+    uint32_t y;
+
+    for (y = 0; y < p_cpu->screen_h; y++)
+    {
+        p_row = (uint8_t*)p_pixels + (size_t)y * pitch;
+
+        for (x = 0; x < p_cpu->screen_w; x++)
+        {
+            color = ((p_cpu->screen[y][x >> 6] >> (63 - (x & 63))) & 1) ? p_palette->on : p_palette->off;
+            memcpy(&p_row[x * 4], &color, sizeof(color));
+        }
+    }
+}
+
+#endif /* C8_RGBA_SIMD */
@@ -0,0 +1,292 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include "c8_rompack.h"
+#include "c8_bytes.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+struct c8_rompack {
+    const uint8_t*           p_map;
+    size_t                   map_size;
+    uint32_t                 count;
+    struct c8_rompack_entry* p_entries;
+};
+
+/* --- Local Function Declarations --- */
+
+static int c8_rompack_compare(
+    const void* p_a,
+    const void* p_b);
+
+/* --- Function Definitions --- */
+
+struct c8_rompack* c8_rompack_open(
+    const char* p_path)
+{
+    struct c8_rompack* p_pack;
+    struct c8_rompack_entry* p_entry;
+    const uint8_t* p_index;
+    struct stat st;
+    void* p_map;
+    uint64_t offset;
+    uint32_t i;
+    int fd = open(p_path, O_RDONLY);
+
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    if (0 != fstat(fd, &st) || st.st_size < C8_ROMPACK_HEADER_SIZE)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    /* The mapping stays valid after the descriptor is closed */
+    p_map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (MAP_FAILED == p_map)
+    {
+        return NULL;
+    }
+
+    p_pack = calloc(1, sizeof(*p_pack));
+
+    if (NULL == p_pack)
+    {
+        munmap(p_map, (size_t)st.st_size);
+        return NULL;
+    }
+
+    p_pack->p_map = p_map;
+    p_pack->map_size = (size_t)st.st_size;
+
+    if (0 != memcmp(p_pack->p_map, C8_ROMPACK_MAGIC, 4) ||
+        C8_ROMPACK_VERSION != c8_get_le(&p_pack->p_map[4], 2) ||
+        C8_ROMPACK_ENTRY_SIZE != c8_get_le(&p_pack->p_map[6], 2))
+    {
+        c8_rompack_close(p_pack);
+        return NULL;
+    }
+
+    p_pack->count = (uint32_t)c8_get_le(&p_pack->p_map[8], 4);
+
+    if ((uint64_t)p_pack->count * C8_ROMPACK_ENTRY_SIZE >
+        p_pack->map_size - C8_ROMPACK_HEADER_SIZE)
+    {
+        c8_rompack_close(p_pack);
+        return NULL;
+    }
+
+    p_pack->p_entries = malloc(sizeof(*p_pack->p_entries) * (p_pack->count + 1));
+
+    if (NULL == p_pack->p_entries)
+    {
+        c8_rompack_close(p_pack);
+        return NULL;
+    }
+
+    /* Decode the index once, the ROM data is only touched on load */
+    for (i = 0; i < p_pack->count; i++)
+    {
+        p_index = &p_pack->p_map[C8_ROMPACK_HEADER_SIZE + (size_t)i * C8_ROMPACK_ENTRY_SIZE];
+        p_entry = &p_pack->p_entries[i];
+
+        offset = c8_get_le(&p_index[C8_ROMPACK_NAME_SIZE + 8], 4);
+
+        p_entry->p_name = (const char*)p_index;
+        p_entry->hash = c8_get_le(&p_index[C8_ROMPACK_NAME_SIZE], 8);
+        p_entry->size = (uint32_t)c8_get_le(&p_index[C8_ROMPACK_NAME_SIZE + 12], 4);
+        p_entry->ipf = (uint32_t)c8_get_le(&p_index[C8_ROMPACK_NAME_SIZE + 16], 4);
+        p_entry->p_data = &p_pack->p_map[offset];
+
+        if ('\0' != p_index[C8_ROMPACK_NAME_SIZE - 1] ||
+            offset + p_entry->size > p_pack->map_size ||
+            (0 != i && strcmp(p_entry[-1].p_name, p_entry->p_name) >= 0))
+        {
+            c8_rompack_close(p_pack);
+            return NULL;
+        }
+    }
+
+    return p_pack;
+}
+
+void c8_rompack_close(
+    struct c8_rompack* p_pack)
+{
+    if (NULL == p_pack)
+    {
+        return;
+    }
+
+    munmap((void*)p_pack->p_map, p_pack->map_size);
+    free(p_pack->p_entries);
+    free(p_pack);
+}
+
+uint32_t c8_rompack_count(
+    const struct c8_rompack* p_pack)
+{
+    return p_pack->count;
+}
+
+const struct c8_rompack_entry* c8_rompack_get(
+    const struct c8_rompack* p_pack,
+    uint32_t                 index)
+{
+    return (index < p_pack->count) ? &p_pack->p_entries[index] : NULL;
+}
+
+const struct c8_rompack_entry* c8_rompack_find(
+    const struct c8_rompack* p_pack,
+    const char*              p_name)
+{
+    uint32_t low = 0;
+    uint32_t high = p_pack->count;
+    uint32_t middle;
+    int order;
+
+    while (low < high)
+    {
+        middle = low + (high - low) / 2;
+        order = strcmp(p_name, p_pack->p_entries[middle].p_name);
+
+        if (0 == order)
+        {
+            return &p_pack->p_entries[middle];
+        }
+
+        if (order < 0)
+        {
+            high = middle;
+        }
+        else
+        {
+            low = middle + 1;
+        }
+    }
+
+    return NULL;
+}
+
+int c8_rompack_verify(
+    const struct c8_rompack_entry* p_entry)
+{
+    return (c8_fnv(C8_FNV_OFFSET, p_entry->p_data, p_entry->size) == p_entry->hash) ?
+           C8_TRUE : C8_FALSE;
+}
+
+int c8_rompack_load(
+    const struct c8_rompack_entry* p_entry,
+    struct c8_cpu*                 p_cpu)
+{
+    return c8_load_rom(p_entry->size, p_entry->p_data, p_cpu);
+}
+
+int c8_rompack_write(
+    const char*                     p_path,
+    const struct c8_rompack_source* p_sources,
+    uint32_t                        count)
+{
+    const struct c8_rompack_source** pp_sorted;
+    uint8_t* p_index;
+    uint8_t* p_out;
+    uint64_t offset;
+    size_t index_size;
+    uint32_t i;
+    FILE* f;
+    int result;
+
+    pp_sorted = malloc(sizeof(*pp_sorted) * (count + 1));
+    index_size = C8_ROMPACK_HEADER_SIZE + (size_t)C8_ROMPACK_ENTRY_SIZE * count;
+    p_index = calloc(1, index_size);
+
+    if (NULL == pp_sorted || NULL == p_index)
+    {
+        free(pp_sorted);
+        free(p_index);
+        return C8_FALSE;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        pp_sorted[i] = &p_sources[i];
+    }
+
+    qsort(pp_sorted, count, sizeof(*pp_sorted), c8_rompack_compare);
+
+    p_out = p_index;
+    memcpy(p_out, C8_ROMPACK_MAGIC, 4);
+    p_out = c8_put_le(p_out + 4, C8_ROMPACK_VERSION, 2);
+    p_out = c8_put_le(p_out, C8_ROMPACK_ENTRY_SIZE, 2);
+    p_out = c8_put_le(p_out, count, 4);
+    p_out = c8_put_le(p_out, 0, 4);
+
+    offset = index_size;
+    result = C8_TRUE;
+
+    for (i = 0; i < count && C8_TRUE == result; i++)
+    {
+        const struct c8_rompack_source* p_source = pp_sorted[i];
+
+        /* Names are looked up by binary search, they must be unique */
+        if (strlen(p_source->p_name) >= C8_ROMPACK_NAME_SIZE ||
+            (0 != i && 0 == strcmp(pp_sorted[i - 1]->p_name, p_source->p_name)) ||
+            offset + p_source->size > UINT32_MAX)
+        {
+            result = C8_FALSE;
+        }
+        else
+        {
+            memcpy(p_out, p_source->p_name, strlen(p_source->p_name));
+            p_out += C8_ROMPACK_NAME_SIZE;
+            p_out = c8_put_le(p_out, c8_fnv(C8_FNV_OFFSET, p_source->p_data, p_source->size), 8);
+            p_out = c8_put_le(p_out, offset, 4);
+            p_out = c8_put_le(p_out, p_source->size, 4);
+            p_out = c8_put_le(p_out, p_source->ipf, 4);
+            p_out = c8_put_le(p_out, 0, 4);
+
+            offset += p_source->size;
+        }
+    }
+
+    f = (C8_TRUE == result) ? fopen(p_path, "wb") : NULL;
+    result = (NULL != f) && (index_size == fwrite(p_index, 1, index_size, f));
+
+    /* Data in index order, right after the index */
+    for (i = 0; i < count && C8_TRUE == result; i++)
+    {
+        result = (pp_sorted[i]->size == fwrite(pp_sorted[i]->p_data, 1, pp_sorted[i]->size, f));
+    }
+
+    if (NULL != f && 0 != fclose(f))
+    {
+        result = C8_FALSE;
+    }
+
+    free(pp_sorted);
+    free(p_index);
+
+    return result ? C8_TRUE : C8_FALSE;
+}
+
+/* --- Local Function Definitions --- */
+
+static int c8_rompack_compare(
+    const void* p_a,
+    const void* p_b)
+{
+    const struct c8_rompack_source* const* pp_a = p_a;
+    const struct c8_rompack_source* const* pp_b = p_b;
+
+    return strcmp((*pp_a)->p_name, (*pp_b)->p_name);
+}
@@ -0,0 +1,406 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "c8_runner.h"
+#include "c8_cpu.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+/**
+ * Jobs dealt to one worker. The owner takes from the tail, thieves
+ * take from the head so that they get the work the owner would reach
+ * last.
+ */
+struct c8_runner_queue {
+    pthread_mutex_t lock;
+    uint32_t*       p_jobs;
+    uint32_t        head;
+    uint32_t        tail;
+};
+
+struct c8_runner {
+    const struct c8_job*    p_jobs;
+    uint32_t                threads;
+    uint32_t                ipf;
+    struct c8_runner_queue* p_queues;
+
+    pthread_mutex_t         result_lock;
+    c8_runner_result_fn     result_fn;
+    void*                   p_user;
+};
+
+struct c8_runner_worker {
+    struct c8_runner* p_runner;
+    uint32_t          index;
+    pthread_t         thread;
+    struct c8_cpu     cpu;
+};
+
+/* Key change from a job script */
+struct c8_key_event {
+    uint32_t frame;
+    uint8_t  key;
+    uint8_t  down;
+};
+
+/* --- Local Function Declarations --- */
+
+static double c8_runner_now(
+    void);
+
+static int c8_runner_take(
+    struct c8_runner* p_runner,
+    uint32_t          worker,
+    uint32_t*         p_job);
+
+static void* c8_runner_worker_main(
+    void* p_arg);
+
+static int c8_runner_load_script(
+    const char*           p_path,
+    struct c8_key_event** pp_events,
+    uint32_t*             p_count);
+
+static void c8_runner_job(
+    const struct c8_runner* p_runner,
+    struct c8_cpu*          p_cpu,
+    uint32_t                job,
+    struct c8_job_result*   p_result);
+
+/* --- Function Definitions --- */
+
+int c8_runner_run(
+    const struct c8_job* p_jobs,
+    uint32_t             job_count,
+    uint32_t             threads,
+    uint32_t             ipf,
+    c8_runner_result_fn  result_fn,
+    void*                p_user)
+{
+    struct c8_runner runner;
+    struct c8_runner_worker* p_workers;
+    uint32_t* p_slots;
+    uint32_t started = 0;
+    uint32_t per_queue;
+    uint32_t i;
+    int result = C8_TRUE;
+
+    if (0 == threads)
+    {
+        threads = 1;
+    }
+
+    per_queue = (job_count + threads - 1) / threads;
+
+    runner.p_jobs = p_jobs;
+    runner.threads = threads;
+    runner.ipf = ipf;
+    runner.result_fn = result_fn;
+    runner.p_user = p_user;
+    runner.p_queues = calloc(threads, sizeof(struct c8_runner_queue));
+    p_slots = calloc(threads * per_queue + 1, sizeof(uint32_t));
+    p_workers = calloc(threads, sizeof(struct c8_runner_worker));
+
+    if (NULL == runner.p_queues ||
+        NULL == p_slots ||
+        NULL == p_workers)
+    {
+        free(runner.p_queues);
+        free(p_slots);
+        free(p_workers);
+        return C8_FALSE;
+    }
+
+    pthread_mutex_init(&runner.result_lock, NULL);
+
+    for (i = 0; i < threads; i++)
+    {
+        pthread_mutex_init(&runner.p_queues[i].lock, NULL);
+        runner.p_queues[i].p_jobs = &p_slots[i * per_queue];
+    }
+
+    /* Deal round robin so that neighbouring jobs, often similar in
+     * length, start out on different workers
+     */
+    for (i = 0; i < job_count; i++)
+    {
+        struct c8_runner_queue* p_queue = &runner.p_queues[i % threads];
+        p_queue->p_jobs[p_queue->tail++] = i;
+    }
+
+    for (i = 0; i < threads; i++)
+    {
+        p_workers[i].p_runner = &runner;
+        p_workers[i].index = i;
+
+        if (0 != pthread_create(&p_workers[i].thread, NULL,
+                                c8_runner_worker_main, &p_workers[i]))
+        {
+            /* Workers already running drain the remaining queues */
+            result = C8_FALSE;
+            break;
+        }
+
+        started++;
+    }
+
+    if (0 == started)
+    {
+        /* Not a single thread, run everything here */
+        c8_runner_worker_main(&p_workers[0]);
+    }
+
+    for (i = 0; i < started; i++)
+    {
+        pthread_join(p_workers[i].thread, NULL);
+    }
+
+    for (i = 0; i < threads; i++)
+    {
+        pthread_mutex_destroy(&runner.p_queues[i].lock);
+    }
+
+    pthread_mutex_destroy(&runner.result_lock);
+    free(p_workers);
+    free(p_slots);
+    free(runner.p_queues);
+
+    return result;
+}
+
+/* --- Local Function Definitions --- */
+
+static double c8_runner_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/**
+ * Next job for a worker, from its own queue first, then stolen from the
+ * others starting with its neighbour.
+ * @return C8_FALSE once every queue is empty.
+ */
+static int c8_runner_take(
+    struct c8_runner* p_runner,
+    uint32_t          worker,
+    uint32_t*         p_job)
+{
+    struct c8_runner_queue* p_queue = &p_runner->p_queues[worker];
+    int found = C8_FALSE;
+    uint32_t i;
+
+    pthread_mutex_lock(&p_queue->lock);
+
+    if (p_queue->tail > p_queue->head)
+    {
+        *p_job = p_queue->p_jobs[--p_queue->tail];
+        found = C8_TRUE;
+    }
+
+    pthread_mutex_unlock(&p_queue->lock);
+
+    for (i = 1; i < p_runner->threads && C8_FALSE == found; i++)
+    {
+        p_queue = &p_runner->p_queues[(worker + i) % p_runner->threads];
+
+        pthread_mutex_lock(&p_queue->lock);
+
+        if (p_queue->tail > p_queue->head)
+        {
+            *p_job = p_queue->p_jobs[p_queue->head++];
+            found = C8_TRUE;
+        }
+
+        pthread_mutex_unlock(&p_queue->lock);
+    }
+
+    /* Jobs are never added while running, empty queues stay empty */
+    return found;
+}
+
+static void* c8_runner_worker_main(
+    void* p_arg)
+{
+    struct c8_runner_worker* p_worker = p_arg;
+    struct c8_runner* p_runner = p_worker->p_runner;
+    struct c8_job_result result;
+    uint32_t job;
+
+    while (C8_TRUE == c8_runner_take(p_runner, p_worker->index, &job))
+    {
+        c8_runner_job(p_runner, &p_worker->cpu, job, &result);
+        result.worker = p_worker->index;
+
+        if (NULL != p_runner->result_fn)
+        {
+            pthread_mutex_lock(&p_runner->result_lock);
+            p_runner->result_fn(&result, p_runner->p_user);
+            pthread_mutex_unlock(&p_runner->result_lock);
+        }
+    }
+
+    return NULL;
+}
+
+static int c8_runner_load_script(
+    const char*           p_path,
+    struct c8_key_event** pp_events,
+    uint32_t*             p_count)
+{
+    struct c8_key_event* p_events = NULL;
+    struct c8_key_event* p_grown;
+    uint32_t capacity = 0;
+    uint32_t count = 0;
+    unsigned int frame;
+    unsigned int key;
+    unsigned int down;
+    char line[256];
+    char* p_line;
+    FILE* f = fopen(p_path, "r");
+    int result = C8_TRUE;
+
+    if (NULL == f)
+    {
+        return C8_FALSE;
+    }
+
+    while (C8_TRUE == result && NULL != fgets(line, sizeof(line), f))
+    {
+        p_line = line + strspn(line, " \t");
+
+        if ('#' == *p_line || '\n' == *p_line || '\r' == *p_line || '\0' == *p_line)
+        {
+            continue;
+        }
+
+        if (3 != sscanf(p_line, "%u %x %u", &frame, &key, &down) ||
+            key > 0xF || down > 1)
+        {
+            result = C8_FALSE;
+            break;
+        }
+
+        if (count == capacity)
+        {
+            capacity = (0 == capacity) ? 64 : capacity * 2;
+            p_grown = realloc(p_events, capacity * sizeof(*p_events));
+
+            if (NULL == p_grown)
+            {
+                result = C8_FALSE;
+                break;
+            }
+
+            p_events = p_grown;
+        }
+
+        p_events[count].frame = frame;
+        p_events[count].key = (uint8_t)key;
+        p_events[count].down = (uint8_t)down;
+        count++;
+    }
+
+    fclose(f);
+
+    if (C8_FALSE == result)
+    {
+        free(p_events);
+        return C8_FALSE;
+    }
+
+    *pp_events = p_events;
+    *p_count = count;
+
+    return C8_TRUE;
+}
+
+/**
+ * Run one job on the worker's CPU, frame by frame like the frontends:
+ * key events for the frame, then the instruction budget, then timers.
+ */
+static void c8_runner_job(
+    const struct c8_runner* p_runner,
+    struct c8_cpu*          p_cpu,
+    uint32_t                job,
+    struct c8_job_result*   p_result)
+{
+    const struct c8_job* p_job = &p_runner->p_jobs[job];
+    struct c8_key_event* p_events = NULL;
+    uint32_t event_count = 0;
+    uint32_t next_event = 0;
+    enum c8_run_stop stop;
+    uint32_t executed;
+    uint32_t budget;
+    uint32_t frame;
+    double start = c8_runner_now();
+
+    memset(p_result, 0x00, sizeof(*p_result));
+    p_result->job = job;
+
+    c8_init(p_cpu);
+    c8_seed(p_cpu, p_job->seed);
+    c8_load_font(p_cpu);
+
+    if (NULL != p_job->p_rom_data)
+    {
+        p_result->loaded = c8_load_rom(p_job->rom_size, p_job->p_rom_data, p_cpu);
+    }
+    else
+    {
+        p_result->loaded = c8_load_rom_from_file(p_job->p_rom_path, p_cpu);
+    }
+
+    if (C8_TRUE == p_result->loaded && NULL != p_job->p_script_path)
+    {
+        p_result->loaded = c8_runner_load_script(p_job->p_script_path,
+                                                 &p_events, &event_count);
+    }
+
+    for (frame = 0; C8_TRUE == p_result->loaded && frame < p_job->frames; frame++)
+    {
+        while (next_event < event_count && p_events[next_event].frame <= frame)
+        {
+            p_cpu->keyboard[p_events[next_event].key] = p_events[next_event].down;
+            next_event++;
+        }
+
+        budget = (0 != p_job->ipf) ? p_job->ipf : p_runner->ipf;
+
+        while (budget > 0)
+        {
+            stop = c8_run(p_cpu, budget, C8_RUN_SKIP_IDLE, &executed);
+            budget -= executed;
+            p_result->cycles += executed;
+
+            if (C8_RUN_ERROR == stop)
+            {
+                p_result->halted = C8_TRUE;
+                break;
+            }
+
+            if (C8_RUN_KEY_WAIT == stop)
+            {
+                /* Waiting for a key until next frame */
+                break;
+            }
+        }
+
+        if (C8_TRUE == p_result->halted)
+        {
+            break;
+        }
+
+        c8_decrement_timers(p_cpu);
+        p_result->frames++;
+    }
+
+    p_result->screen_hash = c8_hash_screen(p_cpu);
+    p_result->seconds = c8_runner_now() - start;
+
+    free(p_events);
+}
@@ -0,0 +1,446 @@
+#include "c8_snapshot.h"
+#include "c8_cpu.h"
+#include "c8_bytes.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define C8_SNAPSHOT_RAM_SIZE (4096)
+
+/* Size of the header, registers and screen row mask */
+#define C8_SNAPSHOT_FIXED_SIZE (68)
+
+/* Bytes per RAM run header. Differences closer than this are stored as
+ * one run, which also bounds a snapshot to C8_SNAPSHOT_MAX_SIZE.
+ */
+#define C8_SNAPSHOT_RUN_HEADER (4)
+
+/* RAM is compared in blocks of this many bytes before words and bytes */
+#define C8_SNAPSHOT_BLOCK (512)
+
+static const uint8_t c8_snapshot_magic[4] = { 'C', '8', 'S', 'S' };
+
+static const uint8_t c8_snapshot_zero_ram[C8_SNAPSHOT_RAM_SIZE];
+
+/* --- Local Function Declarations --- */
+
+static uint64_t c8_snapshot_word(
+    const uint8_t* p_in);
+
+static uint32_t c8_snapshot_row_count(
+    uint64_t rows);
+
+static uint32_t c8_snapshot_next_diff(
+    const uint8_t* p_a,
+    const uint8_t* p_b,
+    uint32_t       addr);
+
+/* --- Function Definitions --- */
+
+uint32_t c8_snapshot_save(
+    const struct c8_cpu* p_cpu,
+    const uint8_t*       p_base_ram,
+    uint8_t*             p_buffer,
+    uint32_t             size)
+{
+    const uint8_t* p_base = (NULL != p_base_ram) ? p_base_ram : c8_snapshot_zero_ram;
+    uint8_t* p_out = p_buffer;
+    uint8_t* p_run_count;
+    const uint32_t words = p_cpu->screen_w / 64;
+    uint32_t sp = p_cpu->sp;
+    uint64_t rows = 0;
+    uint32_t runs = 0;
+    uint32_t start;
+    uint32_t last;
+    uint32_t addr;
+    uint16_t keys = 0;
+    uint32_t i;
+
+    if (sp > C8_ARRAY_SIZE(p_cpu->stack))
+    {
+        return 0;
+    }
+
+    for (i = 0; i < p_cpu->screen_h; i++)
+    {
+        rows |= (uint64_t)(0 != (p_cpu->screen[i][0] | p_cpu->screen[i][1])) << i;
+    }
+
+    for (i = 0; i < C8_ARRAY_SIZE(p_cpu->keyboard); i++)
+    {
+        keys |= (uint16_t)((0 != p_cpu->keyboard[i]) << i);
+    }
+
+    /* Everything but the RAM runs has a known size, check it up front */
+    if (size < C8_SNAPSHOT_FIXED_SIZE + sp * 2 +
+               c8_snapshot_row_count(rows) * words * 8 + 2)
+    {
+        return 0;
+    }
+
+    memcpy(p_out, c8_snapshot_magic, sizeof(c8_snapshot_magic));
+    p_out += sizeof(c8_snapshot_magic);
+    *p_out++ = C8_SNAPSHOT_VERSION;
+    *p_out++ = (uint8_t)sp;
+
+    p_out = c8_put_le(p_out, p_cpu->pc, 2);
+    p_out = c8_put_le(p_out, p_cpu->pc_max, 2);
+    p_out = c8_put_le(p_out, p_cpu->I, 2);
+    p_out = c8_put_le(p_out, p_cpu->delay_timer, 2);
+    p_out = c8_put_le(p_out, p_cpu->sound_timer, 2);
+    memcpy(p_out, p_cpu->V, sizeof(p_cpu->V));
+    p_out += sizeof(p_cpu->V);
+    p_out = c8_put_le(p_out, keys, 2);
+    p_out = c8_put_le(p_out, p_cpu->rng_state, 8);
+    *p_out++ = (uint8_t)(0 != p_cpu->screen_is_dirty);
+    *p_out++ = (uint8_t)(C8_SCREEN_HIRES_W == p_cpu->screen_w);
+    memcpy(p_out, p_cpu->flags, sizeof(p_cpu->flags));
+    p_out += sizeof(p_cpu->flags);
+
+    p_out = c8_put_le(p_out, rows, 8);
+
+    for (i = 0; i < sp; i++)
+    {
+        p_out = c8_put_le(p_out, p_cpu->stack[i], 2);
+    }
+
+    for (i = 0; i < p_cpu->screen_h; i++)
+    {
+        if (rows & ((uint64_t)1 << i))
+        {
+            p_out = c8_put_le(p_out, p_cpu->screen[i][0], 8);
+
+            if (words > 1)
+            {
+                p_out = c8_put_le(p_out, p_cpu->screen[i][1], 8);
+            }
+        }
+    }
+
+    p_run_count = p_out;
+    p_out += 2;
+
+    addr = c8_snapshot_next_diff(p_cpu->ram, p_base, 0);
+
+    while (addr < C8_SNAPSHOT_RAM_SIZE)
+    {
+        start = addr;
+        last = addr;
+
+        /* Extend the run while the next difference is too close to be
+         * worth a run header of its own
+         */
+        for (addr = start + 1;
+             addr < C8_SNAPSHOT_RAM_SIZE && addr - last <= C8_SNAPSHOT_RUN_HEADER;
+             addr++)
+        {
+            if (p_cpu->ram[addr] != p_base[addr])
+            {
+                last = addr;
+            }
+        }
+
+        if ((uint32_t)(p_out - p_buffer) + C8_SNAPSHOT_RUN_HEADER + (last + 1 - start) > size)
+        {
+            return 0;
+        }
+
+        p_out = c8_put_le(p_out, (uint16_t)start, 2);
+        p_out = c8_put_le(p_out, (uint16_t)(last + 1 - start), 2);
+        memcpy(p_out, &p_cpu->ram[start], last + 1 - start);
+        p_out += last + 1 - start;
+        runs++;
+
+        addr = c8_snapshot_next_diff(p_cpu->ram, p_base, last + 1);
+    }
+
+    c8_put_le(p_run_count, (uint16_t)runs, 2);
+
+    return (uint32_t)(p_out - p_buffer);
+}
+
+int c8_snapshot_load(
+    struct c8_cpu* p_cpu,
+    const uint8_t* p_base_ram,
+    const uint8_t* p_buffer,
+    uint32_t       size)
+{
+    const uint8_t* p_base = (NULL != p_base_ram) ? p_base_ram : c8_snapshot_zero_ram;
+    const uint8_t* p_in = p_buffer;
+    const uint8_t* p_end = p_buffer + size;
+    const uint8_t* p_runs;
+    uint32_t words;
+    uint32_t sp;
+    uint64_t rows;
+    uint32_t runs;
+    uint32_t addr;
+    uint32_t length;
+    uint16_t keys;
+    uint32_t i;
+
+    /* Validate everything before touching the CPU */
+    if (size < C8_SNAPSHOT_FIXED_SIZE ||
+        0 != memcmp(p_in, c8_snapshot_magic, sizeof(c8_snapshot_magic)) ||
+        C8_SNAPSHOT_VERSION != p_in[4])
+    {
+        return C8_FALSE;
+    }
+
+    sp = p_in[5];
+    words = (1 == p_in[43]) ? 2 : 1;
+    rows = c8_get_le(&p_in[60], 8);
+
+    /* A zero generator state would stick at zero, lo-res has no rows
+     * past 32. The engines index ram and the decode cache by the
+     * program counter, so it has to be inside ram
+     */
+    if (sp > C8_ARRAY_SIZE(p_cpu->stack) ||
+        c8_get_le(&p_in[8], 2) > sizeof(p_cpu->ram) ||
+        c8_get_le(&p_in[6], 2) > c8_get_le(&p_in[8], 2) ||
+        0 == c8_get_le(&p_in[34], 8) ||
+        p_in[43] > 1 ||
+        (1 == words && 0 != (rows >> C8_SCREEN_LORES_H)) ||
+        size < C8_SNAPSHOT_FIXED_SIZE + sp * 2 +
+               c8_snapshot_row_count(rows) * words * 8 + 2)
+    {
+        return C8_FALSE;
+    }
+
+    p_runs = p_in + C8_SNAPSHOT_FIXED_SIZE + sp * 2 + c8_snapshot_row_count(rows) * words * 8;
+    runs = (uint32_t)c8_get_le(p_runs, 2);
+    p_runs += 2;
+    p_in = p_runs;
+
+    for (i = 0; i < runs; i++)
+    {
+        if (p_end - p_in < C8_SNAPSHOT_RUN_HEADER)
+        {
+            return C8_FALSE;
+        }
+
+        addr = (uint32_t)c8_get_le(p_in, 2);
+        length = (uint32_t)c8_get_le(p_in + 2, 2);
+        p_in += C8_SNAPSHOT_RUN_HEADER;
+
+        if (addr + length > C8_SNAPSHOT_RAM_SIZE ||
+            (uint32_t)(p_end - p_in) < length)
+        {
+            return C8_FALSE;
+        }
+
+        p_in += length;
+    }
+
+    /* Registers */
+    p_in = p_buffer + 6;
+    p_cpu->pc = (uint16_t)c8_get_le(p_in, 2);
+    p_cpu->pc_max = (uint16_t)c8_get_le(p_in + 2, 2);
+    p_cpu->I = (uint16_t)c8_get_le(p_in + 4, 2);
+    p_cpu->delay_timer = (uint16_t)c8_get_le(p_in + 6, 2);
+    p_cpu->sound_timer = (uint16_t)c8_get_le(p_in + 8, 2);
+    p_in += 10;
+    memcpy(p_cpu->V, p_in, sizeof(p_cpu->V));
+    p_in += sizeof(p_cpu->V);
+    keys = (uint16_t)c8_get_le(p_in, 2);
+    p_in += 2;
+
+    for (i = 0; i < C8_ARRAY_SIZE(p_cpu->keyboard); i++)
+    {
+        p_cpu->keyboard[i] = (uint8_t)((keys >> i) & 1);
+    }
+
+    p_cpu->rng_state = c8_get_le(p_in, 8);
+    p_in += 8;
+    p_cpu->screen_is_dirty = *p_in++;
+    p_cpu->screen_w = (2 == words) ? C8_SCREEN_HIRES_W : C8_SCREEN_LORES_W;
+    p_cpu->screen_h = (2 == words) ? C8_SCREEN_HIRES_H : C8_SCREEN_LORES_H;
+    p_in++;
+    memcpy(p_cpu->flags, p_in, sizeof(p_cpu->flags));
+
+    /* Not stored, FX0A sets it again on the next step */
+    p_cpu->waiting_for_key = C8_FALSE;
+
+    /* Stack */
+    p_in = p_buffer + C8_SNAPSHOT_FIXED_SIZE;
+    p_cpu->sp = (uint8_t)sp;
+    memset(p_cpu->stack, 0x00, sizeof(p_cpu->stack));
+
+    for (i = 0; i < sp; i++)
+    {
+        p_cpu->stack[i] = (uint16_t)c8_get_le(p_in, 2);
+        p_in += 2;
+    }
+
+    /* Screen, the words past the resolution stay 0 */
+    memset(p_cpu->screen, 0x00, sizeof(p_cpu->screen));
+
+    for (i = 0; i < p_cpu->screen_h; i++)
+    {
+        if (rows & ((uint64_t)1 << i))
+        {
+            p_cpu->screen[i][0] = c8_get_le(p_in, 8);
+            p_in += 8;
+
+            if (words > 1)
+            {
+                p_cpu->screen[i][1] = c8_get_le(p_in, 8);
+                p_in += 8;
+            }
+        }
+    }
+
+    /* RAM. Cached decodes stay valid where the current RAM already
+     * matches the base, only the rest and the runs are invalidated.
+     */
+#if C8_DISPATCH_THREADED
+    for (addr = c8_snapshot_next_diff(p_cpu->ram, p_base, 0);
+         addr < C8_SNAPSHOT_RAM_SIZE;
+         addr = c8_snapshot_next_diff(p_cpu->ram, p_base, addr + 1))
+    {
+        c8_invalidate(p_cpu, addr, 1);
+    }
+#endif
+
+    memcpy(p_cpu->ram, p_base, C8_SNAPSHOT_RAM_SIZE);
+
+    p_in = p_runs;
+
+    for (i = 0; i < runs; i++)
+    {
+        addr = (uint32_t)c8_get_le(p_in, 2);
+        length = (uint32_t)c8_get_le(p_in + 2, 2);
+        p_in += C8_SNAPSHOT_RUN_HEADER;
+
+        memcpy(&p_cpu->ram[addr], p_in, length);
+        c8_invalidate(p_cpu, addr, length);
+        p_in += length;
+    }
+
+    return C8_TRUE;
+}
+
+int c8_snapshot_save_to_file(
+    const struct c8_cpu* p_cpu,
+    const uint8_t*       p_base_ram,
+    const char*          p_path)
+{
+    uint8_t buffer[C8_SNAPSHOT_MAX_SIZE];
+    uint32_t size = c8_snapshot_save(p_cpu, p_base_ram, buffer, sizeof(buffer));
+    int result = C8_TRUE;
+    FILE* f;
+
+    if (0 == size)
+    {
+        return C8_FALSE;
+    }
+
+    f = fopen(p_path, "wb");
+
+    if (NULL == f)
+    {
+        printf("Failed to open file [path='%s']\n", p_path);
+        return C8_FALSE;
+    }
+
+    if (size != fwrite(buffer, 1, size, f))
+    {
+        result = C8_FALSE;
+    }
+
+    if (0 != fclose(f))
+    {
+        result = C8_FALSE;
+    }
+
+    return result;
+}
+
+int c8_snapshot_load_from_file(
+    struct c8_cpu* p_cpu,
+    const uint8_t* p_base_ram,
+    const char*    p_path)
+{
+    uint8_t buffer[C8_SNAPSHOT_MAX_SIZE];
+    size_t size;
+    FILE* f = fopen(p_path, "rb");
+
+    if (NULL == f)
+    {
+        printf("Failed to open file [path='%s']\n", p_path);
+        return C8_FALSE;
+    }
+
+    size = fread(buffer, 1, sizeof(buffer), f);
+    fclose(f);
+
+    return c8_snapshot_load(p_cpu, p_base_ram, buffer, (uint32_t)size);
+}
+
+/* --- Local Function Definitions --- */
+
+static uint64_t c8_snapshot_word(
+    const uint8_t* p_in)
+{
+    uint64_t word;
+    memcpy(&word, p_in, sizeof(word));
+    return word;
+}
+
+static uint32_t c8_snapshot_row_count(
+    uint64_t rows)
+{
+    uint32_t count = 0;
+
+    while (0 != rows)
+    {
+        rows &= rows - 1;
+        count++;
+    }
+
+    return count;
+}
+
+/**
+ * First address at or after addr where the two RAM images differ,
+ * C8_SNAPSHOT_RAM_SIZE if none.
+ */
+static uint32_t c8_snapshot_next_diff(
+    const uint8_t* p_a,
+    const uint8_t* p_b,
+    uint32_t       addr)
+{
+    /* Bytes up to a word, words up to a block, then whole blocks with
+     * memcmp since RAM images mostly match
+     */
+    while (addr < C8_SNAPSHOT_RAM_SIZE && 0 != (addr & 7) &&
+           p_a[addr] == p_b[addr])
+    {
+        addr++;
+    }
+
+    while (addr < C8_SNAPSHOT_RAM_SIZE &&
+           0 != (addr & (C8_SNAPSHOT_BLOCK - 1)) && 0 == (addr & 7) &&
+           c8_snapshot_word(&p_a[addr]) == c8_snapshot_word(&p_b[addr]))
+    {
+        addr += 8;
+    }
+
+    while (addr < C8_SNAPSHOT_RAM_SIZE && 0 == (addr & (C8_SNAPSHOT_BLOCK - 1)) &&
+           0 == memcmp(&p_a[addr], &p_b[addr], C8_SNAPSHOT_BLOCK))
+    {
+        addr += C8_SNAPSHOT_BLOCK;
+    }
+
+    while (addr < C8_SNAPSHOT_RAM_SIZE && 0 == (addr & 7) &&
+           c8_snapshot_word(&p_a[addr]) == c8_snapshot_word(&p_b[addr]))
+    {
+        addr += 8;
+    }
+
+    while (addr < C8_SNAPSHOT_RAM_SIZE && p_a[addr] == p_b[addr])
+    {
+        addr++;
+    }
+
+    return addr;
+}
@@ -0,0 +1,488 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "c8_term.h"
+#include "c8_cpu.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Unchanged cells between two changed ones are redrawn rather than
+ * skipped with a cursor move when the gap is at most this long
+ */
+#define C8_TERM_MERGE_GAP (1)
+
+/* Longest escape sequence or glyph emitted for a cell */
+#define C8_TERM_MAX_CELL_BYTES (16)
+
+/* Cursor move, "\033[rrr;cccH" */
+#define C8_TERM_MAX_MOVE_BYTES (12)
+
+/* Longest status line, longer ones are cut */
+#define C8_TERM_MAX_STATUS (256)
+
+#define C8_TERM_COLOR_UNKNOWN (-1)
+
+/* Glyph and color of a cell, indexed by the cell value */
+struct c8_term_glyph {
+    const char* p_text;
+    const char* p_color;
+    int         color;
+};
+
+static const struct c8_term_glyph c8_term_block_glyphs[2] = {
+    { "\xe2\x96\x91\xe2\x96\x91", "\033[90m", 0 }, /* off, light shade */
+    { "\xe2\x96\x88\xe2\x96\x88", "\033[92m", 1 }  /* on, full block */
+};
+
+/* Indexed by top pixel | bottom pixel << 1 */
+static const struct c8_term_glyph c8_term_half_glyphs[4] = {
+    { " ",            "\033[92m", 1 },
+    { "\xe2\x96\x80", "\033[92m", 1 }, /* upper half block */
+    { "\xe2\x96\x84", "\033[92m", 1 }, /* lower half block */
+    { "\xe2\x96\x88", "\033[92m", 1 }  /* full block */
+};
+
+struct c8_term {
+    int      fd;
+    uint8_t* p_buffer;
+    size_t   capacity;
+
+    /* Cell grid of the mode, each cell is cell_columns wide and covers
+     * cell_w by cell_h pixels. rows and columns follow the resolution.
+     */
+    enum c8_term_mode           mode;
+    uint32_t                    rows;
+    uint32_t                    columns;
+    uint32_t                    cell_columns;
+    uint32_t                    cell_w;
+    uint32_t                    cell_h;
+    const struct c8_term_glyph* p_glyphs;
+
+    /* UTF-8 Braille patterns, indexed by the 2x4 pixels of a cell as
+     * two bits per row, top row lowest, left pixel the higher bit
+     */
+    struct c8_term_glyph        braille[256];
+    char                        braille_text[256][4];
+
+    /* Cells on the terminal, valid once is_valid is set */
+    uint8_t  shown[C8_SCREEN_HIRES_H][C8_SCREEN_HIRES_W];
+    uint8_t  next[C8_SCREEN_HIRES_H][C8_SCREEN_HIRES_W];
+    int      is_valid;
+
+    struct c8_term_stats stats;
+};
+
+/* --- Local Function Declarations --- */
+
+static void c8_term_braille_init(
+    struct c8_term* p_term);
+
+static void c8_term_cells(
+    struct c8_term*      p_term,
+    const struct c8_cpu* p_cpu);
+
+static uint8_t* c8_term_put_string(
+    uint8_t*    p_out,
+    const char* p_text);
+
+static uint8_t* c8_term_put_uint(
+    uint8_t* p_out,
+    uint32_t value);
+
+static uint8_t* c8_term_put_move(
+    uint8_t* p_out,
+    uint32_t row,
+    uint32_t column);
+
+static int c8_term_write(
+    struct c8_term* p_term,
+    size_t          size,
+    uint32_t*       p_writes);
+
+/* --- Function Definitions --- */
+
+struct c8_term* c8_term_create(
+    int               fd,
+    enum c8_term_mode mode)
+{
+    struct c8_term* p_term = calloc(1, sizeof(struct c8_term));
+
+    if (NULL == p_term)
+    {
+        return NULL;
+    }
+
+    /* Every cell with a color change, a move per row and the status line */
+    p_term->fd = fd;
+    p_term->mode = mode;
+
+    switch (mode)
+    {
+    case C8_TERM_HALF:
+        p_term->cell_w = 1;
+        p_term->cell_h = 2;
+        p_term->cell_columns = 1;
+        p_term->p_glyphs = c8_term_half_glyphs;
+        break;
+    case C8_TERM_BRAILLE:
+        c8_term_braille_init(p_term);
+        p_term->cell_w = 2;
+        p_term->cell_h = 4;
+        p_term->cell_columns = 1;
+        p_term->p_glyphs = p_term->braille;
+        break;
+    case C8_TERM_BLOCK:
+    default:
+        p_term->mode = C8_TERM_BLOCK;
+        p_term->cell_w = 1;
+        p_term->cell_h = 1;
+        p_term->cell_columns = 2;
+        p_term->p_glyphs = c8_term_block_glyphs;
+        break;
+    }
+
+    p_term->rows = C8_SCREEN_LORES_H / p_term->cell_h;
+    p_term->columns = C8_SCREEN_LORES_W / p_term->cell_w;
+
+    /* Sized for hi-res */
+    p_term->capacity = (size_t)C8_SCREEN_HIRES_H *
+                       (C8_TERM_MAX_MOVE_BYTES + C8_SCREEN_HIRES_W * C8_TERM_MAX_CELL_BYTES * 2) +
+                       C8_TERM_MAX_MOVE_BYTES + C8_TERM_MAX_STATUS + 32;
+    p_term->p_buffer = malloc(p_term->capacity);
+
+    if (NULL == p_term->p_buffer)
+    {
+        free(p_term);
+        return NULL;
+    }
+
+    return p_term;
+}
+
+void c8_term_destroy(
+    struct c8_term* p_term)
+{
+    if (NULL == p_term)
+    {
+        return;
+    }
+
+    free(p_term->p_buffer);
+    free(p_term);
+}
+
+void c8_term_invalidate(
+    struct c8_term* p_term)
+{
+    p_term->is_valid = C8_FALSE;
+}
+
+int c8_term_draw(
+    struct c8_term*      p_term,
+    const struct c8_cpu* p_cpu,
+    const char*          p_status)
+{
+    const struct c8_term_glyph* p_glyph;
+    uint8_t* p_out = p_term->p_buffer;
+    uint32_t frame_bytes;
+    uint32_t writes = 0;
+    uint32_t start;
+    uint32_t last;
+    uint32_t x;
+    uint32_t y;
+    int color = C8_TERM_COLOR_UNKNOWN;
+    int result;
+
+    if (p_cpu->screen_h / p_term->cell_h != p_term->rows ||
+        p_cpu->screen_w / p_term->cell_w != p_term->columns)
+    {
+        /* Resolution changed, clear what the old grid left behind */
+        p_term->rows = p_cpu->screen_h / p_term->cell_h;
+        p_term->columns = p_cpu->screen_w / p_term->cell_w;
+        p_term->is_valid = C8_FALSE;
+        p_out = c8_term_put_string(p_out, "\033[2J");
+    }
+
+    c8_term_cells(p_term, p_cpu);
+
+    for (y = 0; y < p_term->rows; y++)
+    {
+        const uint8_t* p_next = p_term->next[y];
+        const uint8_t* p_shown = p_term->shown[y];
+        const int all = (C8_FALSE == p_term->is_valid);
+
+        x = 0;
+
+        while (x < p_term->columns)
+        {
+            if (!all && p_next[x] == p_shown[x])
+            {
+                x++;
+                continue;
+            }
+
+            /* Extend the run over short unchanged gaps */
+            start = x;
+            last = x;
+
+            for (x = start + 1; x < p_term->columns && x - last <= C8_TERM_MERGE_GAP + 1; x++)
+            {
+                if (all || p_next[x] != p_shown[x])
+                {
+                    last = x;
+                }
+            }
+
+            p_out = c8_term_put_move(p_out, y + 1, start * p_term->cell_columns + 1);
+
+            for (x = start; x <= last; x++)
+            {
+                p_glyph = &p_term->p_glyphs[p_next[x]];
+
+                if (color != p_glyph->color)
+                {
+                    p_out = c8_term_put_string(p_out, p_glyph->p_color);
+                    color = p_glyph->color;
+                }
+
+                p_out = c8_term_put_string(p_out, p_glyph->p_text);
+            }
+
+            x = last + 1;
+        }
+    }
+
+    memcpy(p_term->shown, p_term->next, sizeof(p_term->shown));
+    p_term->is_valid = C8_TRUE;
+
+    frame_bytes = (uint32_t)(p_out - p_term->p_buffer);
+
+    if (NULL != p_status)
+    {
+        size_t length = strlen(p_status);
+
+        if (length > C8_TERM_MAX_STATUS)
+        {
+            length = C8_TERM_MAX_STATUS;
+        }
+
+        p_out = c8_term_put_string(p_out, "\033[0m");
+        p_out = c8_term_put_move(p_out, p_term->rows + 1, 1);
+        p_out = c8_term_put_string(p_out, "\033[2K");
+        memcpy(p_out, p_status, length);
+        p_out += length;
+    }
+
+    result = C8_TRUE;
+
+    if (p_out != p_term->p_buffer)
+    {
+        result = c8_term_write(p_term, (size_t)(p_out - p_term->p_buffer), &writes);
+    }
+
+    p_term->stats.frames++;
+    p_term->stats.bytes += frame_bytes;
+    p_term->stats.writes += writes;
+    p_term->stats.last_bytes = frame_bytes;
+    p_term->stats.last_writes = writes;
+
+    if (frame_bytes > p_term->stats.max_bytes)
+    {
+        p_term->stats.max_bytes = frame_bytes;
+    }
+
+    return result;
+}
+
+const struct c8_term_stats* c8_term_get_stats(
+    const struct c8_term* p_term)
+{
+    return &p_term->stats;
+}
+
+/* --- Local Function Definitions --- */
+
+static void c8_term_braille_init(
+    struct c8_term* p_term)
+{
+    /* Dot bit of U+2800 for each pixel, by row and left / right */
+    static const uint8_t dots[4][2] = {
+        { 0x01, 0x08 },
+        { 0x02, 0x10 },
+        { 0x04, 0x20 },
+        { 0x40, 0x80 }
+    };
+    uint32_t code_point;
+    uint32_t index;
+    uint32_t row;
+
+    for (index = 0; index < 256; index++)
+    {
+        code_point = 0x2800;
+
+        for (row = 0; row < 4; row++)
+        {
+            if (index & (0x2u << (row * 2)))
+            {
+                code_point |= dots[row][0];
+            }
+
+            if (index & (0x1u << (row * 2)))
+            {
+                code_point |= dots[row][1];
+            }
+        }
+
+        /* Three byte UTF-8, every pattern is in U+2800 to U+28FF */
+        p_term->braille_text[index][0] = (char)(0xE0 | (code_point >> 12));
+        p_term->braille_text[index][1] = (char)(0x80 | ((code_point >> 6) & 0x3F));
+        p_term->braille_text[index][2] = (char)(0x80 | (code_point & 0x3F));
+        p_term->braille_text[index][3] = '\0';
+
+        p_term->braille[index].p_text = p_term->braille_text[index];
+        p_term->braille[index].p_color = "\033[92m";
+        p_term->braille[index].color = 1;
+    }
+}
+
+/* Cell values of the current mode, the index into its glyph table */
+static void c8_term_cells(
+    struct c8_term*      p_term,
+    const struct c8_cpu* p_cpu)
+{
+    const uint64_t (*p_screen)[C8_SCREEN_WORDS] = p_cpu->screen;
+    const uint64_t* p_top;
+    const uint64_t* p_bottom;
+    uint32_t shift;
+    uint32_t word;
+    uint32_t x;
+    uint32_t y;
+
+    /* Pixel x is bit 63 - (x & 63) of word x >> 6 */
+    switch (p_term->mode)
+    {
+    case C8_TERM_HALF:
+        for (y = 0; y < p_term->rows; y++)
+        {
+            p_top = p_screen[y * 2];
+            p_bottom = p_screen[y * 2 + 1];
+
+            for (x = 0; x < p_term->columns; x++)
+            {
+                shift = 63 - (x & 63);
+                p_term->next[y][x] = (uint8_t)(((p_top[x >> 6] >> shift) & 1) |
+                                               (((p_bottom[x >> 6] >> shift) & 1) << 1));
+            }
+        }
+        break;
+
+    case C8_TERM_BRAILLE:
+        for (y = 0; y < p_term->rows; y++)
+        {
+            for (x = 0; x < p_term->columns; x++)
+            {
+                /* Two pixel pairs from each of the four rows, a pair
+                 * never straddles two words */
+                shift = 62 - ((x * 2) & 63);
+                word = (x * 2) >> 6;
+                p_term->next[y][x] = (uint8_t)(((p_screen[y * 4 + 0][word] >> shift) & 3) |
+                                               (((p_screen[y * 4 + 1][word] >> shift) & 3) << 2) |
+                                               (((p_screen[y * 4 + 2][word] >> shift) & 3) << 4) |
+                                               (((p_screen[y * 4 + 3][word] >> shift) & 3) << 6));
+            }
+        }
+        break;
+
+    case C8_TERM_BLOCK:
+    default:
+        for (y = 0; y < p_term->rows; y++)
+        {
+            for (x = 0; x < p_term->columns; x++)
+            {
+                p_term->next[y][x] = (uint8_t)((p_screen[y][x >> 6] >> (63 - (x & 63))) & 1);
+            }
+        }
+        break;
+    }
+}
+
+static uint8_t* c8_term_put_string(
+    uint8_t*    p_out,
+    const char* p_text)
+{
+    while ('\0' != *p_text)
+    {
+        *p_out++ = (uint8_t)*p_text++;
+    }
+
+    return p_out;
+}
+
+static uint8_t* c8_term_put_uint(
+    uint8_t* p_out,
+    uint32_t value)
+{
+    uint8_t digits[10];
+    uint32_t count = 0;
+
+    do
+    {
+        digits[count++] = (uint8_t)('0' + value % 10);
+        value /= 10;
+    } while (0 != value);
+
+    while (count > 0)
+    {
+        *p_out++ = digits[--count];
+    }
+
+    return p_out;
+}
+
+/* Cursor position, 1 based like the escape sequence */
+static uint8_t* c8_term_put_move(
+    uint8_t* p_out,
+    uint32_t row,
+    uint32_t column)
+{
+    *p_out++ = '\033';
+    *p_out++ = '[';
+    p_out = c8_term_put_uint(p_out, row);
+    *p_out++ = ';';
+    p_out = c8_term_put_uint(p_out, column);
+    *p_out++ = 'H';
+    return p_out;
+}
+
+/* Write the whole buffer, a terminal may take it in several parts */
+static int c8_term_write(
+    struct c8_term* p_term,
+    size_t          size,
+    uint32_t*       p_writes)
+{
+    const uint8_t* p_data = p_term->p_buffer;
+    ssize_t written;
+
+    while (size > 0)
+    {
+        written = write(p_term->fd, p_data, size);
+        (*p_writes)++;
+
+        if (written < 0)
+        {
+            if (EINTR == errno || EAGAIN == errno)
+            {
+                continue;
+            }
+
+            return C8_FALSE;
+        }
+
+        p_data += written;
+        size -= (size_t)written;
+    }
+
+    return C8_TRUE;
+}
@@ -0,0 +1,164 @@
+#include "c8_trace.h"
+#include "c8_bytes.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* --- Function Definitions --- */
+
+struct c8_trace* c8_trace_create(
+    uint32_t records)
+{
+    struct c8_trace* p_trace;
+    uint32_t size = 1;
+
+    while (size < records && size < (1u << 31))
+    {
+        size <<= 1;
+    }
+
+    p_trace = calloc(1, sizeof(*p_trace));
+
+    if (NULL == p_trace)
+    {
+        return NULL;
+    }
+
+    p_trace->p_records = calloc(size, sizeof(*p_trace->p_records));
+
+    if (NULL == p_trace->p_records)
+    {
+        free(p_trace);
+        return NULL;
+    }
+
+    p_trace->mask = size - 1;
+
+    return p_trace;
+}
+
+void c8_trace_destroy(
+    struct c8_trace* p_trace)
+{
+    if (NULL == p_trace)
+    {
+        return;
+    }
+
+    free(p_trace->p_records);
+    free(p_trace);
+}
+
+int c8_trace_attach(
+    struct c8_cpu*   p_cpu,
+    struct c8_trace* p_trace)
+{
+#if C8_TRACE
+    p_cpu->p_trace = p_trace;
+    return C8_TRUE;
+#else
+    (void)p_cpu;
+    return (NULL == p_trace) ? C8_TRUE : C8_FALSE;
+#endif
+}
+
+int c8_trace_dump(
+    const struct c8_trace* p_trace,
+    const char*            p_path)
+{
+    const uint64_t size = (uint64_t)p_trace->mask + 1;
+    struct c8_trace_record* p_copy;
+    uint8_t* p_buffer;
+    uint8_t* p_out;
+    uint64_t head;
+    uint64_t first;
+    uint64_t end;
+    uint64_t skip;
+    uint64_t i;
+    uint32_t count;
+    FILE* p_file;
+    int result;
+
+    p_copy = malloc(sizeof(*p_copy) * size);
+    p_buffer = malloc(C8_TRACE_HEADER_SIZE + C8_TRACE_RECORD_SIZE * size);
+
+    if (NULL == p_copy || NULL == p_buffer)
+    {
+        free(p_copy);
+        free(p_buffer);
+        return C8_FALSE;
+    }
+
+    /* Copy the ring, then drop what the writer may have reused meanwhile.
+       The writer fills record N - 1 and writes record N into the slot of
+       N - size before publishing head = N + 1. */
+    head = C8_TRACE_LOAD(&p_trace->head);
+    first = (head > size) ? head - size : 0;
+
+    for (i = first; i < head; i++)
+    {
+        p_copy[i - first] = p_trace->p_records[i & p_trace->mask];
+    }
+
+    end = C8_TRACE_LOAD(&p_trace->head);
+    skip = (end + 1 > first + size) ? end + 1 - size - first : 0;
+
+    if (skip > head - first)
+    {
+        skip = head - first;
+    }
+
+    count = (uint32_t)(head - first - skip);
+
+    p_out = p_buffer;
+    memcpy(p_out, C8_TRACE_MAGIC, 4);
+    p_out += 4;
+    p_out = c8_put_le(p_out, C8_TRACE_VERSION, 2);
+    p_out = c8_put_le(p_out, C8_TRACE_RECORD_SIZE, 2);
+    p_out = c8_put_le(p_out, count, 4);
+    p_out = c8_put_le(p_out, (0 != count) ? count - 1 : 0, 4);
+    p_out = c8_put_le(p_out, first + skip, 8);
+
+    /* The newest record gets its results from the next instruction */
+    for (i = skip; i < head - first; i++)
+    {
+        const struct c8_trace_record* p_record = &p_copy[i];
+
+        p_out = c8_put_le(p_out, p_record->pc, 2);
+        p_out = c8_put_le(p_out, p_record->op, 2);
+        p_out = c8_put_le(p_out, p_record->I, 2);
+        *p_out++ = p_record->vx;
+        *p_out++ = p_record->vf;
+    }
+
+    p_file = fopen(p_path, "wb");
+    result = C8_FALSE;
+
+    if (NULL != p_file)
+    {
+        result = ((size_t)(p_out - p_buffer) == fwrite(p_buffer, 1, (size_t)(p_out - p_buffer), p_file));
+        result = (0 == fclose(p_file)) && result;
+    }
+
+    free(p_copy);
+    free(p_buffer);
+
+    return result ? C8_TRUE : C8_FALSE;
+}
+
+void c8_trace_fault(
+    struct c8_trace* p_trace)
+{
+    if (NULL == p_trace->p_fault_path || C8_TRUE == p_trace->faulted)
+    {
+        return;
+    }
+
+    p_trace->faulted = C8_TRUE;
+
+    if (C8_FALSE == c8_trace_dump(p_trace, p_trace->p_fault_path))
+    {
+        fprintf(stderr, "failed to write trace '%s'\n", p_trace->p_fault_path);
+    }
+}
@@ -1,9 +1,4 @@
 #define _POSIX_C_SOURCE 199309L
-#define C8_SLEEP_MS(ms)                                                 \
-    do {                                                                \
-        struct timespec ts = { (ms) / 1000, ((ms) % 1000) * 1000000L }; \
-        nanosleep(&ts, NULL);                                           \
-    } while (0)
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -12,11 +7,19 @@
 #include <termios.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "c8_cpu.h"
-
-#define INSTRUCTIONS_PER_FRAME 10
+#include "c8_movie.h"
+#include "c8_pacer.h"
+#include "c8_profile.h"
+#include "c8_rewind.h"
+#include "c8_term.h"
+#include "c8_trace.h"
+
+#define REWIND_KEY_FRAMES      4
 #define TERM_ALT_SCREEN_ON  "\033[?1049h"
 #define TERM_ALT_SCREEN_OFF "\033[?1049l"
 #define TERM_CURSOR_HIDE    "\033[?25l"
@@ -26,6 +29,26 @@
 
 static struct termios orig_termios;
 
+/* Renderer whose counters are printed on exit, NULL without --stats */
+static struct c8_term* p_stats_term;
+
+/* Frame timing, printed on exit with the renderer counters */
+static struct c8_pacer pacer;
+
+/* Instruction profile written on exit, NULL without --profile */
+static struct c8_profile* p_profile;
+static const char* p_profile_path;
+
+/* Execution trace dumped on exit, on a fault and on SIGUSR1, NULL
+ * without --trace */
+static struct c8_trace* p_trace;
+static const char* p_trace_path;
+static volatile sig_atomic_t trace_requested;
+
+/* Input recording written on exit, NULL without --record */
+static struct c8_movie* p_movie;
+static const char* p_movie_path;
+
 static void terminal_backup_and_setup(
     void);
 
@@ -40,11 +63,41 @@ static void cleanup(void);
 static void handle_interrupt(
     int sig);
 
-static void handle_input(
-    struct c8_cpu* p_cpu);
+static void handle_trace_request(
+    int sig);
 
-static void print_screen(
-    struct c8_cpu* p_cpu);
+/**
+ * @brief Read pending keys into the keyboard.
+ * @param[in,out] p_turbo, toggled by the turbo key.
+ * @return C8_TRUE while the rewind key is held.
+ */
+static int handle_input(
+    struct c8_cpu* p_cpu,
+    int*           p_turbo);
+
+/**
+ * @brief Block until stdin is readable.
+ */
+static void wait_for_input(
+    void);
+
+/**
+ * @brief Run one frame worth of instructions.
+ * @param[in,out] p_redraw, set if the screen was drawn to.
+ * @return C8_FALSE if the program counter went out of bounds.
+ */
+static int run_frame(
+    struct c8_cpu* p_cpu,
+    uint32_t       budget,
+    int*           p_redraw);
+
+static void draw_screen(
+    struct c8_term* p_term,
+    struct c8_cpu*  p_cpu,
+    int             stats);
+
+static void print_stats(
+    const struct c8_term* p_term);
 
 /* --- Main Function --- */
 
@@ -53,51 +106,251 @@ int main(
     const char* argv[])
 {
     int result = C8_TRUE;
-    int i;
+    uint32_t ips = C8_PACER_DEFAULT_IPS;
+    uint32_t frames;
+    uint32_t frame;
+    int redraw;
+    int stats = C8_FALSE;
+    int turbo = C8_FALSE;
+    int rewinding;
+    enum c8_term_mode mode = C8_TERM_BLOCK;
+    const char* p_rom_path = NULL;
+    const uint64_t seed = (uint64_t)time(NULL);
+    sigset_t exit_signals;
     struct c8_cpu cpu;
+    struct c8_rewind* p_rewind;
+    struct c8_term* p_term;
+    int i;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "--stats"))
+        {
+            stats = C8_TRUE;
+        }
+        else if (0 == strcmp(argv[i], "--turbo"))
+        {
+            turbo = C8_TRUE;
+        }
+        else if (0 == strcmp(argv[i], "--profile") && i + 1 < argc)
+        {
+            p_profile_path = argv[++i];
+        }
+        else if (0 == strcmp(argv[i], "--trace") && i + 1 < argc)
+        {
+            p_trace_path = argv[++i];
+        }
+        else if (0 == strcmp(argv[i], "--record") && i + 1 < argc)
+        {
+            p_movie_path = argv[++i];
+        }
+        else if (0 == strcmp(argv[i], "--ips") && i + 1 < argc)
+        {
+            ips = (uint32_t)strtoul(argv[++i], NULL, 10);
+
+            if (0 == ips)
+            {
+                p_rom_path = NULL;
+                break;
+            }
+        }
+        else if (0 == strcmp(argv[i], "--mode") && i + 1 < argc)
+        {
+            i++;
+
+            if (0 == strcmp(argv[i], "block"))
+            {
+                mode = C8_TERM_BLOCK;
+            }
+            else if (0 == strcmp(argv[i], "half"))
+            {
+                mode = C8_TERM_HALF;
+            }
+            else if (0 == strcmp(argv[i], "braille"))
+            {
+                mode = C8_TERM_BRAILLE;
+            }
+            else
+            {
+                p_rom_path = NULL;
+                break;
+            }
+        }
+        else if (NULL == p_rom_path)
+        {
+            p_rom_path = argv[i];
+        }
+        else
+        {
+            p_rom_path = NULL;
+            break;
+        }
+    }
+
+    if (NULL == p_rom_path)
+    {
+        printf("usage '%s [--stats] [--turbo] [--ips N] [--mode block|half|braille] [--profile FILE] [--trace FILE] [--record FILE] path/to/rom' \n", argv[0]);
+        return 1;
+    }
+
+    c8_init(&cpu);
+    c8_load_font(&cpu);
+    c8_seed(&cpu, seed);
+
+    if (NULL != p_profile_path)
+    {
+        p_profile = c8_profile_create();
+
+        if (NULL == p_profile)
+        {
+            return 1;
+        }
+
+        if (C8_FALSE == c8_profile_attach(&cpu, p_profile))
+        {
+            printf("--profile is not built in, configure with -DC8_PROFILE=ON\n");
+            return 1;
+        }
+    }
+
+    if (NULL != p_trace_path)
+    {
+        p_trace = c8_trace_create(C8_TRACE_DEFAULT_RECORDS);
+
+        if (NULL == p_trace)
+        {
+            return 1;
+        }
+
+        if (C8_FALSE == c8_trace_attach(&cpu, p_trace))
+        {
+            printf("--trace is not built in, configure with -DC8_TRACE=ON\n");
+            return 1;
+        }
+
+        p_trace->p_fault_path = p_trace_path;
+    }
+
+    p_term = c8_term_create(STDOUT_FILENO, mode);
+
+    if (NULL == p_term)
+    {
+        return 1;
+    }
+
+    if (C8_TRUE == stats)
+    {
+        p_stats_term = p_term;
+    }
 
     terminal_backup_and_setup();
     signal(SIGINT,  handle_interrupt); 
     signal(SIGABRT, handle_interrupt); 
     signal(SIGTERM, handle_interrupt);
+    signal(SIGUSR1, handle_trace_request);
     atexit(cleanup);
-        
-    c8_init(&cpu);
     
-    if (argc == 2)
-    {
-        result = c8_load_rom_from_file(argv[1], &cpu);
-    }
-    else
+    printf("Loading rom: [path='%s']\n", p_rom_path);
+    result = c8_load_rom_from_file(p_rom_path, &cpu);
+
+    if (C8_TRUE == result && NULL != p_movie_path)
     {
-        printf("usage '%spath/to/rom' \n", argv[0]);
+        p_movie = c8_movie_create(&cpu, seed, ips);
+        result = (NULL != p_movie) ? C8_TRUE : C8_FALSE;
     }
 
-    /* Hide cursor */
+    /* Held back while frames run, so a recording ends between frames */
+    sigemptyset(&exit_signals);
+    sigaddset(&exit_signals, SIGINT);
+    sigaddset(&exit_signals, SIGTERM);
+
+    /* Hide cursor, flushed before the renderer writes past stdio */
     printf("\033[?25l");
+    fflush(stdout);
+
+    /* Rewind is optional, run without it if there is no memory. A
+       recording has to run forwards only */
+    p_rewind = (NULL == p_movie) ?
+               c8_rewind_create(C8_REWIND_DEFAULT_FRAMES, C8_REWIND_DEFAULT_BYTES) : NULL;
+
+    if (NULL != p_rewind)
+    {
+        c8_rewind_push(p_rewind, &cpu);
+    }
     
     /* Run Program */
+    c8_pacer_init(&pacer, ips);
+    frames = 1;
+
     while (C8_TRUE == result)
     {
-        handle_input(&cpu);
+        if (0 != trace_requested && NULL != p_trace)
+        {
+            trace_requested = 0;
+            c8_trace_dump(p_trace, p_trace_path);
+        }
+
+        rewinding = handle_input(&cpu, &turbo);
+        c8_pacer_set_turbo(&pacer, turbo);
+
+        if (C8_TRUE == rewinding && NULL != p_rewind)
+        {
+            /* Step back one frame per frame while the key is held */
+            if (C8_TRUE == c8_rewind_step_back(p_rewind, &cpu))
+            {
+                draw_screen(p_term, &cpu, stats);
+            }
+
+            frames = c8_pacer_wait(&pacer);
+            continue;
+        }
         
-        for (i = 0; i < INSTRUCTIONS_PER_FRAME; i++)
+        /* Run every frame that is due, redraw at most once. In turbo mode
+           this is every frame that fits in one display period */
+        redraw = C8_FALSE;
+
+        if (NULL != p_movie)
+        {
+            sigprocmask(SIG_BLOCK, &exit_signals, NULL);
+        }
+
+        for (frame = 0; frame < frames && C8_TRUE == result; frame++)
         {
-            result = c8_step(&cpu);
+            result = run_frame(&cpu, c8_pacer_budget(&pacer), &redraw);
 
-            if (C8_FALSE == result)
+            c8_decrement_timers(&cpu);
+
+            if (NULL != p_rewind)
             {
-                break;
+                c8_rewind_push(p_rewind, &cpu);
+            }
+
+            if (NULL != p_movie && C8_FALSE == c8_movie_record(p_movie, &cpu))
+            {
+                result = C8_FALSE;
             }
         }
 
-        if (cpu.screen_is_dirty)
+        if (NULL != p_movie)
+        {
+            c8_movie_finish(p_movie, &cpu);
+            sigprocmask(SIG_UNBLOCK, &exit_signals, NULL);
+        }
+
+        if (C8_FALSE == result)
         {
-            print_screen(&cpu);
+            if (C8_FALSE == c8_has_exited(&cpu))
+            {
+                printf("unexpected program counter %d / %d \n", cpu.pc, cpu.pc_max);
+            }
+            break;
+        }
+
+        if (C8_TRUE == redraw)
+        {
+            draw_screen(p_term, &cpu, stats);
             cpu.screen_is_dirty = 0;
         }
-        
-        c8_decrement_timers(&cpu);
 
         if (cpu.sound_timer > 0)
         {
@@ -106,8 +359,26 @@ int main(
             fflush(stdout); 
         }
         
-        /* Sleep to approximately 16.6 ms to maintain 60 FPS */
-        C8_SLEEP_MS(16);
+        if (C8_TRUE == cpu.waiting_for_key &&
+            0 == cpu.delay_timer && 0 == cpu.sound_timer)
+        {
+            /* Nothing happens until a key is pressed, block on stdin */
+            wait_for_input();
+            c8_pacer_restart(&pacer);
+            frames = 1;
+            continue;
+        }
+        
+        /* Sleep until the next frame is due */
+        frames = c8_pacer_wait(&pacer);
+    }
+
+    c8_rewind_destroy(p_rewind);
+
+    /* Counters are printed by cleanup */
+    if (NULL == p_stats_term)
+    {
+        c8_term_destroy(p_term);
     }
 
     /* atexit called for cleanup */
@@ -156,6 +427,46 @@ static void terminal_restore(void)
 static void cleanup(void)
 {
     terminal_restore();
+
+    if (NULL != p_stats_term)
+    {
+        print_stats(p_stats_term);
+        c8_term_destroy(p_stats_term);
+        p_stats_term = NULL;
+    }
+
+    if (NULL != p_profile)
+    {
+        if (C8_FALSE == c8_profile_write(p_profile, p_profile_path))
+        {
+            fprintf(stderr, "failed to write profile '%s'\n", p_profile_path);
+        }
+
+        c8_profile_destroy(p_profile);
+        p_profile = NULL;
+    }
+
+    if (NULL != p_trace)
+    {
+        if (C8_FALSE == c8_trace_dump(p_trace, p_trace_path))
+        {
+            fprintf(stderr, "failed to write trace '%s'\n", p_trace_path);
+        }
+
+        c8_trace_destroy(p_trace);
+        p_trace = NULL;
+    }
+
+    if (NULL != p_movie)
+    {
+        if (C8_FALSE == c8_movie_save(p_movie, p_movie_path))
+        {
+            fprintf(stderr, "failed to write recording '%s'\n", p_movie_path);
+        }
+
+        c8_movie_destroy(p_movie);
+        p_movie = NULL;
+    }
 }
 
 static void handle_interrupt(int sig)
@@ -172,9 +483,22 @@ static void handle_interrupt(int sig)
     raise(sig);
 }
 
-static void handle_input(struct c8_cpu* p_cpu)
+static void handle_trace_request(int sig)
+{
+    (void)sig;
+
+    /* Dumped from the main loop, not from the handler */
+    trace_requested = 1;
+}
+
+static int handle_input(
+    struct c8_cpu* p_cpu,
+    int*           p_turbo)
 {
     unsigned char c;
+    
+    /* Held down through key repeat, same as the keypad below */
+    static uint8_t rewind_timer;
 
     /* Since the terminal doesnt offer key up event, we keep the key pressed for n frames and release them.
      */
@@ -190,6 +514,11 @@ static void handle_input(struct c8_cpu* p_cpu)
         p_cpu->keyboard[i] = (key_timer[i] > 0);
     }
 
+    if (rewind_timer > 0)
+    {
+        rewind_timer--;
+    }
+
     while (read(STDIN_FILENO, &c, 1) == 1) {
         int key = -1;
         switch (c) {
@@ -201,6 +530,8 @@ static void handle_input(struct c8_cpu* p_cpu)
         case 'd': key = 0x9; break; case 'f': key = 0xE; break;
         case 'z': key = 0xA; break; case 'x': key = 0x0; break;
         case 'c': key = 0xB; break; case 'v': key = 0xF; break;
+        case 0x7F: case 0x08: rewind_timer = REWIND_KEY_FRAMES; break;
+        case '\t': *p_turbo = !*p_turbo; break;
         }
         
         if (key != -1)
@@ -209,31 +540,107 @@ static void handle_input(struct c8_cpu* p_cpu)
             p_cpu->keyboard[key] = 1;
         }
     }
+
+    return (rewind_timer > 0);
 }
 
-static void print_screen(struct c8_cpu* p_cpu)
+static void wait_for_input(void)
 {
-    /* Move cursor to top-left instead of clearing to avoid flicker */
-    printf(TERM_CURSOR_HOME);
+    struct pollfd pfd;
 
-    int x, y;
-    
-    for (y = 0; y < C8_SCREEN_H; y++)
+    pfd.fd = STDIN_FILENO;
+    pfd.events = POLLIN;
+
+    /* Signals end the wait early, the caller just runs a frame */
+    poll(&pfd, 1, -1);
+}
+
+static int run_frame(
+    struct c8_cpu* p_cpu,
+    uint32_t       budget,
+    int*           p_redraw)
+{
+    enum c8_run_stop stop;
+    uint32_t executed;
+
+    while (budget > 0)
     {
-        for (x = 0; x < C8_SCREEN_W; x++)
+        stop = c8_run(p_cpu, budget, C8_RUN_STOP_ON_DRAW | C8_RUN_SKIP_IDLE, &executed);
+        budget -= executed;
+
+        if (C8_RUN_DRAW == stop)
         {
-            if (p_cpu->screen[y * C8_SCREEN_W + x])
-            {
-                printf("\033[92m██");
-            }
-            else
-            {
-                printf("\033[90m░░");
-            }
+            *p_redraw = C8_TRUE;
+        }
+        else if (C8_RUN_ERROR == stop)
+        {
+            return C8_FALSE;
+        }
+        else
+        {
+            /* Budget used up or waiting for a key until next frame */
+            break;
         }
+    }
+
+    return C8_TRUE;
+}
+
+static void draw_screen(
+    struct c8_term* p_term,
+    struct c8_cpu*  p_cpu,
+    int             stats)
+{
+    const struct c8_term_stats* p_stats = c8_term_get_stats(p_term);
+    char status[160];
+
+    if (C8_FALSE == stats)
+    {
+        c8_term_draw(p_term, p_cpu, NULL);
+        return;
+    }
+
+    /* Counters of the previous frame, this one is not written yet */
+    snprintf(status, sizeof(status),
+             "last frame: %"PRIu32" bytes, %"PRIu32" writes | average: %.0f bytes | jitter max: %.2f ms%s",
+             p_stats->last_bytes, p_stats->last_writes,
+             (0 != p_stats->frames) ? (double)p_stats->bytes / p_stats->frames : 0.0,
+             (double)pacer.stats.jitter_ns_max * 1e-6,
+             (C8_TRUE == pacer.turbo) ? " | turbo" : "");
+
+    c8_term_draw(p_term, p_cpu, status);
+}
+
+static void print_stats(
+    const struct c8_term* p_term)
+{
+    const struct c8_term_stats* p_stats = c8_term_get_stats(p_term);
+    const struct c8_pacer_stats* p_pacing = &pacer.stats;
 
-        /* \r is required because raw mode disables automatic carriage return */
-        printf("\033[0m\r\n");
+    if (0 != p_stats->frames)
+    {
+        fprintf(stderr,
+                "frames drawn: %"PRIu64"\n"
+                "bytes/frame:  %.1f (max %"PRIu32")\n"
+                "writes/frame: %.2f\n",
+                p_stats->frames,
+                (double)p_stats->bytes / p_stats->frames,
+                p_stats->max_bytes,
+                (double)p_stats->writes / p_stats->frames);
+    }
+
+    if (0 != p_pacing->frames)
+    {
+        fprintf(stderr,
+                "frames paced: %"PRIu64" (%"PRIu64" caught up, %"PRIu64" dropped)\n"
+                "late:         %.3f ms average, %.3f ms max\n"
+                "jitter:       %.3f ms average, %.3f ms max\n"
+                "turbo frames: %"PRIu64"\n",
+                p_pacing->frames, p_pacing->caught_up, p_pacing->dropped,
+                (double)p_pacing->late_ns_total * 1e-6 / p_pacing->frames,
+                (double)p_pacing->late_ns_max * 1e-6,
+                (double)p_pacing->jitter_ns_total * 1e-6 / p_pacing->frames,
+                (double)p_pacing->jitter_ns_max * 1e-6,
+                p_pacing->turbo_frames);
     }
-    fflush(stdout);
 }
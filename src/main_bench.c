@@ -0,0 +1,1275 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <stdint.h>
+
+#include "c8_cpu.h"
+#include "c8_bytes.h"
+#include "c8_jit.h"
+#include "c8_movie.h"
+#include "c8_pacer.h"
+#include "c8_batch.h"
+#include "c8_snapshot.h"
+#include "c8_rewind.h"
+#include "c8_profile.h"
+#include "c8_trace.h"
+
+#define BENCH_DEFAULT_INSTRUCTIONS (20000000ull)
+#define BENCH_DEFAULT_IPF          (10)
+#define BENCH_DEFAULT_REPEAT       (3)
+#define BENCH_SNAPSHOT_ROUNDS      (100000)
+
+/**
+ * Built-in workload used when no ROM is given. Mixes sprite drawing,
+ * ALU ops, BCD / register dumps, subroutine calls and timer polling so
+ * that every major opcode class shows up in the numbers.
+ */
+static const uint8_t bench_builtin_rom[] = {
+    0x00, 0xE0, /* 200: CLS            */
+    0x60, 0x00, /* 202: V0 = 0         */
+    0x61, 0x00, /* 204: V1 = 0         */
+    0xA2, 0x4E, /* 206: I = sprite     */
+    0xD0, 0x15, /* 208: DRW V0, V1, 5  */
+    0x70, 0x03, /* 20A: V0 += 3        */
+    0x71, 0x02, /* 20C: V1 += 2        */
+    0x83, 0x04, /* 20E: V3 += V0       */
+    0x84, 0x15, /* 210: V4 -= V1       */
+    0x85, 0x36, /* 212: V5 >>= 1       */
+    0x86, 0x3E, /* 214: V6 <<= 1       */
+    0xC7, 0xFF, /* 216: V7 = rand      */
+    0xA3, 0x00, /* 218: I = 0x300      */
+    0xF7, 0x33, /* 21A: BCD V7         */
+    0xF3, 0x55, /* 21C: dump V0-V3     */
+    0xF8, 0x1E, /* 21E: I += V8        */
+    0x38, 0x00, /* 220: skip V8 == 0   */
+    0x78, 0x01, /* 222: V8 += 1        */
+    0x22, 0x40, /* 224: call 240       */
+    0xA2, 0x4E, /* 226: I = sprite     */
+    0xF9, 0x07, /* 228: V9 = DT        */
+    0x39, 0x00, /* 22A: skip V9 == 0   */
+    0x12, 0x08, /* 22C: jump 208       */
+    0x6A, 0x02, /* 22E: VA = 2         */
+    0xFA, 0x15, /* 230: DT = VA        */
+    0x12, 0x08, /* 232: jump 208       */
+    0x00, 0x00, /* 234: padding        */
+    0x00, 0x00, /* 236                 */
+    0x00, 0x00, /* 238                 */
+    0x00, 0x00, /* 23A                 */
+    0x00, 0x00, /* 23C                 */
+    0x00, 0x00, /* 23E                 */
+    0x8A, 0x80, /* 240: VA = V8        */
+    0x8A, 0xB1, /* 242: VA |= VB       */
+    0x8A, 0xB2, /* 244: VA &= VB       */
+    0x8A, 0xB3, /* 246: VA ^= VB       */
+    0x9A, 0xB0, /* 248: skip VA != VB  */
+    0x6B, 0x01, /* 24A: VB = 1         */
+    0x00, 0xEE, /* 24C: return         */
+    0xF0, 0x90, 0xF0, 0x90, 0xF0 /* 24E: sprite */
+};
+
+/* Opcode classes, indexed by the high nibble of the opcode */
+static const char* const bench_class_names[16] = {
+    "0x0 sys/cls/ret",
+    "0x1 jump",
+    "0x2 call",
+    "0x3 skip eq imm",
+    "0x4 skip ne imm",
+    "0x5 skip eq reg",
+    "0x6 load imm",
+    "0x7 add imm",
+    "0x8 alu",
+    "0x9 skip ne reg",
+    "0xA load I",
+    "0xB jump V0",
+    "0xC rand",
+    "0xD draw",
+    "0xE key skip",
+    "0xF misc"
+};
+
+struct bench_options {
+    uint64_t instructions;
+    uint32_t ipf;
+    uint32_t repeat;
+    int      breakdown;
+    int      jit;
+    uint32_t batch;
+    uint64_t seed;
+    int      snapshot;
+    int      rewind;
+    int      skip_idle;
+    /* c8_run flags of the interpreter runs */
+    uint32_t run_flags;
+    /* Profile report path, NULL for none */
+    const char* p_profile_path;
+    /* Trace dump path, NULL for none */
+    const char* p_trace_path;
+    /* Recording replayed instead of the instruction budget, NULL for none */
+    const char* p_movie_path;
+};
+
+struct bench_result {
+    uint64_t instructions;
+    uint64_t frames;
+    double   seconds;
+};
+
+/* --- Local Function Declarations --- */
+
+static void print_usage(
+    const char* p_name);
+
+static int parse_u64(
+    const char* p_str,
+    uint64_t*   p_out);
+
+static double now_seconds(
+    void);
+
+static int bench_prepare(
+    const char*    p_path,
+    uint64_t       seed,
+    struct c8_cpu* p_cpu);
+
+static void bench_run(
+    const struct c8_cpu*        p_initial,
+    const struct bench_options* p_options,
+    struct c8_jit*              p_jit,
+    struct bench_result*        p_result,
+    struct c8_cpu*              p_final);
+
+static void bench_best(
+    const struct c8_cpu*        p_initial,
+    const struct bench_options* p_options,
+    struct c8_jit*              p_jit,
+    struct bench_result*        p_best,
+    struct c8_cpu*              p_final);
+
+static void bench_report(
+    const char*                p_label,
+    const struct bench_result* p_result);
+
+static int bench_same_state(
+    const struct c8_cpu* p_a,
+    const struct c8_cpu* p_b);
+
+static void bench_breakdown(
+    const struct c8_cpu*        p_initial,
+    const struct bench_options* p_options);
+
+static void bench_lane_setup(
+    struct c8_cpu*              p_cpu,
+    const struct bench_options* p_options,
+    uint32_t                    lane);
+
+static void bench_lanes_run(
+    const struct c8_cpu*        p_initial,
+    const struct bench_options* p_options,
+    struct c8_cpu*              p_cpus,
+    struct bench_result*        p_result);
+
+static struct c8_batch* bench_batch_run(
+    const struct c8_cpu*        p_initial,
+    const struct bench_options* p_options,
+    uint32_t                    flags,
+    struct bench_result*        p_result);
+
+static void bench_batch(
+    const struct c8_cpu*        p_initial,
+    const struct bench_options* p_options);
+
+static void bench_snapshot(
+    const struct c8_cpu* p_initial,
+    const struct c8_cpu* p_final);
+
+static void bench_rewind(
+    const struct c8_cpu*        p_initial,
+    const struct bench_options* p_options);
+
+static int bench_profile(
+    const struct c8_cpu*        p_initial,
+    const struct bench_options* p_options);
+
+static int bench_trace(
+    const struct c8_cpu*        p_initial,
+    const struct bench_options* p_options,
+    const struct bench_result*  p_interp,
+    const struct c8_cpu*        p_final);
+
+static void bench_movie_run(
+    const struct c8_cpu*        p_initial,
+    const struct bench_options* p_options,
+    struct c8_movie*            p_movie,
+    struct bench_result*        p_result,
+    struct c8_cpu*              p_final);
+
+static int bench_movie(
+    const char*                 p_path,
+    const struct bench_options* p_options);
+
+static int bench_rom(
+    const char*                 p_path,
+    const struct bench_options* p_options);
+
+/* --- Main Function --- */
+
+int main(
+    int argc,
+    const char* argv[])
+{
+    struct bench_options options;
+    const char* roms[64];
+    int rom_count = 0;
+    int result = C8_TRUE;
+    uint64_t frames = 0;
+    uint64_t value;
+    int i;
+
+    options.instructions = BENCH_DEFAULT_INSTRUCTIONS;
+    options.ipf = BENCH_DEFAULT_IPF;
+    options.repeat = BENCH_DEFAULT_REPEAT;
+    options.breakdown = C8_TRUE;
+    options.jit = C8_FALSE;
+    options.batch = 0;
+    options.seed = C8_DEFAULT_SEED;
+    options.snapshot = C8_FALSE;
+    options.rewind = C8_FALSE;
+    options.skip_idle = C8_FALSE;
+    options.run_flags = 0;
+    options.p_profile_path = NULL;
+    options.p_trace_path = NULL;
+    options.p_movie_path = NULL;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "-h") ||
+            0 == strcmp(argv[i], "--help"))
+        {
+            print_usage(argv[0]);
+            return 0;
+        }
+        else if ((0 == strcmp(argv[i], "-n") ||
+                  0 == strcmp(argv[i], "--instructions")) &&
+                 i + 1 < argc && parse_u64(argv[i + 1], &value) && value > 0)
+        {
+            options.instructions = value;
+            frames = 0;
+            i++;
+        }
+        else if ((0 == strcmp(argv[i], "-f") ||
+                  0 == strcmp(argv[i], "--frames")) &&
+                 i + 1 < argc && parse_u64(argv[i + 1], &value) && value > 0)
+        {
+            frames = value;
+            i++;
+        }
+        else if (0 == strcmp(argv[i], "--ipf") &&
+                 i + 1 < argc && parse_u64(argv[i + 1], &value) &&
+                 value > 0 && value <= UINT32_MAX)
+        {
+            options.ipf = (uint32_t)value;
+            i++;
+        }
+        else if ((0 == strcmp(argv[i], "-r") ||
+                  0 == strcmp(argv[i], "--repeat")) &&
+                 i + 1 < argc && parse_u64(argv[i + 1], &value) &&
+                 value > 0 && value <= 1000)
+        {
+            options.repeat = (uint32_t)value;
+            i++;
+        }
+        else if (0 == strcmp(argv[i], "--no-breakdown"))
+        {
+            options.breakdown = C8_FALSE;
+        }
+        else if (0 == strcmp(argv[i], "--jit"))
+        {
+            options.jit = C8_TRUE;
+        }
+        else if (0 == strcmp(argv[i], "--snapshot"))
+        {
+            options.snapshot = C8_TRUE;
+        }
+        else if (0 == strcmp(argv[i], "--rewind"))
+        {
+            options.rewind = C8_TRUE;
+        }
+        else if (0 == strcmp(argv[i], "--skip-idle"))
+        {
+            options.skip_idle = C8_TRUE;
+        }
+        else if (0 == strcmp(argv[i], "--profile") && i + 1 < argc)
+        {
+            options.p_profile_path = argv[++i];
+        }
+        else if (0 == strcmp(argv[i], "--trace") && i + 1 < argc)
+        {
+            options.p_trace_path = argv[++i];
+        }
+        else if (0 == strcmp(argv[i], "--movie") && i + 1 < argc)
+        {
+            options.p_movie_path = argv[++i];
+        }
+        else if (0 == strcmp(argv[i], "--seed") &&
+                 i + 1 < argc && parse_u64(argv[i + 1], &value))
+        {
+            options.seed = value;
+            i++;
+        }
+        else if (0 == strcmp(argv[i], "--batch") &&
+                 i + 1 < argc && parse_u64(argv[i + 1], &value) &&
+                 value > 0 && value <= 65536)
+        {
+            options.batch = (uint32_t)value;
+            i++;
+        }
+        else if ('-' != argv[i][0] &&
+                 rom_count < (int)C8_ARRAY_SIZE(roms))
+        {
+            roms[rom_count++] = argv[i];
+        }
+        else
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    /* One report per run */
+    if ((NULL != options.p_profile_path || NULL != options.p_trace_path) &&
+        rom_count > 1)
+    {
+        fprintf(stderr, "chip8-bench: --profile and --trace take a single ROM\n");
+        return 1;
+    }
+
+    /* Recorded against a ROM file, there is none to replay the built-in with */
+    if (NULL != options.p_movie_path && 1 != rom_count)
+    {
+        fprintf(stderr, "chip8-bench: --movie takes the ROM it was recorded with\n");
+        return 1;
+    }
+
+    /* A frame budget depends on --ipf, which may come later */
+    if (0 != frames)
+    {
+        options.instructions = frames * options.ipf;
+    }
+
+    printf("chip8-bench: %"PRIu64" instructions, %"PRIu32" instructions/frame, best of %"PRIu32", %s dispatch\n",
+           options.instructions, options.ipf, options.repeat,
+           C8_DISPATCH_THREADED ? "threaded" : "switch");
+
+    for (i = 0; i < rom_count; i++)
+    {
+        if (C8_FALSE == bench_rom(roms[i], &options))
+        {
+            result = C8_FALSE;
+        }
+    }
+
+    if (0 == rom_count)
+    {
+        result = bench_rom(NULL, &options);
+    }
+
+    return (C8_TRUE == result) ? 0 : 1;
+}
+
+/* --- Local Function Definitions --- */
+
+static void print_usage(
+    const char* p_name)
+{
+    printf("usage: %s [options] [path/to/rom ...]\n"
+           "Runs each ROM (or a built-in workload) headless and unpaced.\n"
+           "  -n, --instructions N  instruction budget per run (default %"PRIu64")\n"
+           "  -f, --frames N        frame budget per run, N * ipf instructions\n"
+           "      --ipf N           instructions per frame (default %d)\n"
+           "  -r, --repeat N        runs per ROM, best is reported (default %d)\n"
+           "      --no-breakdown    skip the opcode class breakdown\n"
+           "      --jit             also run the x86-64 recompiler and report the speedup\n"
+           "      --batch N         also run N copies through c8_step and the lockstep\n"
+           "                        batch engine, the budget is split between the copies\n"
+           "      --seed N          seed for CXNN (default %d), copies use N, N + 1, ...\n"
+           "      --snapshot        time saving and restoring the final state\n"
+           "      --rewind          record %d frames into the rewind history and step\n"
+           "                        all the way back\n"
+           "      --skip-idle       also run with idle loop skipping and check the result\n"
+           "      --profile FILE    profile one run and write the report to FILE, JSON\n"
+           "                        if it ends in .json, - for stdout. Needs a build\n"
+           "                        with -DC8_PROFILE=ON\n"
+           "      --trace FILE      time one traced run and dump the last %u\n"
+           "                        instructions to FILE, read it with chip8-tracedump.\n"
+           "                        Needs a build with -DC8_TRACE=ON\n"
+           "      --movie FILE      replay a recording made with --record in chip8-term\n"
+           "                        or chip8-sdl instead of the instruction budget, and\n"
+           "                        check that it ends in the recorded state\n",
+           p_name,
+           (uint64_t)BENCH_DEFAULT_INSTRUCTIONS,
+           BENCH_DEFAULT_IPF,
+           BENCH_DEFAULT_REPEAT,
+           C8_DEFAULT_SEED,
+           C8_REWIND_DEFAULT_FRAMES,
+           C8_TRACE_DEFAULT_RECORDS);
+}
+
+static int parse_u64(
+    const char* p_str,
+    uint64_t*   p_out)
+{
+    char* p_end = NULL;
+    unsigned long long value = strtoull(p_str, &p_end, 10);
+
+    if (p_end == p_str || '\0' != *p_end)
+    {
+        return C8_FALSE;
+    }
+
+    *p_out = (uint64_t)value;
+    return C8_TRUE;
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static int bench_prepare(
+    const char*    p_path,
+    uint64_t       seed,
+    struct c8_cpu* p_cpu)
+{
+    c8_init(p_cpu);
+    c8_load_font(p_cpu);
+
+    /* Every run starts from a copy, so CXNN takes the same path each time */
+    c8_seed(p_cpu, seed);
+
+    if (NULL == p_path)
+    {
+        return c8_load_rom(sizeof(bench_builtin_rom), bench_builtin_rom, p_cpu);
+    }
+
+    return c8_load_rom_from_file(p_path, p_cpu);
+}
+
+static void bench_run(
+    const struct c8_cpu*        p_initial,
+    const struct bench_options* p_options,
+    struct c8_jit*              p_jit,
+    struct bench_result*        p_result,
+    struct c8_cpu*              p_final)
+{
+    static struct c8_cpu cpu;
+    uint64_t executed = 0;
+    uint64_t frames = 0;
+    uint64_t left;
+    uint32_t budget;
+    uint32_t done;
+    int running = C8_TRUE;
+    double start;
+
+    memcpy(&cpu, p_initial, sizeof(cpu));
+
+    if (NULL != p_jit)
+    {
+        c8_jit_flush(p_jit);
+    }
+
+    start = now_seconds();
+
+    while (C8_TRUE == running && executed < p_options->instructions)
+    {
+        if (NULL != p_jit)
+        {
+            left = p_options->instructions - executed;
+            budget = (left < p_options->ipf) ? (uint32_t)left : p_options->ipf;
+
+            running = c8_jit_run(p_jit, &cpu, budget) && cpu.pc < cpu.pc_max;
+            executed += budget;
+        }
+        else
+        {
+            left = p_options->instructions - executed;
+            budget = (left < p_options->ipf) ? (uint32_t)left : p_options->ipf;
+
+            /* FX0A stops the batch early, keep going so that both
+             * engines see the same number of instructions per frame */
+            while (C8_TRUE == running && budget > 0)
+            {
+                running = C8_RUN_ERROR != c8_run(&cpu, budget, p_options->run_flags, &done);
+                budget -= done;
+                executed += done;
+            }
+        }
+
+        c8_decrement_timers(&cpu);
+        frames++;
+    }
+
+    p_result->seconds = now_seconds() - start;
+    p_result->instructions = executed;
+    p_result->frames = frames;
+
+    memcpy(p_final, &cpu, sizeof(cpu));
+}
+
+static void bench_best(
+    const struct c8_cpu*        p_initial,
+    const struct bench_options* p_options,
+    struct c8_jit*              p_jit,
+    struct bench_result*        p_best,
+    struct c8_cpu*              p_final)
+{
+    struct bench_result run;
+    uint32_t i;
+
+    for (i = 0; i < p_options->repeat; i++)
+    {
+        bench_run(p_initial, p_options, p_jit, &run, p_final);
+
+        if (0 == i || run.seconds < p_best->seconds)
+        {
+            *p_best = run;
+        }
+    }
+
+    if (p_best->seconds <= 0.0)
+    {
+        p_best->seconds = 1e-9;
+    }
+}
+
+static void bench_report(
+    const char*                p_label,
+    const struct bench_result* p_result)
+{
+    printf("  %s\n", p_label);
+    printf("    instructions:     %14"PRIu64"\n", p_result->instructions);
+    printf("    frames:           %14"PRIu64"\n", p_result->frames);
+    printf("    time:             %14.6f s\n", p_result->seconds);
+    printf("    instructions/sec: %14.0f\n", (double)p_result->instructions / p_result->seconds);
+    printf("    frames/sec:       %14.0f\n", (double)p_result->frames / p_result->seconds);
+    printf("    ns/instruction:   %14.3f\n",
+           (0 != p_result->instructions) ?
+           p_result->seconds * 1e9 / (double)p_result->instructions : 0.0);
+}
+
+static int bench_same_state(
+    const struct c8_cpu* p_a,
+    const struct c8_cpu* p_b)
+{
+    return 0 == memcmp(p_a->ram, p_b->ram, sizeof(p_a->ram)) &&
+           0 == memcmp(p_a->V, p_b->V, sizeof(p_a->V)) &&
+           0 == memcmp(p_a->stack, p_b->stack, sizeof(p_a->stack)) &&
+           0 == memcmp(p_a->screen, p_b->screen, sizeof(p_a->screen)) &&
+           0 == memcmp(p_a->flags, p_b->flags, sizeof(p_a->flags)) &&
+           p_a->screen_w == p_b->screen_w &&
+           p_a->pc == p_b->pc &&
+           p_a->I == p_b->I &&
+           p_a->sp == p_b->sp &&
+           p_a->delay_timer == p_b->delay_timer &&
+           p_a->sound_timer == p_b->sound_timer;
+}
+
+static void bench_breakdown(
+    const struct c8_cpu*        p_initial,
+    const struct bench_options* p_options)
+{
+    static struct c8_cpu cpu;
+    uint64_t counts[16] = { 0 };
+    uint64_t executed = 0;
+    uint32_t i;
+    int running = C8_TRUE;
+
+    memcpy(&cpu, p_initial, sizeof(cpu));
+
+    /* Separate, untimed pass so that counting does not skew the numbers */
+    while (C8_TRUE == running && executed < p_options->instructions)
+    {
+        for (i = 0; i < p_options->ipf && executed < p_options->instructions; i++)
+        {
+            if (cpu.pc >= cpu.pc_max)
+            {
+                running = C8_FALSE;
+                break;
+            }
+
+            counts[cpu.ram[cpu.pc] >> 4]++;
+
+            if (C8_FALSE == c8_step(&cpu))
+            {
+                running = C8_FALSE;
+                break;
+            }
+
+            executed++;
+        }
+
+        c8_decrement_timers(&cpu);
+    }
+
+    printf("  opcode classes:\n");
+
+    for (i = 0; i < 16; i++)
+    {
+        if (0 != counts[i])
+        {
+            printf("    %-18s %14"PRIu64"  %6.2f%%\n",
+                   bench_class_names[i],
+                   counts[i],
+                   100.0 * (double)counts[i] / (double)executed);
+        }
+    }
+}
+
+/* Copies differ in their delay timer and seed so that they fall out of step */
+#define BENCH_LANE_DT(lane) ((lane) % 8)
+
+static void bench_lane_setup(
+    struct c8_cpu*              p_cpu,
+    const struct bench_options* p_options,
+    uint32_t                    lane)
+{
+    p_cpu->delay_timer = BENCH_LANE_DT(lane);
+    c8_seed(p_cpu, p_options->seed + lane);
+}
+
+/**
+ * Baseline for the batch engine, each copy stepped on its own.
+ */
+static void bench_lanes_run(
+    const struct c8_cpu*        p_initial,
+    const struct bench_options* p_options,
+    struct c8_cpu*              p_cpus,
+    struct bench_result*        p_result)
+{
+    const uint32_t count = p_options->batch;
+    const uint64_t frames = p_options->instructions / count / p_options->ipf;
+    uint32_t lane;
+    uint64_t frame;
+    uint32_t i;
+    double start;
+
+    for (lane = 0; lane < count; lane++)
+    {
+        memcpy(&p_cpus[lane], p_initial, sizeof(*p_initial));
+        bench_lane_setup(&p_cpus[lane], p_options, lane);
+    }
+
+    start = now_seconds();
+
+    for (lane = 0; lane < count; lane++)
+    {
+        for (frame = 0; frame < frames; frame++)
+        {
+            for (i = 0; i < p_options->ipf; i++)
+            {
+                c8_step(&p_cpus[lane]);
+            }
+
+            c8_decrement_timers(&p_cpus[lane]);
+        }
+    }
+
+    p_result->seconds = now_seconds() - start;
+    p_result->instructions = frames * p_options->ipf * count;
+    p_result->frames = frames * count;
+}
+
+static struct c8_batch* bench_batch_run(
+    const struct c8_cpu*        p_initial,
+    const struct bench_options* p_options,
+    uint32_t                    flags,
+    struct bench_result*        p_result)
+{
+    const uint32_t count = p_options->batch;
+    const uint64_t frames = p_options->instructions / count / p_options->ipf;
+    struct c8_batch* p_batch;
+    uint32_t lane;
+    uint64_t frame;
+    double start;
+
+    p_batch = c8_batch_create(p_initial, count, flags);
+
+    if (NULL == p_batch)
+    {
+        memset(p_result, 0x00, sizeof(*p_result));
+        return NULL;
+    }
+
+    for (lane = 0; lane < count; lane++)
+    {
+        bench_lane_setup(c8_batch_cpu(p_batch, lane), p_options, lane);
+    }
+
+    start = now_seconds();
+
+    for (frame = 0; frame < frames; frame++)
+    {
+        c8_batch_run(p_batch, p_options->ipf);
+        c8_batch_decrement_timers(p_batch);
+    }
+
+    p_result->seconds = now_seconds() - start;
+    p_result->instructions = frames * p_options->ipf * count;
+    p_result->frames = frames * count;
+
+    return p_batch;
+}
+
+static void bench_batch(
+    const struct c8_cpu*        p_initial,
+    const struct bench_options* p_options)
+{
+    static const uint32_t modes[2] = { C8_BATCH_SCALAR, 0 };
+    struct c8_batch* batches[2] = { NULL, NULL };
+    struct bench_result lanes;
+    struct bench_result best[2];
+    struct bench_result run;
+    struct c8_batch* p_batch;
+    struct c8_cpu* p_cpus;
+    uint32_t lane;
+    uint32_t mode;
+    uint32_t i;
+    int same_scalar = C8_TRUE;
+    int same_step = C8_TRUE;
+
+    if (p_options->instructions / p_options->batch < p_options->ipf)
+    {
+        printf("  batch: budget too small for %"PRIu32" copies\n", p_options->batch);
+        return;
+    }
+
+    p_cpus = malloc(p_options->batch * sizeof(struct c8_cpu));
+
+    if (NULL == p_cpus)
+    {
+        printf("  batch: out of memory\n");
+        return;
+    }
+
+    for (i = 0; i < p_options->repeat; i++)
+    {
+        bench_lanes_run(p_initial, p_options, p_cpus, &run);
+
+        if (0 == i || run.seconds < lanes.seconds)
+        {
+            lanes = run;
+        }
+    }
+
+    printf("  %"PRIu32" copies\n", p_options->batch);
+    bench_report("c8_step per copy", &lanes);
+
+    /* Keep the last batch of each mode to compare the final states */
+    for (mode = 0; mode < C8_ARRAY_SIZE(modes); mode++)
+    {
+        for (i = 0; i < p_options->repeat; i++)
+        {
+            p_batch = bench_batch_run(p_initial, p_options, modes[mode], &run);
+
+            if (NULL == p_batch)
+            {
+                printf("  batch: out of memory\n");
+                c8_batch_destroy(batches[0]);
+                c8_batch_destroy(batches[1]);
+                free(p_cpus);
+                return;
+            }
+
+            if (0 == i || run.seconds < best[mode].seconds)
+            {
+                best[mode] = run;
+            }
+
+            c8_batch_destroy(batches[mode]);
+            batches[mode] = p_batch;
+        }
+
+        bench_report((C8_BATCH_SCALAR == modes[mode]) ? "batch, scalar" : "batch, SIMD",
+                     &best[mode]);
+        printf("    speedup:          %14.2fx\n", lanes.seconds / best[mode].seconds);
+    }
+
+    for (lane = 0; lane < p_options->batch; lane++)
+    {
+        same_scalar = same_scalar &&
+                      bench_same_state(c8_batch_cpu(batches[0], lane),
+                                       c8_batch_cpu(batches[1], lane));
+        same_step = same_step &&
+                    bench_same_state(&p_cpus[lane], c8_batch_cpu(batches[1], lane));
+    }
+
+    printf("    SIMD vs scalar:   %14s\n", same_scalar ? "match" : "MISMATCH");
+    printf("    SIMD vs c8_step:  %14s\n", same_step ? "match" : "MISMATCH");
+
+    c8_batch_destroy(batches[0]);
+    c8_batch_destroy(batches[1]);
+    free(p_cpus);
+}
+
+/**
+ * Save and restore the state at the end of the run against the RAM the
+ * run started from, the usual base for a loaded ROM.
+ */
+static void bench_snapshot(
+    const struct c8_cpu* p_initial,
+    const struct c8_cpu* p_final)
+{
+    static uint8_t buffer[C8_SNAPSHOT_MAX_SIZE];
+    static uint8_t resaved[C8_SNAPSHOT_MAX_SIZE];
+    static uint8_t corrupt[C8_SNAPSHOT_MAX_SIZE];
+    static struct c8_cpu cpu;
+    static struct c8_cpu check;
+    uint32_t size = 0;
+    uint32_t resaved_size;
+    double save_seconds;
+    double load_seconds;
+    double start;
+    int loaded = C8_TRUE;
+    int rejected;
+    uint32_t i;
+
+    memcpy(&cpu, p_initial, sizeof(cpu));
+
+    start = now_seconds();
+
+    for (i = 0; i < BENCH_SNAPSHOT_ROUNDS; i++)
+    {
+        size = c8_snapshot_save(p_final, p_initial->ram, buffer, sizeof(buffer));
+    }
+
+    save_seconds = now_seconds() - start;
+    start = now_seconds();
+
+    for (i = 0; i < BENCH_SNAPSHOT_ROUNDS; i++)
+    {
+        loaded &= c8_snapshot_load(&cpu, p_initial->ram, buffer, size);
+    }
+
+    load_seconds = now_seconds() - start;
+    resaved_size = c8_snapshot_save(&cpu, p_initial->ram, resaved, sizeof(resaved));
+
+    /* A program counter outside ram, then one past the end of the
+     * program, has to be rejected without touching the CPU
+     */
+    memcpy(&check, &cpu, sizeof(check));
+    memcpy(corrupt, buffer, size);
+    c8_put_le(&corrupt[6], 0x3000, 2);
+    c8_put_le(&corrupt[8], 0xFFFF, 2);
+    rejected = (C8_FALSE == c8_snapshot_load(&cpu, p_initial->ram, corrupt, size));
+    c8_put_le(&corrupt[6], p_final->pc_max + 1u, 2);
+    c8_put_le(&corrupt[8], p_final->pc_max, 2);
+    rejected &= (C8_FALSE == c8_snapshot_load(&cpu, p_initial->ram, corrupt, size));
+    rejected &= (0 == memcmp(&check, &cpu, sizeof(check)));
+
+    printf("  snapshot\n");
+    printf("    size:             %14"PRIu32" bytes\n", size);
+    printf("    save:             %14.1f ns\n", save_seconds * 1e9 / BENCH_SNAPSHOT_ROUNDS);
+    printf("    restore:          %14.1f ns\n", load_seconds * 1e9 / BENCH_SNAPSHOT_ROUNDS);
+    printf("    round trip:       %14s\n",
+           (C8_TRUE == loaded && resaved_size == size &&
+            0 == memcmp(buffer, resaved, size) &&
+            c8_hash_screen(&cpu) == c8_hash_screen(p_final)) ? "match" : "MISMATCH");
+    printf("    corrupt input:    %14s\n", (C8_TRUE == rejected) ? "rejected" : "ACCEPTED");
+}
+
+/**
+ * Fill a default sized rewind history frame by frame like the frontends,
+ * then step back to the start.
+ */
+static void bench_rewind(
+    const struct c8_cpu*        p_initial,
+    const struct bench_options* p_options)
+{
+    static struct c8_cpu cpu;
+    struct c8_rewind* p_rewind;
+    double push_seconds = 0.0;
+    double back_seconds;
+    double start;
+    uint32_t frames;
+    uint32_t steps = 0;
+    uint32_t frame;
+    uint32_t i;
+
+    p_rewind = c8_rewind_create(C8_REWIND_DEFAULT_FRAMES, C8_REWIND_DEFAULT_BYTES);
+
+    if (NULL == p_rewind)
+    {
+        printf("  rewind: out of memory\n");
+        return;
+    }
+
+    memcpy(&cpu, p_initial, sizeof(cpu));
+    c8_rewind_push(p_rewind, &cpu);
+
+    for (frame = 0; frame < C8_REWIND_DEFAULT_FRAMES; frame++)
+    {
+        for (i = 0; i < p_options->ipf; i++)
+        {
+            c8_step(&cpu);
+        }
+
+        c8_decrement_timers(&cpu);
+
+        start = now_seconds();
+        c8_rewind_push(p_rewind, &cpu);
+        push_seconds += now_seconds() - start;
+    }
+
+    frames = c8_rewind_frames(p_rewind);
+
+    printf("  rewind\n");
+    printf("    frames kept:      %14"PRIu32" / %d\n", frames, C8_REWIND_DEFAULT_FRAMES);
+    printf("    bytes:            %14"PRIu32"\n", c8_rewind_bytes(p_rewind));
+    printf("    bytes/frame:      %14.1f\n",
+           (0 != frames) ? (double)c8_rewind_bytes(p_rewind) / frames : 0.0);
+    printf("    record:           %14.1f ns/frame\n",
+           push_seconds * 1e9 / C8_REWIND_DEFAULT_FRAMES);
+
+    start = now_seconds();
+
+    while (C8_TRUE == c8_rewind_step_back(p_rewind, &cpu))
+    {
+        steps++;
+    }
+
+    back_seconds = now_seconds() - start;
+
+    printf("    step back:        %14.1f ns/frame\n",
+           (0 != steps) ? back_seconds * 1e9 / steps : 0.0);
+
+    if (C8_REWIND_DEFAULT_FRAMES == frames)
+    {
+        printf("    back to start:    %14s\n",
+               bench_same_state(&cpu, p_initial) ? "match" : "MISMATCH");
+    }
+
+    c8_rewind_destroy(p_rewind);
+}
+
+static int bench_profile(
+    const struct c8_cpu*        p_initial,
+    const struct bench_options* p_options)
+{
+    static struct c8_cpu cpu;
+    struct c8_profile* p_profile;
+    uint64_t executed = 0;
+    uint64_t left;
+    uint32_t budget;
+    uint32_t done;
+    int running = C8_TRUE;
+    int result;
+
+    p_profile = c8_profile_create();
+
+    if (NULL == p_profile)
+    {
+        printf("  profile: out of memory\n");
+        return C8_FALSE;
+    }
+
+    memcpy(&cpu, p_initial, sizeof(cpu));
+
+    if (C8_FALSE == c8_profile_attach(&cpu, p_profile))
+    {
+        printf("  profile: not built in, configure with -DC8_PROFILE=ON\n");
+        c8_profile_destroy(p_profile);
+        return C8_FALSE;
+    }
+
+    /* Same frames as the interpreter runs */
+    while (C8_TRUE == running && executed < p_options->instructions)
+    {
+        left = p_options->instructions - executed;
+        budget = (left < p_options->ipf) ? (uint32_t)left : p_options->ipf;
+
+        while (C8_TRUE == running && budget > 0)
+        {
+            running = C8_RUN_ERROR != c8_run(&cpu, budget, p_options->run_flags, &done);
+            budget -= done;
+            executed += done;
+        }
+
+        c8_decrement_timers(&cpu);
+    }
+
+    c8_profile_attach(&cpu, NULL);
+    result = c8_profile_write(p_profile, p_options->p_profile_path);
+
+    printf("  profile:            %14s\n", result ? p_options->p_profile_path : "write failed");
+
+    c8_profile_destroy(p_profile);
+
+    return result;
+}
+
+static int bench_trace(
+    const struct c8_cpu*        p_initial,
+    const struct bench_options* p_options,
+    const struct bench_result*  p_interp,
+    const struct c8_cpu*        p_final)
+{
+    static struct c8_cpu traced;
+    static struct c8_cpu final_traced;
+    struct bench_result run;
+    struct c8_trace* p_trace;
+    int result;
+
+    p_trace = c8_trace_create(C8_TRACE_DEFAULT_RECORDS);
+
+    if (NULL == p_trace)
+    {
+        printf("  trace: out of memory\n");
+        return C8_FALSE;
+    }
+
+    memcpy(&traced, p_initial, sizeof(traced));
+
+    if (C8_FALSE == c8_trace_attach(&traced, p_trace))
+    {
+        printf("  trace: not built in, configure with -DC8_TRACE=ON\n");
+        c8_trace_destroy(p_trace);
+        return C8_FALSE;
+    }
+
+    /* Every repeat records into the same ring, the last one is dumped */
+    bench_best(&traced, p_options, NULL, &run, &final_traced);
+    bench_report("trace", &run);
+    printf("    overhead:         %14.3f ns/instruction\n",
+           (0 != run.instructions) ?
+           (run.seconds - p_interp->seconds) * 1e9 / (double)run.instructions : 0.0);
+    printf("    final state:      %14s\n",
+           (run.instructions == p_interp->instructions &&
+            bench_same_state(p_final, &final_traced)) ? "match" : "MISMATCH");
+
+    result = c8_trace_dump(p_trace, p_options->p_trace_path);
+
+    printf("  trace:              %14s\n", result ? p_options->p_trace_path : "write failed");
+
+    c8_trace_destroy(p_trace);
+
+    return result;
+}
+
+static void bench_movie_run(
+    const struct c8_cpu*        p_initial,
+    const struct bench_options* p_options,
+    struct c8_movie*            p_movie,
+    struct bench_result*        p_result,
+    struct c8_cpu*              p_final)
+{
+    static struct c8_cpu cpu;
+    struct c8_pacer pacer;
+    enum c8_run_stop stop = C8_RUN_BUDGET;
+    uint64_t executed = 0;
+    uint64_t frames = 0;
+    uint32_t budget;
+    uint32_t done;
+    double start;
+
+    memcpy(&cpu, p_initial, sizeof(cpu));
+    c8_pacer_init(&pacer, p_movie->ips);
+    c8_movie_rewind(p_movie);
+
+    start = now_seconds();
+
+    /* Frames as the frontends run them, the rest of the budget is
+     * dropped while FX0A waits */
+    while (C8_RUN_ERROR != stop && C8_TRUE == c8_movie_next(p_movie, &cpu))
+    {
+        budget = c8_pacer_budget(&pacer);
+
+        do
+        {
+            stop = c8_run(&cpu, budget, p_options->run_flags, &done);
+            budget -= done;
+            executed += done;
+        } while (C8_RUN_DRAW == stop && budget > 0);
+
+        c8_decrement_timers(&cpu);
+        frames++;
+    }
+
+    p_result->seconds = now_seconds() - start;
+    p_result->instructions = executed;
+    p_result->frames = frames;
+
+    memcpy(p_final, &cpu, sizeof(cpu));
+}
+
+static int bench_movie(
+    const char*                 p_path,
+    const struct bench_options* p_options)
+{
+    static struct c8_cpu initial;
+    static struct c8_cpu final;
+    struct bench_result run;
+    struct bench_result best;
+    struct c8_movie* p_movie;
+    uint32_t i;
+    int result;
+
+    p_movie = c8_movie_load(p_options->p_movie_path);
+
+    if (NULL == p_movie)
+    {
+        fprintf(stderr, "chip8-bench: failed to load movie '%s'\n", p_options->p_movie_path);
+        return C8_FALSE;
+    }
+
+    /* Same start as the frontends, the recorded seed instead of --seed */
+    if (C8_FALSE == bench_prepare(p_path, p_movie->seed, &initial))
+    {
+        fprintf(stderr, "chip8-bench: failed to load '%s'\n", p_path);
+        c8_movie_destroy(p_movie);
+        return C8_FALSE;
+    }
+
+    printf("%s\n", p_path);
+
+    if (c8_movie_hash_rom(&initial) != p_movie->rom_hash)
+    {
+        printf("  movie: recorded with a different ROM\n");
+        c8_movie_destroy(p_movie);
+        return C8_FALSE;
+    }
+
+    bench_movie_run(&initial, p_options, p_movie, &best, &final);
+
+    for (i = 1; i < p_options->repeat; i++)
+    {
+        bench_movie_run(&initial, p_options, p_movie, &run, &final);
+
+        if (run.seconds < best.seconds)
+        {
+            best = run;
+        }
+    }
+
+    if (best.seconds <= 0.0)
+    {
+        best.seconds = 1e-9;
+    }
+
+    bench_report("movie", &best);
+
+    result = (best.frames == p_movie->frames &&
+              c8_movie_hash_state(&final) == p_movie->state_hash);
+
+    printf("    seed:             %14"PRIu64"\n", p_movie->seed);
+    printf("    input events:     %14"PRIu32"\n", p_movie->event_count);
+    printf("    final state:      %14s\n", result ? "match" : "MISMATCH");
+
+    c8_movie_destroy(p_movie);
+
+    return result ? C8_TRUE : C8_FALSE;
+}
+
+static int bench_rom(
+    const char*                 p_path,
+    const struct bench_options* p_options)
+{
+    static struct c8_cpu initial;
+    static struct c8_cpu final_interp;
+    static struct c8_cpu final_jit;
+    static struct c8_cpu final_idle;
+    struct bench_options idle_options;
+    struct bench_result interp;
+    struct bench_result jit;
+    struct bench_result idle;
+    struct c8_jit* p_jit;
+
+    if (NULL != p_options->p_movie_path)
+    {
+        return bench_movie(p_path, p_options);
+    }
+
+    if (C8_FALSE == bench_prepare(p_path, p_options->seed, &initial))
+    {
+        fprintf(stderr, "chip8-bench: failed to load '%s'\n", p_path);
+        return C8_FALSE;
+    }
+
+    printf("%s\n", (NULL == p_path) ? "<built-in>" : p_path);
+
+    bench_best(&initial, p_options, NULL, &interp, &final_interp);
+    bench_report("interpreter", &interp);
+
+    if (C8_TRUE == p_options->jit)
+    {
+        p_jit = c8_jit_create();
+
+        if (NULL == p_jit)
+        {
+            printf("  jit: not available on this host\n");
+        }
+        else
+        {
+            bench_best(&initial, p_options, p_jit, &jit, &final_jit);
+            bench_report("jit", &jit);
+            printf("    speedup:          %14.2fx\n", interp.seconds / jit.seconds);
+
+            if (jit.instructions == interp.instructions)
+            {
+                printf("    final state:      %14s\n",
+                       bench_same_state(&final_interp, &final_jit) ? "match" : "MISMATCH");
+            }
+
+            c8_jit_destroy(p_jit);
+        }
+    }
+
+    if (C8_TRUE == p_options->skip_idle)
+    {
+        idle_options = *p_options;
+        idle_options.run_flags |= C8_RUN_SKIP_IDLE;
+
+        bench_best(&initial, &idle_options, NULL, &idle, &final_idle);
+        bench_report("skip idle", &idle);
+        printf("    speedup:          %14.2fx\n", interp.seconds / idle.seconds);
+        printf("    final state:      %14s\n",
+               (idle.instructions == interp.instructions &&
+                bench_same_state(&final_interp, &final_idle)) ? "match" : "MISMATCH");
+    }
+
+    if (NULL != p_options->p_trace_path &&
+        C8_FALSE == bench_trace(&initial, p_options, &interp, &final_interp))
+    {
+        return C8_FALSE;
+    }
+
+    if (0 != p_options->batch)
+    {
+        bench_batch(&initial, p_options);
+    }
+
+    if (C8_TRUE == p_options->snapshot)
+    {
+        bench_snapshot(&initial, &final_interp);
+    }
+
+    if (C8_TRUE == p_options->rewind)
+    {
+        bench_rewind(&initial, p_options);
+    }
+
+    if (C8_TRUE == p_options->breakdown)
+    {
+        bench_breakdown(&initial, p_options);
+    }
+
+    if (NULL != p_options->p_profile_path)
+    {
+        return bench_profile(&initial, p_options);
+    }
+
+    return C8_TRUE;
+}
@@ -0,0 +1,915 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "c8_batch.h"
+#include "c8_bytes.h"
+#include "c8_cpu.h"
+#include "c8_jit.h"
+#include "c8_movie.h"
+
+#define CONFORM_FRAMES (600)
+
+/* Keys of the hex keypad as bits of a key mask */
+#define K(key) (1u << (key))
+
+/**
+ * Keys held from a frame on, until the next input.
+ */
+struct conform_input {
+    uint32_t frame;
+    uint16_t keys;
+};
+
+/**
+ * One test: a ROM, its settings and the keys pressed while it runs.
+ * Every frame is a checkpoint, golden is all checkpoint hashes folded
+ * into one, see conform_fold.
+ */
+struct conform_case {
+    const char*                 p_name;
+    const uint8_t*              p_rom;
+    uint32_t                    rom_size;
+    uint64_t                    seed;
+    uint32_t                    ipf;
+    const struct conform_input* p_inputs;
+    uint32_t                    input_count;
+    /* Non-zero: pseudo-random keys, new ones every mash frames */
+    uint32_t                    mash;
+    uint64_t                    golden;
+};
+
+/**
+ * Runs count cases that share ROM, seed and ipf, and stores
+ * CONFORM_FRAMES checkpoint hashes per case.
+ */
+typedef void (*conform_run_fn)(
+    const struct conform_case* p_cases,
+    uint32_t                   count,
+    uint64_t*                  p_hashes);
+
+struct conform_engine {
+    const char*    p_name;
+    conform_run_fn run;
+};
+
+/* --- Test ROMs --- */
+
+/* ALU ops with their VF results, BCD and register dumps over a sweep of
+ * operand pairs, results drawn as font digits. */
+static const uint8_t conform_rom_alu[] = {
+    0x60, 0x00, /* 200: V0 = 0         */
+    0x61, 0x00, /* 202: V1 = 0         */
+    0x82, 0x00, /* 204: V2 = V0        */
+    0x82, 0x14, /* 206: V2 += V1       */
+    0x83, 0x00, /* 208: V3 = V0        */
+    0x83, 0x15, /* 20A: V3 -= V1       */
+    0x84, 0x00, /* 20C: V4 = V0        */
+    0x84, 0x17, /* 20E: V4 = V1 - V4   */
+    0x85, 0x00, /* 210: V5 = V0        */
+    0x85, 0x06, /* 212: V5 >>= 1       */
+    0x86, 0x00, /* 214: V6 = V1        */
+    0x86, 0x0E, /* 216: V6 <<= 1       */
+    0x87, 0x00, /* 218: V7 = V0        */
+    0x87, 0x11, /* 21A: V7 |= V1       */
+    0x88, 0x00, /* 21C: V8 = V0        */
+    0x88, 0x12, /* 21E: V8 &= V1       */
+    0x89, 0x00, /* 220: V9 = V0        */
+    0x89, 0x13, /* 222: V9 ^= V1       */
+    0x8A, 0xF0, /* 224: VA = VF        */
+    0x8A, 0x34, /* 226: VA += V3       */
+    0xAE, 0x00, /* 228: I = 0xE00      */
+    0xF0, 0x1E, /* 22A: I += V0        */
+    0xFF, 0x55, /* 22C: dump V0-VF     */
+    0xAD, 0x00, /* 22E: I = 0xD00      */
+    0xF4, 0x33, /* 230: BCD V4         */
+    0x8D, 0x20, /* 232: VD = V2        */
+    0x6E, 0x0F, /* 234: VE = 0x0F      */
+    0x8D, 0xE2, /* 236: VD &= VE       */
+    0xFD, 0x29, /* 238: I = font VD    */
+    0x8B, 0x00, /* 23A: VB = V0        */
+    0x8C, 0x10, /* 23C: VC = V1        */
+    0xDB, 0xC5, /* 23E: DRW VB, VC, 5  */
+    0x70, 0x07, /* 240: V0 += 7        */
+    0x71, 0x13, /* 242: V1 += 0x13     */
+    0x12, 0x04, /* 244: jump loop      */
+};
+
+/* Sprites of height 1, 5 and 15 at moving positions that wrap at both
+ * edges, collisions counted from VF, periodic CLS. */
+static const uint8_t conform_rom_draw[] = {
+    0x00, 0xE0, /* 200: CLS            */
+    0x60, 0x00, /* 202: V0 = 0         */
+    0x61, 0x00, /* 204: V1 = 0         */
+    0x62, 0x38, /* 206: V2 = 56        */
+    0x63, 0x1C, /* 208: V3 = 28        */
+    0xA2, 0x34, /* 20A: I = sprite     */
+    0xD0, 0x1F, /* 20C: DRW V0, V1, 15 */
+    0x3F, 0x00, /* 20E: skip VF == 0   */
+    0x74, 0x01, /* 210: V4 += 1        */
+    0xD2, 0x35, /* 212: DRW V2, V3, 5  */
+    0xD4, 0x51, /* 214: DRW V4, V5, 1  */
+    0xF4, 0x1E, /* 216: I += V4        */
+    0xD6, 0x71, /* 218: DRW V6, V7, 1  */
+    0x70, 0x05, /* 21A: V0 += 5        */
+    0x71, 0x0B, /* 21C: V1 += 11       */
+    0x72, 0x03, /* 21E: V2 += 3        */
+    0x73, 0xFF, /* 220: V3 -= 1        */
+    0x76, 0x03, /* 222: V6 += 3        */
+    0x77, 0x09, /* 224: V7 += 9        */
+    0x75, 0x02, /* 226: V5 += 2        */
+    0x88, 0x00, /* 228: V8 = V0        */
+    0x69, 0x38, /* 22A: V9 = 0x38      */
+    0x88, 0x92, /* 22C: V8 &= V9       */
+    0x48, 0x00, /* 22E: skip V8 != 0   */
+    0x00, 0xE0, /* 230: CLS            */
+    0x12, 0x0A, /* 232: jump loop      */
+    0xF0, 0x90, /* 234: sprite         */
+    0x90, 0xF0, /* 236:                */
+    0x3C, 0x7E, /* 238:                */
+    0xFF, 0xDB, /* 23A:                */
+    0x81, 0x42, /* 23C:                */
+    0x24, 0x18, /* 23E:                */
+    0xFF, 0x81, /* 240:                */
+    0xAA, 0x55, /* 242:                */
+};
+
+/* Calls three deep, a BNNN jump table, 5XY0 / 9XY0 skips and FX55 /
+ * FX65 round trips through the same memory. */
+static const uint8_t conform_rom_calls[] = {
+    0x65, 0x00, /* 200: V5 = 0         */
+    0x22, 0x38, /* 202: call sub1      */
+    0x80, 0x50, /* 204: V0 = V5        */
+    0x6D, 0x06, /* 206: VD = 6         */
+    0x80, 0xD2, /* 208: V0 &= VD       */
+    0xB2, 0x0C, /* 20A: jump table + V0 */
+    0x12, 0x14, /* 20C: jump t0        */
+    0x12, 0x18, /* 20E: jump t1        */
+    0x12, 0x1C, /* 210: jump t2        */
+    0x12, 0x20, /* 212: jump t3        */
+    0x7A, 0x01, /* 214: VA += 1        */
+    0x12, 0x22, /* 216: jump join      */
+    0x7B, 0x03, /* 218: VB += 3        */
+    0x12, 0x22, /* 21A: jump join      */
+    0x8A, 0xB4, /* 21C: VA += VB       */
+    0x12, 0x22, /* 21E: jump join      */
+    0x8B, 0xA5, /* 220: VB -= VA       */
+    0x5A, 0xB0, /* 222: skip VA == VB  */
+    0x7C, 0x01, /* 224: VC += 1        */
+    0x95, 0x60, /* 226: skip V5 != V6  */
+    0x7C, 0x10, /* 228: VC += 0x10     */
+    0x75, 0x01, /* 22A: V5 += 1        */
+    0x86, 0x50, /* 22C: V6 = V5        */
+    0xAE, 0x00, /* 22E: I = 0xE00      */
+    0xFC, 0x65, /* 230: load V0-VC     */
+    0x75, 0x01, /* 232: V5 += 1        */
+    0x76, 0x01, /* 234: V6 += 1        */
+    0x12, 0x02, /* 236: jump loop      */
+    0xAE, 0x00, /* 238: I = 0xE00      */
+    0xF3, 0x55, /* 23A: dump V0-V3     */
+    0x71, 0x01, /* 23C: V1 += 1        */
+    0x22, 0x42, /* 23E: call sub2      */
+    0x00, 0xEE, /* 240: RET            */
+    0x72, 0x03, /* 242: V2 += 3        */
+    0xAE, 0x04, /* 244: I = 0xE04      */
+    0xF2, 0x33, /* 246: BCD V2         */
+    0x22, 0x4C, /* 248: call sub3      */
+    0x00, 0xEE, /* 24A: RET            */
+    0x83, 0xA3, /* 24C: V3 ^= VA       */
+    0xAE, 0x08, /* 24E: I = 0xE08      */
+    0xFC, 0x55, /* 250: dump V0-VC     */
+    0xF3, 0x29, /* 252: I = font V3    */
+    0xD1, 0x25, /* 254: DRW V1, V2, 5  */
+    0x00, 0xEE, /* 256: RET            */
+};
+
+/* Moves a sprite with keys 2, 4, 6 and 8 (EXA1 and EX9E), every 16th
+ * pass waits for a key with FX0A, and each pass polls the delay timer
+ * in an idle loop. */
+static const uint8_t conform_rom_keys[] = {
+    0x00, 0xE0, /* 200: CLS            */
+    0x60, 0x14, /* 202: V0 = 20        */
+    0x61, 0x10, /* 204: V1 = 16        */
+    0xA2, 0x48, /* 206: I = sprite     */
+    0xD0, 0x14, /* 208: DRW V0, V1, 4  */
+    0xD0, 0x14, /* 20A: DRW V0, V1, 4  */
+    0x62, 0x02, /* 20C: V2 = 2         */
+    0xE2, 0xA1, /* 20E: skip key V2 up */
+    0x71, 0xFF, /* 210: V1 -= 1        */
+    0x62, 0x08, /* 212: V2 = 8         */
+    0xE2, 0xA1, /* 214: skip key V2 up */
+    0x71, 0x01, /* 216: V1 += 1        */
+    0x62, 0x04, /* 218: V2 = 4         */
+    0xE2, 0xA1, /* 21A: skip key V2 up */
+    0x70, 0xFF, /* 21C: V0 -= 1        */
+    0x62, 0x06, /* 21E: V2 = 6         */
+    0xE2, 0x9E, /* 220: skip key V2 down */
+    0x12, 0x26, /* 222: jump draw      */
+    0x70, 0x01, /* 224: V0 += 1        */
+    0xD0, 0x14, /* 226: DRW V0, V1, 4  */
+    0x77, 0x10, /* 228: V7 += 0x10     */
+    0x37, 0x00, /* 22A: skip V7 == 0   */
+    0x12, 0x3A, /* 22C: jump timers    */
+    0xF4, 0x0A, /* 22E: V4 = key       */
+    0xF4, 0x29, /* 230: I = font V4    */
+    0x68, 0x38, /* 232: V8 = 56        */
+    0x69, 0x00, /* 234: V9 = 0         */
+    0xD8, 0x95, /* 236: DRW V8, V9, 5  */
+    0xA2, 0x48, /* 238: I = sprite     */
+    0x65, 0x03, /* 23A: V5 = 3         */
+    0xF5, 0x15, /* 23C: DT = V5        */
+    0xF5, 0x18, /* 23E: ST = V5        */
+    0xF6, 0x07, /* 240: V6 = DT        */
+    0x36, 0x00, /* 242: skip V6 == 0   */
+    0x12, 0x40, /* 244: jump wait      */
+    0x12, 0x0A, /* 246: jump loop      */
+    0x60, 0xF0, /* 248: sprite         */
+    0xF0, 0x60, /* 24A:                */
+};
+
+/* CXNN with several masks, drawn and dumped, so every draw from the
+ * generator shows up in the state. */
+static const uint8_t conform_rom_rnd[] = {
+    0xC0, 0x3F, /* 200: V0 = rand & 0x3F */
+    0xC1, 0x1F, /* 202: V1 = rand & 0x1F */
+    0xC2, 0x0F, /* 204: V2 = rand & 0x0F */
+    0xF2, 0x29, /* 206: I = font V2    */
+    0xD0, 0x15, /* 208: DRW V0, V1, 5  */
+    0xC3, 0xFF, /* 20A: V3 = rand      */
+    0x8F, 0x34, /* 20C: VF += V3       */
+    0x43, 0x80, /* 20E: skip V3 != 0x80 */
+    0x00, 0xE0, /* 210: CLS            */
+    0xC4, 0x81, /* 212: V4 = rand & 0x81 */
+    0xAE, 0x00, /* 214: I = 0xE00      */
+    0xF3, 0x1E, /* 216: I += V3        */
+    0xF4, 0x55, /* 218: dump V0-V4     */
+    0x12, 0x00, /* 21A: jump loop      */
+};
+
+/* Self-modifying: FX55 patches the operand of an instruction ahead of
+ * it and BCD overwrites two instructions, before they run. */
+static const uint8_t conform_rom_smc[] = {
+    0x61, 0x00, /* 200: V1 = 0         */
+    0x6B, 0x00, /* 202: VB = 0         */
+    0x60, 0x6A, /* 204: V0 = 0x6A      */
+    0x71, 0x01, /* 206: V1 += 1        */
+    0xA2, 0x0C, /* 208: I = patch      */
+    0xF1, 0x55, /* 20A: dump V0-V1     */
+    0x6A, 0x00, /* 20C: VA = V1 (patched) */
+    0x6D, 0x0F, /* 20E: VD = 0x0F      */
+    0x8A, 0xD2, /* 210: VA &= VD       */
+    0xFA, 0x29, /* 212: I = font VA    */
+    0x8C, 0xA0, /* 214: VC = VA        */
+    0xDB, 0xC5, /* 216: DRW VB, VC, 5  */
+    0x7B, 0x05, /* 218: VB += 5        */
+    0xA2, 0x1E, /* 21A: I = count      */
+    0xFA, 0x33, /* 21C: BCD VA         */
+    0x7E, 0x05, /* 21E: VE += 5, BCD   */
+    0x7E, 0x01, /* 220: VE += 1, BCD   */
+    0x12, 0x04, /* 222: jump loop      */
+};
+
+/* Code at odd addresses: an unaligned entry and loop, with a call to an
+ * even subroutine and back. */
+static const uint8_t conform_rom_odd[] = {
+    0x12, 0x03, /* 200: jump start     */
+    0x00,       /* 202: pad            */
+    0x60, 0x05, /* 203: V0 = 5         */
+    0x70, 0x01, /* 205: V0 += 1        */
+    0x71, 0x03, /* 207: V1 += 3        */
+    0x80, 0x14, /* 209: V0 += V1       */
+    0x6D, 0x0F, /* 20B: VD = 0x0F      */
+    0x8C, 0x00, /* 20D: VC = V0        */
+    0x8C, 0xD2, /* 20F: VC &= VD       */
+    0xFC, 0x29, /* 211: I = font VC    */
+    0xD0, 0x15, /* 213: DRW V0, V1, 5  */
+    0x22, 0x1A, /* 215: call sub       */
+    0x12, 0x05, /* 217: jump loop      */
+    0x00,       /* 219: pad            */
+    0x8E, 0xF0, /* 21A: VE = VF        */
+    0x7E, 0x01, /* 21C: VE += 1        */
+    0x00, 0xEE, /* 21E: return         */
+};
+
+/* SUPER-CHIP: 16x16 and large font sprites that wrap in hi-res, scrolls
+ * in every direction, FX75 / FX85 round trips, 16 passes at a time in
+ * each resolution and a final 00FD. */
+static const uint8_t conform_rom_schip[] = {
+    0x00, 0xFF, /* 200: HIGH           */
+    0x60, 0x00, /* 202: V0 = 0         */
+    0x61, 0x00, /* 204: V1 = 0         */
+    0x65, 0x00, /* 206: V5 = 0         */
+    0xA2, 0x50, /* 208: I = sprite     */
+    0xD0, 0x10, /* 20A: DRW V0, V1, 16x16 */
+    0x8A, 0xF0, /* 20C: VA = VF        */
+    0xF5, 0x30, /* 20E: I = big font V5 */
+    0x82, 0x00, /* 210: V2 = V0        */
+    0x72, 0x76, /* 212: V2 += 0x76     */
+    0x63, 0x3A, /* 214: V3 = 58        */
+    0xD2, 0x3A, /* 216: DRW V2, V3, 10 */
+    0x70, 0x0D, /* 218: V0 += 13       */
+    0x71, 0x07, /* 21A: V1 += 7        */
+    0x00, 0xC3, /* 21C: SCD 3          */
+    0x00, 0xFB, /* 21E: SCR            */
+    0x86, 0x50, /* 220: V6 = V5        */
+    0x67, 0x03, /* 222: V7 = 3         */
+    0x86, 0x72, /* 224: V6 &= V7       */
+    0x36, 0x00, /* 226: skip V6 == 0   */
+    0x00, 0xFC, /* 228: SCL            */
+    0xF1, 0x75, /* 22A: flags = V0-V1  */
+    0x60, 0x00, /* 22C: V0 = 0         */
+    0x61, 0x00, /* 22E: V1 = 0         */
+    0xF1, 0x85, /* 230: V0-V1 = flags  */
+    0x75, 0x01, /* 232: V5 += 1        */
+    0x86, 0x50, /* 234: V6 = V5        */
+    0x67, 0x0F, /* 236: V7 = 0x0F      */
+    0x86, 0x72, /* 238: V6 &= V7       */
+    0x36, 0x00, /* 23A: skip V6 == 0   */
+    0x12, 0x4A, /* 23C: jump next      */
+    0x68, 0x10, /* 23E: V8 = 0x10      */
+    0x88, 0x52, /* 240: V8 &= V5       */
+    0x38, 0x00, /* 242: skip V8 == 0   */
+    0x00, 0xFE, /* 244: LOW            */
+    0x48, 0x00, /* 246: skip V8 != 0   */
+    0x00, 0xFF, /* 248: HIGH           */
+    0x45, 0xC8, /* 24A: skip V5 != 0xC8 */
+    0x00, 0xFD, /* 24C: EXIT           */
+    0x12, 0x08, /* 24E: jump loop      */
+    0x80, 0x01, /* 250: sprite 16x16   */
+    0xC0, 0x03, /* 252:                */
+    0x60, 0x06, /* 254:                */
+    0x30, 0x0C, /* 256:                */
+    0x18, 0x18, /* 258:                */
+    0x0C, 0x30, /* 25A:                */
+    0x06, 0x60, /* 25C:                */
+    0x03, 0xC0, /* 25E:                */
+    0x03, 0xC0, /* 260:                */
+    0x06, 0x60, /* 262:                */
+    0x0C, 0x30, /* 264:                */
+    0x18, 0x18, /* 266:                */
+    0x30, 0x0C, /* 268:                */
+    0x60, 0x06, /* 26A:                */
+    0xC0, 0x03, /* 26C:                */
+    0xFF, 0xFF, /* 26E:                */
+};
+
+
+/* --- Inputs --- */
+
+static const struct conform_input conform_walk[] = {
+    {   0, 0 },
+    {  30, K(0x6) },
+    {  90, K(0x6) | K(0x2) },
+    { 140, K(0x8) },
+    { 200, 0 },
+    { 230, K(0x4) },
+    { 300, K(0x5) },
+    { 301, 0 },
+    { 360, K(0xA) },
+    { 362, 0 },
+    { 420, K(0x6) | K(0x8) },
+    { 500, 0 },
+    { 540, K(0x1) | K(0xF) },
+    { 545, 0 }
+};
+
+/* --- Cases --- */
+
+static struct conform_case conform_cases[] = {
+    { "alu/ipf7", conform_rom_alu, sizeof(conform_rom_alu), 0, 7, NULL, 0, 0, 0xe2dc8759e601b21bull },
+    { "alu/ipf15", conform_rom_alu, sizeof(conform_rom_alu), 0, 15, NULL, 0, 0, 0x57f39aa758642b49ull },
+    { "draw/ipf11", conform_rom_draw, sizeof(conform_rom_draw), 0, 11, NULL, 0, 0, 0x39b27384ef298609ull },
+    { "draw/ipf30", conform_rom_draw, sizeof(conform_rom_draw), 0, 30, NULL, 0, 0, 0xb2499f5bf86cdbefull },
+    { "calls/ipf9", conform_rom_calls, sizeof(conform_rom_calls), 0, 9, NULL, 0, 0, 0x570da7627816d791ull },
+    { "calls/ipf20", conform_rom_calls, sizeof(conform_rom_calls), 0, 20, NULL, 0, 0, 0xe11d89d7db519a41ull },
+    { "keys/none", conform_rom_keys, sizeof(conform_rom_keys), 0, 15, NULL, 0, 0, 0x63e83d62bb6be93cull },
+    { "keys/walk", conform_rom_keys, sizeof(conform_rom_keys), 0, 15, conform_walk, C8_ARRAY_SIZE(conform_walk), 0, 0x4367481e43e4b527ull },
+    { "keys/mash", conform_rom_keys, sizeof(conform_rom_keys), 0, 15, NULL, 0, 3, 0x34328535d30aff2bull },
+    { "rnd/seed0", conform_rom_rnd, sizeof(conform_rom_rnd), 0, 12, NULL, 0, 0, 0x032f28b94889fff5ull },
+    { "rnd/seed1", conform_rom_rnd, sizeof(conform_rom_rnd), 1, 12, NULL, 0, 0, 0x2d2c4ee53c3741c2ull },
+    { "smc/ipf8", conform_rom_smc, sizeof(conform_rom_smc), 0, 8, NULL, 0, 0, 0xf8cc3ab175bbb2ffull },
+    { "smc/ipf17", conform_rom_smc, sizeof(conform_rom_smc), 0, 17, NULL, 0, 0, 0x5b4ea96ce1d8c350ull },
+    { "odd/ipf7", conform_rom_odd, sizeof(conform_rom_odd), 0, 7, NULL, 0, 0, 0x1bdc5a046dcb2d78ull },
+    { "odd/ipf16", conform_rom_odd, sizeof(conform_rom_odd), 0, 16, NULL, 0, 0, 0x6ad054a8bb9fa73cull },
+    { "schip/ipf10", conform_rom_schip, sizeof(conform_rom_schip), 0, 10, NULL, 0, 0, 0x240bf2d5502f9db4ull },
+    { "schip/ipf25", conform_rom_schip, sizeof(conform_rom_schip), 0, 25, NULL, 0, 0, 0x5e0c7a1edac27957ull }
+};
+
+/* --- Local Function Declarations --- */
+
+static void print_usage(
+    const char* p_name);
+
+static double now_seconds(
+    void);
+
+static uint16_t conform_keys(
+    const struct conform_case* p_case,
+    uint32_t                   frame);
+
+static void conform_set_keys(
+    struct c8_cpu* p_cpu,
+    uint16_t       keys);
+
+static void conform_load(
+    const struct conform_case* p_case,
+    struct c8_cpu*             p_cpu);
+
+static uint64_t conform_fold(
+    const uint64_t* p_hashes);
+
+static void conform_step(
+    const struct conform_case* p_cases,
+    uint32_t                   count,
+    uint64_t*                  p_hashes);
+
+static void conform_run_plain(
+    const struct conform_case* p_cases,
+    uint32_t                   count,
+    uint64_t*                  p_hashes);
+
+static void conform_run_idle(
+    const struct conform_case* p_cases,
+    uint32_t                   count,
+    uint64_t*                  p_hashes);
+
+static void conform_run(
+    const struct conform_case* p_cases,
+    uint32_t                   count,
+    uint64_t*                  p_hashes,
+    uint32_t                   flags);
+
+static void conform_jit(
+    const struct conform_case* p_cases,
+    uint32_t                   count,
+    uint64_t*                  p_hashes);
+
+static void conform_batch(
+    const struct conform_case* p_cases,
+    uint32_t                   count,
+    uint64_t*                  p_hashes);
+
+static void conform_batch_scalar(
+    const struct conform_case* p_cases,
+    uint32_t                   count,
+    uint64_t*                  p_hashes);
+
+static void conform_batch_run(
+    const struct conform_case* p_cases,
+    uint32_t                   count,
+    uint64_t*                  p_hashes,
+    uint32_t                   flags);
+
+static uint32_t conform_group(
+    uint32_t first,
+    uint32_t end);
+
+/* --- Engines --- */
+
+/* The first engine is the reference the others are compared against
+ * frame by frame, all of them are compared against the golden hashes.
+ */
+static const struct conform_engine conform_engines[] = {
+    { "step",   conform_step },
+    { "run",    conform_run_plain },
+    { "idle",   conform_run_idle },
+    { "jit",    conform_jit },
+    { "batch",  conform_batch },
+    { "scalar", conform_batch_scalar }
+};
+
+/* Shared by conform_jit calls, NULL if the host has no JIT */
+static struct c8_jit* conform_p_jit;
+
+/* --- Main Function --- */
+
+int main(
+    int argc,
+    const char* argv[])
+{
+    static uint64_t hashes[C8_ARRAY_SIZE(conform_engines)][C8_ARRAY_SIZE(conform_cases) * CONFORM_FRAMES];
+    const struct conform_case* p_case;
+    const char* p_filter = NULL;
+    const char* p_engine = NULL;
+    uint64_t* p_reference;
+    uint64_t* p_hashes;
+    uint64_t checkpoints = 0;
+    uint64_t hash;
+    uint32_t enabled[C8_ARRAY_SIZE(conform_engines)];
+    uint32_t failures = 0;
+    uint32_t e;
+    uint32_t i;
+    uint32_t end;
+    uint32_t frame;
+    int print_golden = C8_FALSE;
+    int arg;
+    double start;
+
+    for (arg = 1; arg < argc; arg++)
+    {
+        if (0 == strcmp(argv[arg], "-h") ||
+            0 == strcmp(argv[arg], "--help"))
+        {
+            print_usage(argv[0]);
+            return 0;
+        }
+        else if (0 == strcmp(argv[arg], "--filter") && arg + 1 < argc)
+        {
+            p_filter = argv[++arg];
+        }
+        else if (0 == strcmp(argv[arg], "--engine") && arg + 1 < argc)
+        {
+            p_engine = argv[++arg];
+        }
+        else if (0 == strcmp(argv[arg], "--golden"))
+        {
+            print_golden = C8_TRUE;
+        }
+        else
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    conform_p_jit = c8_jit_create();
+
+    for (e = 0; e < C8_ARRAY_SIZE(conform_engines); e++)
+    {
+        /* The reference always runs, the others only when selected */
+        enabled[e] = (0 == e || NULL == p_engine || 0 == strcmp(p_engine, conform_engines[e].p_name)) &&
+                     (NULL != conform_p_jit || conform_jit != conform_engines[e].run);
+    }
+
+    start = now_seconds();
+
+    for (e = 0; e < C8_ARRAY_SIZE(conform_engines); e++)
+    {
+        for (i = 0; i < C8_ARRAY_SIZE(conform_cases) && C8_TRUE == enabled[e]; i = end)
+        {
+            end = conform_group(i, C8_ARRAY_SIZE(conform_cases));
+            conform_engines[e].run(&conform_cases[i], end - i, hashes[e] + (size_t)i * CONFORM_FRAMES);
+        }
+    }
+
+    if (C8_TRUE == print_golden)
+    {
+        /* Golden values for the case table, from the reference engine */
+        for (i = 0; i < C8_ARRAY_SIZE(conform_cases); i++)
+        {
+            printf("%-14s 0x%016"PRIx64"ull\n", conform_cases[i].p_name,
+                   conform_fold(hashes[0] + (size_t)i * CONFORM_FRAMES));
+        }
+
+        c8_jit_destroy(conform_p_jit);
+        return 0;
+    }
+
+    printf("chip8-conform: %s dispatch, %d frames per case, every frame a checkpoint\n",
+           C8_DISPATCH_THREADED ? "threaded" : "switch", CONFORM_FRAMES);
+    printf("%-14s", "case");
+
+    for (e = 0; e < C8_ARRAY_SIZE(conform_engines); e++)
+    {
+        printf(" %-8s", conform_engines[e].p_name);
+    }
+
+    printf("\n");
+
+    for (i = 0; i < C8_ARRAY_SIZE(conform_cases); i++)
+    {
+        p_case = &conform_cases[i];
+        p_reference = hashes[0] + (size_t)i * CONFORM_FRAMES;
+
+        if (NULL != p_filter && NULL == strstr(p_case->p_name, p_filter))
+        {
+            continue;
+        }
+
+        printf("%-14s", p_case->p_name);
+
+        for (e = 0; e < C8_ARRAY_SIZE(conform_engines); e++)
+        {
+            p_hashes = hashes[e] + (size_t)i * CONFORM_FRAMES;
+
+            if (C8_FALSE == enabled[e])
+            {
+                printf(" %-8s", "-");
+                continue;
+            }
+
+            checkpoints += CONFORM_FRAMES;
+            hash = conform_fold(p_hashes);
+
+            /* First frame where the engine left the reference */
+            for (frame = 0; frame < CONFORM_FRAMES && p_hashes[frame] == p_reference[frame]; frame++)
+            {
+            }
+
+            if (frame < CONFORM_FRAMES)
+            {
+                printf(" @%-7"PRIu32, frame);
+                failures++;
+            }
+            else if (hash != p_case->golden)
+            {
+                printf(" %-8s", "GOLDEN");
+                failures++;
+            }
+            else
+            {
+                printf(" %-8s", "ok");
+            }
+        }
+
+        printf("\n");
+    }
+
+    printf("%"PRIu64" checkpoints in %.2f s, %"PRIu32" failures\n",
+           checkpoints, now_seconds() - start, failures);
+
+    if (0 != failures)
+    {
+        printf("@N: differs from %s from frame N on, GOLDEN: all frames agree with %s but\n"
+               "not with the golden hash. Compare traces of both with chip8-tracedump.\n",
+               conform_engines[0].p_name, conform_engines[0].p_name);
+    }
+
+    c8_jit_destroy(conform_p_jit);
+
+    return (0 == failures) ? 0 : 1;
+}
+
+/* --- Local Function Definitions --- */
+
+static void print_usage(
+    const char* p_name)
+{
+    printf("usage: %s [--filter TEXT] [--engine NAME] [--golden]\n"
+           "Runs the built-in test ROMs with scripted input on every engine and\n"
+           "compares the state hash after each frame against the reference engine\n"
+           "and the golden hashes. Exit status 1 on any difference.\n"
+           "      --filter TEXT  only report cases whose name contains TEXT\n"
+           "      --engine NAME  only run NAME (and the reference): step, run,\n"
+           "                     idle, jit, batch or scalar\n"
+           "      --golden       print the reference hashes for the case table\n",
+           p_name);
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static uint16_t conform_keys(
+    const struct conform_case* p_case,
+    uint32_t                   frame)
+{
+    uint64_t z;
+    uint16_t keys = 0;
+    uint32_t i;
+
+    if (0 != p_case->mash)
+    {
+        /* splitmix64 of the period, at most a few keys at a time */
+        z = (frame / p_case->mash) * 0x9e3779b97f4a7c15ull;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        z ^= z >> 31;
+
+        return (uint16_t)(z & (z >> 16) & (z >> 32));
+    }
+
+    for (i = 0; i < p_case->input_count && p_case->p_inputs[i].frame <= frame; i++)
+    {
+        keys = p_case->p_inputs[i].keys;
+    }
+
+    return keys;
+}
+
+static void conform_set_keys(
+    struct c8_cpu* p_cpu,
+    uint16_t       keys)
+{
+    int i;
+
+    for (i = 0; i < 16; i++)
+    {
+        p_cpu->keyboard[i] = (keys >> i) & 1;
+    }
+}
+
+static void conform_load(
+    const struct conform_case* p_case,
+    struct c8_cpu*             p_cpu)
+{
+    c8_init(p_cpu);
+    c8_load_font(p_cpu);
+    c8_seed(p_cpu, p_case->seed);
+    c8_load_rom(p_case->rom_size, p_case->p_rom, p_cpu);
+}
+
+static uint64_t conform_fold(
+    const uint64_t* p_hashes)
+{
+    uint64_t hash = C8_FNV_OFFSET;
+    uint32_t i;
+
+    for (i = 0; i < CONFORM_FRAMES; i++)
+    {
+        hash = (hash ^ p_hashes[i]) * C8_FNV_PRIME;
+    }
+
+    return hash;
+}
+
+static void conform_step(
+    const struct conform_case* p_cases,
+    uint32_t                   count,
+    uint64_t*                  p_hashes)
+{
+    static struct c8_cpu cpu;
+    uint32_t frame;
+    uint32_t c;
+    uint32_t i;
+
+    for (c = 0; c < count; c++)
+    {
+        conform_load(&p_cases[c], &cpu);
+
+        for (frame = 0; frame < CONFORM_FRAMES; frame++)
+        {
+            conform_set_keys(&cpu, conform_keys(&p_cases[c], frame));
+
+            for (i = 0; i < p_cases[c].ipf; i++)
+            {
+                c8_step(&cpu);
+            }
+
+            c8_decrement_timers(&cpu);
+            p_hashes[c * CONFORM_FRAMES + frame] = c8_movie_hash_state(&cpu);
+        }
+    }
+}
+
+static void conform_run_plain(
+    const struct conform_case* p_cases,
+    uint32_t                   count,
+    uint64_t*                  p_hashes)
+{
+    conform_run(p_cases, count, p_hashes, 0);
+}
+
+static void conform_run_idle(
+    const struct conform_case* p_cases,
+    uint32_t                   count,
+    uint64_t*                  p_hashes)
+{
+    /* Same flags as the frontends */
+    conform_run(p_cases, count, p_hashes, C8_RUN_STOP_ON_DRAW | C8_RUN_SKIP_IDLE);
+}
+
+static void conform_run(
+    const struct conform_case* p_cases,
+    uint32_t                   count,
+    uint64_t*                  p_hashes,
+    uint32_t                   flags)
+{
+    static struct c8_cpu cpu;
+    uint32_t budget;
+    uint32_t done;
+    uint32_t frame;
+    uint32_t c;
+
+    for (c = 0; c < count; c++)
+    {
+        conform_load(&p_cases[c], &cpu);
+
+        for (frame = 0; frame < CONFORM_FRAMES; frame++)
+        {
+            conform_set_keys(&cpu, conform_keys(&p_cases[c], frame));
+
+            /* Draws and FX0A return early, the rest of the budget goes
+             * into the next call like c8_step would spend it */
+            for (budget = p_cases[c].ipf; budget > 0; budget -= done)
+            {
+                if (C8_RUN_ERROR == c8_run(&cpu, budget, flags, &done))
+                {
+                    break;
+                }
+            }
+
+            c8_decrement_timers(&cpu);
+            p_hashes[c * CONFORM_FRAMES + frame] = c8_movie_hash_state(&cpu);
+        }
+    }
+}
+
+static void conform_jit(
+    const struct conform_case* p_cases,
+    uint32_t                   count,
+    uint64_t*                  p_hashes)
+{
+    static struct c8_cpu cpu;
+    uint32_t frame;
+    uint32_t c;
+
+    for (c = 0; c < count; c++)
+    {
+        conform_load(&p_cases[c], &cpu);
+        c8_jit_flush(conform_p_jit);
+
+        for (frame = 0; frame < CONFORM_FRAMES; frame++)
+        {
+            conform_set_keys(&cpu, conform_keys(&p_cases[c], frame));
+            c8_jit_run(conform_p_jit, &cpu, p_cases[c].ipf);
+            c8_decrement_timers(&cpu);
+            p_hashes[c * CONFORM_FRAMES + frame] = c8_movie_hash_state(&cpu);
+        }
+    }
+}
+
+static void conform_batch(
+    const struct conform_case* p_cases,
+    uint32_t                   count,
+    uint64_t*                  p_hashes)
+{
+    conform_batch_run(p_cases, count, p_hashes, 0);
+}
+
+static void conform_batch_scalar(
+    const struct conform_case* p_cases,
+    uint32_t                   count,
+    uint64_t*                  p_hashes)
+{
+    conform_batch_run(p_cases, count, p_hashes, C8_BATCH_SCALAR);
+}
+
+static void conform_batch_run(
+    const struct conform_case* p_cases,
+    uint32_t                   count,
+    uint64_t*                  p_hashes,
+    uint32_t                   flags)
+{
+    static struct c8_cpu cpu;
+    struct c8_batch* p_batch;
+    uint32_t frame;
+    uint32_t lane;
+
+    /* One lane per case, lanes with different input diverge */
+    conform_load(&p_cases[0], &cpu);
+    p_batch = c8_batch_create(&cpu, count, flags);
+
+    if (NULL == p_batch)
+    {
+        memset(p_hashes, 0x00, sizeof(*p_hashes) * count * CONFORM_FRAMES);
+        return;
+    }
+
+    for (frame = 0; frame < CONFORM_FRAMES; frame++)
+    {
+        for (lane = 0; lane < count; lane++)
+        {
+            conform_set_keys(c8_batch_cpu(p_batch, lane), conform_keys(&p_cases[lane], frame));
+        }
+
+        c8_batch_run(p_batch, p_cases[0].ipf);
+        c8_batch_decrement_timers(p_batch);
+
+        for (lane = 0; lane < count; lane++)
+        {
+            p_hashes[lane * CONFORM_FRAMES + frame] = c8_movie_hash_state(c8_batch_cpu(p_batch, lane));
+        }
+    }
+
+    c8_batch_destroy(p_batch);
+}
+
+/**
+ * End of the run of cases from first on that can share a batch.
+ */
+static uint32_t conform_group(
+    uint32_t first,
+    uint32_t end)
+{
+    const struct conform_case* p_first = &conform_cases[first];
+    uint32_t i;
+
+    for (i = first + 1; i < end; i++)
+    {
+        if (conform_cases[i].p_rom != p_first->p_rom ||
+            conform_cases[i].seed != p_first->seed ||
+            conform_cases[i].ipf != p_first->ipf)
+        {
+            break;
+        }
+    }
+
+    return i;
+}
@@ -0,0 +1,630 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "c8_cpu.h"
+#include "c8_rgba.h"
+#include "c8_term.h"
+
+/* Instructions per c8_run call of the opcode kernels */
+#define MB_BLOCK            (256)
+/* Subroutine of the call kernel and data of the draw and memory kernels,
+ * both past the block */
+#define MB_SUBROUTINE_ADDR  (0xE00)
+#define MB_DATA_ADDR        (0xE80)
+/* Sprite bytes at MB_DATA_ADDR, enough for a 16x16 DXY0 sprite */
+#define MB_DATA_SIZE        (32)
+/* Kernel argument flag, run in SUPER-CHIP hi-res */
+#define MB_HIRES            (0x10000)
+
+#define MB_DEFAULT_REPS      (25)
+#define MB_DEFAULT_WARMUP    (3)
+#define MB_DEFAULT_MIN_NS    (1000000.0)
+#define MB_DEFAULT_THRESHOLD (10.0)
+#define MB_MAX_REPS          (1000)
+#define MB_MAX_NAME          (64)
+
+struct mb_state;
+
+typedef void (*mb_fn)(
+    struct mb_state* p_state,
+    uint32_t         arg,
+    uint32_t         iterations);
+
+/**
+ * One benchmarked kernel. An iteration performs ops operations, results
+ * are reported per operation.
+ */
+struct mb_kernel {
+    const char* p_name;
+    mb_fn       fn;
+    uint32_t    arg;
+    uint32_t    ops;
+};
+
+struct mb_state {
+    struct c8_cpu   cpu;
+    /* Two screens the renderers alternate between, so every frame has
+     * changed cells */
+    uint64_t        screens[2][C8_SCREEN_HIRES_H][C8_SCREEN_WORDS];
+    struct c8_term* p_terms[3];
+    uint32_t        pixels[C8_SCREEN_HIRES_H * C8_SCREEN_HIRES_W];
+};
+
+struct mb_result {
+    double median_ns;
+    double p99_ns;
+    double min_ns;
+    uint32_t iterations;
+};
+
+struct mb_options {
+    uint32_t    reps;
+    uint32_t    warmup;
+    double      min_ns;
+    double      threshold;
+    const char* p_filter;
+    const char* p_json_path;
+    const char* p_baseline_path;
+};
+
+/* --- Local Function Declarations --- */
+
+static void print_usage(
+    const char* p_name);
+
+static double now_ns(
+    void);
+
+static void mb_setup(
+    struct mb_state* p_state,
+    uint16_t         op,
+    int              hires);
+
+static void mb_resolution(
+    struct c8_cpu* p_cpu,
+    int            hires);
+
+static void mb_op(
+    struct mb_state* p_state,
+    uint32_t         arg,
+    uint32_t         iterations);
+
+static void mb_timers(
+    struct mb_state* p_state,
+    uint32_t         arg,
+    uint32_t         iterations);
+
+static void mb_term(
+    struct mb_state* p_state,
+    uint32_t         arg,
+    uint32_t         iterations);
+
+static void mb_rgba(
+    struct mb_state* p_state,
+    uint32_t         arg,
+    uint32_t         iterations);
+
+static int mb_compare(
+    const void* p_a,
+    const void* p_b);
+
+static void mb_measure(
+    struct mb_state*         p_state,
+    const struct mb_kernel*  p_kernel,
+    const struct mb_options* p_options,
+    struct mb_result*        p_result);
+
+static int mb_baseline(
+    const char* p_path,
+    const char* p_name,
+    double*     p_median_ns);
+
+/* --- Kernels --- */
+
+/* Opcode kernels run MB_BLOCK copies of one instruction through c8_run.
+ * Registers are set up so that skips do not skip and memory writes land
+ * at MB_DATA_ADDR, see mb_setup. Draws take V0, V1 as position.
+ * MB_HIRES kernels run the same in the 128x64 SUPER-CHIP mode.
+ */
+static const struct mb_kernel mb_kernels[] = {
+    { "op/cls",           mb_op,     0x00E0, MB_BLOCK },
+    { "op/call_ret",      mb_op,     0x2000 | MB_SUBROUTINE_ADDR, MB_BLOCK * 2 },
+    { "op/se",            mb_op,     0x3A01, MB_BLOCK },
+    { "op/ld_vx_nn",      mb_op,     0x6A12, MB_BLOCK },
+    { "op/add_vx_nn",     mb_op,     0x7A01, MB_BLOCK },
+    { "op/add_vx_vy",     mb_op,     0x8AB4, MB_BLOCK },
+    { "op/shr",           mb_op,     0x8AB6, MB_BLOCK },
+    { "op/ld_i",          mb_op,     0xA000 | MB_DATA_ADDR, MB_BLOCK },
+    { "op/rnd",           mb_op,     0xCAFF, MB_BLOCK },
+    { "op/skp",           mb_op,     0xE09E, MB_BLOCK },
+    { "op/ld_vx_dt",      mb_op,     0xFA07, MB_BLOCK },
+    { "op/add_i",         mb_op,     0xFA1E, MB_BLOCK },
+    { "op/ld_f",          mb_op,     0xFA29, MB_BLOCK },
+    { "op/bcd",           mb_op,     0xFA33, MB_BLOCK },
+    { "draw/h1",          mb_op,     0xD011, MB_BLOCK },
+    { "draw/h5",          mb_op,     0xD015, MB_BLOCK },
+    { "draw/h15",         mb_op,     0xD01F, MB_BLOCK },
+    { "draw/h5_unaligned",mb_op,     0xD235, MB_BLOCK },
+    { "draw/h5_wrap_x",   mb_op,     0xD455, MB_BLOCK },
+    { "draw/h15_wrap_y",  mb_op,     0xD67F, MB_BLOCK },
+    { "draw/16x16",       mb_op,     0xD010, MB_BLOCK },
+    { "hires/draw_h5",    mb_op,     MB_HIRES | 0xD015, MB_BLOCK },
+    { "hires/draw_h5_odd",mb_op,     MB_HIRES | 0xD235, MB_BLOCK },
+    { "hires/draw_h5_wrap",mb_op,    MB_HIRES | 0xD895, MB_BLOCK },
+    { "hires/draw_16x16", mb_op,     MB_HIRES | 0xD230, MB_BLOCK },
+    { "hires/scd",        mb_op,     MB_HIRES | 0x00C4, MB_BLOCK },
+    { "hires/scr",        mb_op,     MB_HIRES | 0x00FB, MB_BLOCK },
+    { "hires/scl",        mb_op,     MB_HIRES | 0x00FC, MB_BLOCK },
+    { "reg/dump_v0",      mb_op,     0xF055, MB_BLOCK },
+    { "reg/dump_vf",      mb_op,     0xFF55, MB_BLOCK },
+    { "reg/load_v0",      mb_op,     0xF065, MB_BLOCK },
+    { "reg/load_vf",      mb_op,     0xFF65, MB_BLOCK },
+    { "timers/decrement", mb_timers, 0,      MB_BLOCK },
+    { "term/block",       mb_term,   0,      1 },
+    { "term/half",        mb_term,   1,      1 },
+    { "term/braille",     mb_term,   2,      1 },
+    { "term/half_hires",  mb_term,   MB_HIRES | 1, 1 },
+    { "rgba/expand",      mb_rgba,   0,      1 },
+    { "rgba/hires",       mb_rgba,   MB_HIRES, 1 }
+};
+
+/* --- Main Function --- */
+
+int main(
+    int argc,
+    const char* argv[])
+{
+    static struct mb_state state;
+    struct mb_options options;
+    struct mb_result result;
+    const struct mb_kernel* p_kernel;
+    FILE* p_json = NULL;
+    double baseline_ns;
+    double change;
+    uint32_t regressions = 0;
+    uint32_t written = 0;
+    uint32_t i;
+    int fd;
+    int arg;
+
+    options.reps = MB_DEFAULT_REPS;
+    options.warmup = MB_DEFAULT_WARMUP;
+    options.min_ns = MB_DEFAULT_MIN_NS;
+    options.threshold = MB_DEFAULT_THRESHOLD;
+    options.p_filter = NULL;
+    options.p_json_path = NULL;
+    options.p_baseline_path = NULL;
+
+    for (arg = 1; arg < argc; arg++)
+    {
+        if (0 == strcmp(argv[arg], "-h") ||
+            0 == strcmp(argv[arg], "--help"))
+        {
+            print_usage(argv[0]);
+            return 0;
+        }
+        else if (0 == strcmp(argv[arg], "--reps") && arg + 1 < argc)
+        {
+            options.reps = (uint32_t)strtoul(argv[++arg], NULL, 10);
+        }
+        else if (0 == strcmp(argv[arg], "--warmup") && arg + 1 < argc)
+        {
+            options.warmup = (uint32_t)strtoul(argv[++arg], NULL, 10);
+        }
+        else if (0 == strcmp(argv[arg], "--min-ms") && arg + 1 < argc)
+        {
+            options.min_ns = strtod(argv[++arg], NULL) * 1e6;
+        }
+        else if (0 == strcmp(argv[arg], "--filter") && arg + 1 < argc)
+        {
+            options.p_filter = argv[++arg];
+        }
+        else if (0 == strcmp(argv[arg], "--json") && arg + 1 < argc)
+        {
+            options.p_json_path = argv[++arg];
+        }
+        else if (0 == strcmp(argv[arg], "--baseline") && arg + 1 < argc)
+        {
+            options.p_baseline_path = argv[++arg];
+        }
+        else if (0 == strcmp(argv[arg], "--threshold") && arg + 1 < argc)
+        {
+            options.threshold = strtod(argv[++arg], NULL);
+        }
+        else
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (0 == options.reps || options.reps > MB_MAX_REPS)
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    /* Rendered frames are written to /dev/null, only building them counts */
+    fd = open("/dev/null", O_WRONLY);
+
+    for (i = 0; i < C8_ARRAY_SIZE(state.p_terms); i++)
+    {
+        state.p_terms[i] = c8_term_create(fd, (enum c8_term_mode)i);
+
+        if (NULL == state.p_terms[i])
+        {
+            return 1;
+        }
+    }
+
+    if (NULL != options.p_json_path)
+    {
+        p_json = fopen(options.p_json_path, "w");
+
+        if (NULL == p_json)
+        {
+            fprintf(stderr, "chip8-microbench: cannot write '%s'\n", options.p_json_path);
+            return 1;
+        }
+
+        fprintf(p_json, "{\n  \"dispatch\": \"%s\",\n  \"reps\": %"PRIu32",\n  \"kernels\": [",
+                C8_DISPATCH_THREADED ? "threaded" : "switch", options.reps);
+    }
+
+    printf("chip8-microbench: %s dispatch, %"PRIu32" reps after %"PRIu32" warmup, ns per operation\n",
+           C8_DISPATCH_THREADED ? "threaded" : "switch", options.reps, options.warmup);
+    printf("%-20s %8s %10s %10s %10s\n", "kernel", "ops/it", "median", "p99", "min");
+
+    for (i = 0; i < C8_ARRAY_SIZE(mb_kernels); i++)
+    {
+        p_kernel = &mb_kernels[i];
+
+        if (NULL != options.p_filter && NULL == strstr(p_kernel->p_name, options.p_filter))
+        {
+            continue;
+        }
+
+        mb_measure(&state, p_kernel, &options, &result);
+
+        printf("%-20s %8"PRIu32" %10.3f %10.3f %10.3f",
+               p_kernel->p_name, p_kernel->ops,
+               result.median_ns, result.p99_ns, result.min_ns);
+
+        if (NULL != options.p_baseline_path &&
+            C8_TRUE == mb_baseline(options.p_baseline_path, p_kernel->p_name, &baseline_ns))
+        {
+            change = 100.0 * (result.median_ns - baseline_ns) / baseline_ns;
+            printf("  %+7.1f%%", change);
+
+            if (change > options.threshold)
+            {
+                printf("  REGRESSION");
+                regressions++;
+            }
+        }
+
+        printf("\n");
+
+        if (NULL != p_json)
+        {
+            fprintf(p_json, "%s\n    {\"name\": \"%s\", \"median_ns\": %.4f, \"p99_ns\": %.4f, \"min_ns\": %.4f, \"ops\": %"PRIu32", \"iterations\": %"PRIu32"}",
+                    (0 == written) ? "" : ",",
+                    p_kernel->p_name, result.median_ns, result.p99_ns, result.min_ns,
+                    p_kernel->ops, result.iterations);
+        }
+
+        written++;
+    }
+
+    if (NULL != p_json)
+    {
+        fprintf(p_json, "\n  ]\n}\n");
+        fclose(p_json);
+    }
+
+    if (NULL != options.p_baseline_path)
+    {
+        printf("%"PRIu32" regressions above %.1f%% against '%s'\n",
+               regressions, options.threshold, options.p_baseline_path);
+    }
+
+    for (i = 0; i < C8_ARRAY_SIZE(state.p_terms); i++)
+    {
+        c8_term_destroy(state.p_terms[i]);
+    }
+
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+
+    return (0 == regressions) ? 0 : 1;
+}
+
+/* --- Local Function Definitions --- */
+
+static void print_usage(
+    const char* p_name)
+{
+    printf("usage: %s [options]\n"
+           "Times the core kernels one at a time: single opcodes through c8_run,\n"
+           "DXYN by height and wrap, FX55/FX65, timers and the frontend renderers.\n"
+           "      --reps N         timed repetitions per kernel (default %d)\n"
+           "      --warmup N       untimed repetitions first (default %d)\n"
+           "      --min-ms N       grow the iterations until one repetition takes\n"
+           "                       at least N ms (default %.0f)\n"
+           "      --filter TEXT    only kernels whose name contains TEXT\n"
+           "      --json FILE      also write the results as JSON\n"
+           "      --baseline FILE  compare medians against an earlier --json file,\n"
+           "                       exit with 1 if one got slower than the threshold\n"
+           "      --threshold PCT  allowed slowdown in percent (default %.0f)\n",
+           p_name,
+           MB_DEFAULT_REPS,
+           MB_DEFAULT_WARMUP,
+           MB_DEFAULT_MIN_NS / 1e6,
+           MB_DEFAULT_THRESHOLD);
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/**
+ * Load a program of MB_BLOCK copies of op, a 00EE at MB_SUBROUTINE_ADDR
+ * and sprite data at MB_DATA_ADDR.
+ */
+static void mb_setup(
+    struct mb_state* p_state,
+    uint16_t         op,
+    int              hires)
+{
+    static uint8_t program[MB_DATA_ADDR + MB_DATA_SIZE - C8_PROGRAM_START_ADDR];
+    struct c8_cpu* p_cpu = &p_state->cpu;
+    uint32_t i;
+
+    memset(program, 0x00, sizeof(program));
+
+    for (i = 0; i < MB_BLOCK; i++)
+    {
+        program[i * 2] = (uint8_t)(op >> 8);
+        program[i * 2 + 1] = (uint8_t)op;
+    }
+
+    program[MB_SUBROUTINE_ADDR - C8_PROGRAM_START_ADDR] = 0x00;
+    program[MB_SUBROUTINE_ADDR - C8_PROGRAM_START_ADDR + 1] = 0xEE;
+
+    for (i = 0; i < MB_DATA_SIZE; i++)
+    {
+        program[MB_DATA_ADDR - C8_PROGRAM_START_ADDR + i] = (uint8_t)(0xA5 ^ (i * 0x3B));
+    }
+
+    c8_init(p_cpu);
+    c8_load_font(p_cpu);
+    c8_load_rom(sizeof(program), program, p_cpu);
+    mb_resolution(p_cpu, hires);
+
+    /* Draw positions: aligned, unaligned, wrapping in x and in y */
+    p_cpu->V[0x0] = 0;
+    p_cpu->V[0x1] = 0;
+    p_cpu->V[0x2] = 3;
+    p_cpu->V[0x3] = 7;
+    p_cpu->V[0x4] = 60;
+    p_cpu->V[0x5] = 10;
+    p_cpu->V[0x6] = 20;
+    p_cpu->V[0x7] = 25;
+    p_cpu->V[0x8] = 125;
+    p_cpu->V[0x9] = 40;
+    /* Operands, VA never equals 1 before the compare */
+    p_cpu->V[0xA] = 0x42;
+    p_cpu->V[0xB] = 0x17;
+}
+
+static void mb_op(
+    struct mb_state* p_state,
+    uint32_t         arg,
+    uint32_t         iterations)
+{
+    struct c8_cpu* p_cpu = &p_state->cpu;
+    uint32_t executed;
+    uint32_t i;
+
+    const int hires = (0 != (arg & MB_HIRES));
+
+    if (p_cpu->ram[C8_PROGRAM_START_ADDR] != (uint8_t)(arg >> 8) ||
+        p_cpu->ram[C8_PROGRAM_START_ADDR + 1] != (uint8_t)arg ||
+        hires != (C8_SCREEN_HIRES_W == p_cpu->screen_w))
+    {
+        mb_setup(p_state, (uint16_t)arg, hires);
+    }
+
+    for (i = 0; i < iterations; i++)
+    {
+        p_cpu->pc = C8_PROGRAM_START_ADDR;
+        p_cpu->I = MB_DATA_ADDR;
+        p_cpu->V[0xA] = 0x42;
+
+        c8_run(p_cpu, (0xF000 & arg) == 0x2000 ? MB_BLOCK * 2 : MB_BLOCK, 0, &executed);
+    }
+}
+
+static void mb_timers(
+    struct mb_state* p_state,
+    uint32_t         arg,
+    uint32_t         iterations)
+{
+    struct c8_cpu* p_cpu = &p_state->cpu;
+    uint32_t i;
+    uint32_t j;
+
+    (void)arg;
+
+    for (i = 0; i < iterations; i++)
+    {
+        p_cpu->delay_timer = MB_BLOCK / 2;
+        p_cpu->sound_timer = MB_BLOCK;
+
+        for (j = 0; j < MB_BLOCK; j++)
+        {
+            c8_decrement_timers(p_cpu);
+        }
+    }
+}
+
+static void mb_term(
+    struct mb_state* p_state,
+    uint32_t         arg,
+    uint32_t         iterations)
+{
+    struct c8_cpu* p_cpu = &p_state->cpu;
+    uint32_t i;
+
+    mb_resolution(p_cpu, 0 != (arg & MB_HIRES));
+
+    for (i = 0; i < iterations; i++)
+    {
+        memcpy(p_cpu->screen, p_state->screens[i & 1], sizeof(p_cpu->screen));
+        c8_term_draw(p_state->p_terms[arg & ~MB_HIRES], p_cpu, NULL);
+    }
+}
+
+static void mb_rgba(
+    struct mb_state* p_state,
+    uint32_t         arg,
+    uint32_t         iterations)
+{
+    const struct c8_palette* p_palette = c8_palette_find("green");
+    uint32_t i;
+
+    mb_resolution(&p_state->cpu, 0 != (arg & MB_HIRES));
+
+    for (i = 0; i < iterations; i++)
+    {
+        /* Only the first byte of the buffer changes between calls */
+        p_state->cpu.screen[0][0] ^= 1;
+        c8_rgba_expand(&p_state->cpu, p_palette, p_state->pixels, p_state->cpu.screen_w * 4);
+    }
+}
+
+/**
+ * Switch the resolution without running 00FE / 00FF, the screen is kept.
+ */
+static void mb_resolution(
+    struct c8_cpu* p_cpu,
+    int            hires)
+{
+    p_cpu->screen_w = hires ? C8_SCREEN_HIRES_W : C8_SCREEN_LORES_W;
+    p_cpu->screen_h = hires ? C8_SCREEN_HIRES_H : C8_SCREEN_LORES_H;
+}
+
+static int mb_compare(
+    const void* p_a,
+    const void* p_b)
+{
+    const double a = *(const double*)p_a;
+    const double b = *(const double*)p_b;
+
+    return (a > b) - (a < b);
+}
+
+static void mb_measure(
+    struct mb_state*         p_state,
+    const struct mb_kernel*  p_kernel,
+    const struct mb_options* p_options,
+    struct mb_result*        p_result)
+{
+    static double samples[MB_MAX_REPS];
+    uint32_t iterations = 1;
+    uint32_t i;
+    double start;
+    double elapsed;
+    uint64_t seed = 0x9e3779b97f4a7c15ull;
+
+    /* Two random screens for the renderers, fixed so runs compare */
+    for (i = 0; i < C8_SCREEN_HIRES_H * C8_SCREEN_WORDS * 2; i++)
+    {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        p_state->screens[i / (C8_SCREEN_HIRES_H * C8_SCREEN_WORDS)]
+                        [(i / C8_SCREEN_WORDS) % C8_SCREEN_HIRES_H]
+                        [i % C8_SCREEN_WORDS] = seed;
+    }
+
+    /* Grow the iterations until a repetition is long enough to time */
+    for (;;)
+    {
+        start = now_ns();
+        p_kernel->fn(p_state, p_kernel->arg, iterations);
+        elapsed = now_ns() - start;
+
+        if (elapsed >= p_options->min_ns || iterations >= (1u << 30))
+        {
+            break;
+        }
+
+        iterations *= 2;
+    }
+
+    for (i = 0; i < p_options->warmup; i++)
+    {
+        p_kernel->fn(p_state, p_kernel->arg, iterations);
+    }
+
+    for (i = 0; i < p_options->reps; i++)
+    {
+        start = now_ns();
+        p_kernel->fn(p_state, p_kernel->arg, iterations);
+        samples[i] = (now_ns() - start) / ((double)iterations * p_kernel->ops);
+    }
+
+    qsort(samples, p_options->reps, sizeof(*samples), mb_compare);
+
+    p_result->iterations = iterations;
+    p_result->min_ns = samples[0];
+    p_result->median_ns = samples[p_options->reps / 2];
+    /* Nearest rank, the largest sample with fewer than 100 */
+    p_result->p99_ns = samples[(p_options->reps * 99 + 99) / 100 - 1];
+}
+
+/**
+ * Median of a kernel in a file written with --json, one kernel per line.
+ */
+static int mb_baseline(
+    const char* p_path,
+    const char* p_name,
+    double*     p_median_ns)
+{
+    char line[256];
+    char name[MB_MAX_NAME];
+    double median;
+    int found = C8_FALSE;
+    FILE* f = fopen(p_path, "r");
+
+    if (NULL == f)
+    {
+        return C8_FALSE;
+    }
+
+    while (C8_FALSE == found && NULL != fgets(line, sizeof(line), f))
+    {
+        if (2 == sscanf(line, " {\"name\": \"%63[^\"]\", \"median_ns\": %lf", name, &median) &&
+            0 == strcmp(name, p_name) && median > 0.0)
+        {
+            *p_median_ns = median;
+            found = C8_TRUE;
+        }
+    }
+
+    fclose(f);
+
+    return found;
+}
@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c8_cpu.h"
+#include "c8_rompack.h"
+
+/* --- Local Function Declarations --- */
+
+static void print_usage(
+    const char* p_name);
+
+static const char* base_name(
+    const char* p_path);
+
+static uint8_t* read_file(
+    const char* p_path,
+    uint32_t*   p_size);
+
+static int list_pack(
+    const char* p_path);
+
+/* --- Main Function --- */
+
+int main(
+    int argc,
+    const char* argv[])
+{
+    struct c8_rompack_source* p_sources;
+    const char* p_out_path = NULL;
+    uint32_t count = 0;
+    uint32_t ipf = 0;
+    uint32_t i;
+    int result = C8_TRUE;
+    int arg;
+
+    if (3 == argc && 0 == strcmp(argv[1], "--list"))
+    {
+        return (C8_TRUE == list_pack(argv[2])) ? 0 : 1;
+    }
+
+    p_sources = calloc((size_t)argc, sizeof(*p_sources));
+
+    if (NULL == p_sources)
+    {
+        return 1;
+    }
+
+    for (arg = 1; arg < argc && C8_TRUE == result; arg++)
+    {
+        if (0 == strcmp(argv[arg], "-h") ||
+            0 == strcmp(argv[arg], "--help"))
+        {
+            print_usage(argv[0]);
+            free(p_sources);
+            return 0;
+        }
+        else if (0 == strcmp(argv[arg], "--ipf") && arg + 1 < argc)
+        {
+            /* Applies to the ROMs that follow */
+            ipf = (uint32_t)strtoul(argv[++arg], NULL, 10);
+        }
+        else if ('-' == argv[arg][0])
+        {
+            result = C8_FALSE;
+        }
+        else if (NULL == p_out_path)
+        {
+            p_out_path = argv[arg];
+        }
+        else
+        {
+            p_sources[count].p_name = base_name(argv[arg]);
+            p_sources[count].p_data = read_file(argv[arg], &p_sources[count].size);
+            p_sources[count].ipf = ipf;
+
+            if (NULL == p_sources[count].p_data)
+            {
+                fprintf(stderr, "chip8-pack: cannot read '%s'\n", argv[arg]);
+                result = C8_FALSE;
+            }
+
+            count++;
+        }
+    }
+
+    if (C8_FALSE == result || NULL == p_out_path)
+    {
+        print_usage(argv[0]);
+        result = C8_FALSE;
+    }
+    else if (C8_FALSE == c8_rompack_write(p_out_path, p_sources, count))
+    {
+        fprintf(stderr, "chip8-pack: failed to write '%s', names must be unique and at most %d characters\n",
+                p_out_path, C8_ROMPACK_NAME_SIZE - 1);
+        result = C8_FALSE;
+    }
+    else
+    {
+        printf("%s: %"PRIu32" ROMs\n", p_out_path, count);
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        free((uint8_t*)p_sources[i].p_data);
+    }
+
+    free(p_sources);
+
+    return (C8_TRUE == result) ? 0 : 1;
+}
+
+/* --- Local Function Definitions --- */
+
+static void print_usage(
+    const char* p_name)
+{
+    printf("usage: %s pack.c8p [--ipf N] path/to/rom ...\n"
+           "       %s --list pack.c8p\n"
+           "Writes the ROMs into one pack for chip8-runner --pack, each under\n"
+           "its file name, or lists and verifies the ROMs in a pack.\n"
+           "      --ipf N      instructions per frame of the ROMs that follow,\n"
+           "                   0 for the runner's --ipf (default)\n",
+           p_name, p_name);
+}
+
+static const char* base_name(
+    const char* p_path)
+{
+    const char* p_slash = strrchr(p_path, '/');
+
+    return (NULL != p_slash) ? p_slash + 1 : p_path;
+}
+
+static uint8_t* read_file(
+    const char* p_path,
+    uint32_t*   p_size)
+{
+    uint8_t* p_data;
+    long size;
+    FILE* f = fopen(p_path, "rb");
+
+    if (NULL == f)
+    {
+        return NULL;
+    }
+
+    /* Larger files could never be loaded, see c8_load_rom */
+    if (0 != fseek(f, 0, SEEK_END) ||
+        (size = ftell(f)) < 0 ||
+        size > 4096 - C8_PROGRAM_START_ADDR ||
+        0 != fseek(f, 0, SEEK_SET))
+    {
+        fclose(f);
+        return NULL;
+    }
+
+    p_data = malloc((size_t)size + 1);
+
+    if (NULL != p_data && (size_t)size != fread(p_data, 1, (size_t)size, f))
+    {
+        free(p_data);
+        p_data = NULL;
+    }
+
+    fclose(f);
+    *p_size = (uint32_t)size;
+
+    return p_data;
+}
+
+static int list_pack(
+    const char* p_path)
+{
+    const struct c8_rompack_entry* p_entry;
+    struct c8_rompack* p_pack = c8_rompack_open(p_path);
+    uint32_t failed = 0;
+    uint32_t i;
+    int ok;
+
+    if (NULL == p_pack)
+    {
+        fprintf(stderr, "chip8-pack: '%s' is not a version %d ROM pack\n",
+                p_path, C8_ROMPACK_VERSION);
+        return C8_FALSE;
+    }
+
+    for (i = 0; i < c8_rompack_count(p_pack); i++)
+    {
+        p_entry = c8_rompack_get(p_pack, i);
+
+        ok = c8_rompack_verify(p_entry);
+        failed += (C8_FALSE == ok);
+
+        printf("%-31s %5"PRIu32" bytes  ipf %-6"PRIu32" %016"PRIx64"  %s\n",
+               p_entry->p_name, p_entry->size, p_entry->ipf, p_entry->hash,
+               ok ? "ok" : "CORRUPT");
+    }
+
+    printf("%"PRIu32" ROMs, %"PRIu32" corrupt\n", c8_rompack_count(p_pack), failed);
+
+    c8_rompack_close(p_pack);
+
+    return (0 == failed) ? C8_TRUE : C8_FALSE;
+}
@@ -0,0 +1,529 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "c8_cpu.h"
+#include "c8_rompack.h"
+#include "c8_runner.h"
+
+#define RUNNER_MAX_LINE (1024)
+
+struct runner_options {
+    uint32_t threads;
+    uint32_t ipf;
+    int      scaling;
+    int      quiet;
+    uint64_t seed;
+};
+
+/* Collected results of one pass over the job list */
+struct runner_pass {
+    const struct c8_job* p_jobs;
+    uint64_t*            p_hashes;
+    uint64_t             cycles;
+    uint32_t             failed;
+    int                  quiet;
+};
+
+/* --- Local Function Declarations --- */
+
+static void print_usage(
+    const char* p_name);
+
+static int parse_u32(
+    const char* p_str,
+    uint32_t*   p_out);
+
+static int parse_u64(
+    const char* p_str,
+    uint64_t*   p_out);
+
+static double now_seconds(
+    void);
+
+static char* copy_string(
+    const char* p_str);
+
+static int load_jobs(
+    const char*              p_path,
+    uint64_t                 seed,
+    const struct c8_rompack* p_pack,
+    struct c8_job**          pp_jobs,
+    uint32_t*                p_count);
+
+static void free_jobs(
+    struct c8_job* p_jobs,
+    uint32_t       count);
+
+static void on_result(
+    const struct c8_job_result* p_result,
+    void*                       p_user);
+
+static int run_pass(
+    const struct c8_job*         p_jobs,
+    uint32_t                     count,
+    uint32_t                     threads,
+    const struct runner_options* p_options,
+    int                          quiet,
+    uint64_t*                    p_hashes,
+    struct runner_pass*          p_pass,
+    double*                      p_seconds);
+
+static int run_scaling(
+    const struct c8_job*         p_jobs,
+    uint32_t                     count,
+    const struct runner_options* p_options);
+
+/* --- Main Function --- */
+
+int main(
+    int argc,
+    const char* argv[])
+{
+    struct runner_options options;
+    struct runner_pass pass;
+    struct c8_job* p_jobs = NULL;
+    const char* p_job_file = NULL;
+    const char* p_pack_path = NULL;
+    struct c8_rompack* p_pack = NULL;
+    uint64_t* p_hashes;
+    uint32_t count = 0;
+    double seconds;
+    long cpus;
+    int result;
+    int i;
+
+    cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    options.threads = (cpus > 0) ? (uint32_t)cpus : 1;
+    options.ipf = C8_RUNNER_DEFAULT_IPF;
+    options.scaling = C8_FALSE;
+    options.quiet = C8_FALSE;
+    options.seed = C8_DEFAULT_SEED;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "-h") ||
+            0 == strcmp(argv[i], "--help"))
+        {
+            print_usage(argv[0]);
+            return 0;
+        }
+        else if ((0 == strcmp(argv[i], "-j") ||
+                  0 == strcmp(argv[i], "--threads")) &&
+                 i + 1 < argc && parse_u32(argv[i + 1], &options.threads) &&
+                 options.threads > 0)
+        {
+            i++;
+        }
+        else if (0 == strcmp(argv[i], "--ipf") &&
+                 i + 1 < argc && parse_u32(argv[i + 1], &options.ipf) &&
+                 options.ipf > 0)
+        {
+            i++;
+        }
+        else if (0 == strcmp(argv[i], "--seed") &&
+                 i + 1 < argc && parse_u64(argv[i + 1], &options.seed))
+        {
+            i++;
+        }
+        else if (0 == strcmp(argv[i], "--pack") && i + 1 < argc)
+        {
+            p_pack_path = argv[++i];
+        }
+        else if (0 == strcmp(argv[i], "--scaling"))
+        {
+            options.scaling = C8_TRUE;
+        }
+        else if (0 == strcmp(argv[i], "-q") ||
+                 0 == strcmp(argv[i], "--quiet"))
+        {
+            options.quiet = C8_TRUE;
+        }
+        else if ('-' != argv[i][0] && NULL == p_job_file)
+        {
+            p_job_file = argv[i];
+        }
+        else
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (NULL == p_job_file)
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    /* Mapped for the whole run, jobs point into it */
+    if (NULL != p_pack_path)
+    {
+        p_pack = c8_rompack_open(p_pack_path);
+
+        if (NULL == p_pack)
+        {
+            fprintf(stderr, "chip8-runner: '%s' is not a ROM pack\n", p_pack_path);
+            return 1;
+        }
+    }
+
+    if (C8_FALSE == load_jobs(p_job_file, options.seed, p_pack, &p_jobs, &count))
+    {
+        c8_rompack_close(p_pack);
+        return 1;
+    }
+
+    if (C8_TRUE == options.scaling)
+    {
+        result = run_scaling(p_jobs, count, &options);
+        free_jobs(p_jobs, count);
+        c8_rompack_close(p_pack);
+        return (C8_TRUE == result) ? 0 : 1;
+    }
+
+    p_hashes = calloc(count + 1, sizeof(uint64_t));
+
+    if (NULL == p_hashes)
+    {
+        free_jobs(p_jobs, count);
+        c8_rompack_close(p_pack);
+        return 1;
+    }
+
+    result = run_pass(p_jobs, count, options.threads, &options,
+                      options.quiet, p_hashes, &pass, &seconds);
+
+    printf("%"PRIu32" jobs, %"PRIu32" threads, %.3f s, %.0f instructions/sec, %"PRIu32" failed\n",
+           count, options.threads, seconds,
+           (seconds > 0.0) ? (double)pass.cycles / seconds : 0.0,
+           pass.failed);
+
+    free(p_hashes);
+    free_jobs(p_jobs, count);
+    c8_rompack_close(p_pack);
+
+    return (C8_TRUE == result && 0 == pass.failed) ? 0 : 1;
+}
+
+/* --- Local Function Definitions --- */
+
+static void print_usage(
+    const char* p_name)
+{
+    printf("usage: %s [options] jobs.txt\n"
+           "Runs every job headless on a pool of worker threads and prints\n"
+           "the final screen hash of each job as it finishes.\n"
+           "Job file: one \"path/to/rom frames [path/to/script]\" per line.\n"
+           "With --pack the first field is the name of a ROM in the pack.\n"
+           "Script: one \"frame key 0|1\" key event per line, key in hex.\n"
+           "  -j, --threads N  worker threads (default: online CPUs)\n"
+           "      --ipf N      instructions per frame (default %d)\n"
+           "      --seed N     seed for CXNN, job i uses N + i (default %d)\n"
+           "      --pack FILE  load ROMs from a pack made with chip8-pack\n"
+           "      --scaling    run with 1, 2, 4 ... N threads and report efficiency\n"
+           "  -q, --quiet      only print the summary\n",
+           p_name,
+           C8_RUNNER_DEFAULT_IPF,
+           C8_DEFAULT_SEED);
+}
+
+static int parse_u32(
+    const char* p_str,
+    uint32_t*   p_out)
+{
+    char* p_end = NULL;
+    unsigned long value = strtoul(p_str, &p_end, 10);
+
+    if (p_end == p_str || '\0' != *p_end || value > UINT32_MAX)
+    {
+        return C8_FALSE;
+    }
+
+    *p_out = (uint32_t)value;
+    return C8_TRUE;
+}
+
+static int parse_u64(
+    const char* p_str,
+    uint64_t*   p_out)
+{
+    char* p_end = NULL;
+    unsigned long long value = strtoull(p_str, &p_end, 10);
+
+    if (p_end == p_str || '\0' != *p_end)
+    {
+        return C8_FALSE;
+    }
+
+    *p_out = (uint64_t)value;
+    return C8_TRUE;
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static char* copy_string(
+    const char* p_str)
+{
+    size_t length = strlen(p_str) + 1;
+    char* p_copy = malloc(length);
+
+    if (NULL != p_copy)
+    {
+        memcpy(p_copy, p_str, length);
+    }
+
+    return p_copy;
+}
+
+static int load_jobs(
+    const char*              p_path,
+    uint64_t                 seed,
+    const struct c8_rompack* p_pack,
+    struct c8_job**          pp_jobs,
+    uint32_t*                p_count)
+{
+    const struct c8_rompack_entry* p_entry = NULL;
+    struct c8_job* p_jobs = NULL;
+    struct c8_job* p_grown;
+    uint32_t capacity = 0;
+    uint32_t count = 0;
+    uint32_t line_number = 0;
+    char line[RUNNER_MAX_LINE];
+    char rom[RUNNER_MAX_LINE];
+    char script[RUNNER_MAX_LINE];
+    unsigned int frames;
+    int fields;
+    FILE* f = fopen(p_path, "r");
+
+    if (NULL == f)
+    {
+        fprintf(stderr, "chip8-runner: failed to open '%s'\n", p_path);
+        return C8_FALSE;
+    }
+
+    while (NULL != fgets(line, sizeof(line), f))
+    {
+        line_number++;
+
+        fields = sscanf(line, "%1023s %u %1023s", rom, &frames, script);
+
+        if (fields <= 0 || '#' == rom[0])
+        {
+            continue;
+        }
+
+        if (fields < 2)
+        {
+            fprintf(stderr, "chip8-runner: %s:%"PRIu32": expected 'rom frames [script]'\n",
+                    p_path, line_number);
+            fclose(f);
+            free_jobs(p_jobs, count);
+            return C8_FALSE;
+        }
+
+        if (NULL != p_pack)
+        {
+            p_entry = c8_rompack_find(p_pack, rom);
+
+            if (NULL == p_entry)
+            {
+                fprintf(stderr, "chip8-runner: %s:%"PRIu32": no ROM '%s' in the pack\n",
+                        p_path, line_number, rom);
+                fclose(f);
+                free_jobs(p_jobs, count);
+                return C8_FALSE;
+            }
+        }
+
+        if (count == capacity)
+        {
+            capacity = (0 == capacity) ? 64 : capacity * 2;
+            p_grown = realloc(p_jobs, capacity * sizeof(*p_jobs));
+
+            if (NULL == p_grown)
+            {
+                fclose(f);
+                free_jobs(p_jobs, count);
+                return C8_FALSE;
+            }
+
+            p_jobs = p_grown;
+        }
+
+        p_jobs[count].p_rom_path = copy_string(rom);
+        p_jobs[count].p_script_path = (3 == fields) ? copy_string(script) : NULL;
+        p_jobs[count].p_rom_data = (NULL != p_entry) ? p_entry->p_data : NULL;
+        p_jobs[count].rom_size = (NULL != p_entry) ? p_entry->size : 0;
+        p_jobs[count].ipf = (NULL != p_entry) ? p_entry->ipf : 0;
+        p_jobs[count].frames = frames;
+        p_jobs[count].seed = seed + count;
+        count++;
+    }
+
+    fclose(f);
+
+    *pp_jobs = p_jobs;
+    *p_count = count;
+
+    return C8_TRUE;
+}
+
+static void free_jobs(
+    struct c8_job* p_jobs,
+    uint32_t       count)
+{
+    uint32_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        free((char*)p_jobs[i].p_rom_path);
+        free((char*)p_jobs[i].p_script_path);
+    }
+
+    free(p_jobs);
+}
+
+static void on_result(
+    const struct c8_job_result* p_result,
+    void*                       p_user)
+{
+    struct runner_pass* p_pass = p_user;
+    const struct c8_job* p_job = &p_pass->p_jobs[p_result->job];
+
+    p_pass->p_hashes[p_result->job] = p_result->screen_hash;
+    p_pass->cycles += p_result->cycles;
+
+    if (C8_FALSE == p_result->loaded)
+    {
+        p_pass->failed++;
+    }
+
+    if (C8_TRUE == p_pass->quiet)
+    {
+        return;
+    }
+
+    if (C8_FALSE == p_result->loaded)
+    {
+        printf("%"PRIu32"\t%s\tfailed to load\n", p_result->job, p_job->p_rom_path);
+    }
+    else
+    {
+        printf("%"PRIu32"\t%s\thash=%016"PRIx64"\tframes=%"PRIu32"\tinstructions=%"PRIu64"\ttime=%.3f ms\tworker=%"PRIu32"%s\n",
+               p_result->job,
+               p_job->p_rom_path,
+               p_result->screen_hash,
+               p_result->frames,
+               p_result->cycles,
+               p_result->seconds * 1e3,
+               p_result->worker,
+               p_result->halted ? "\thalted" : "");
+    }
+
+    /* Results are streamed, do not hold them back in the buffer */
+    fflush(stdout);
+}
+
+static int run_pass(
+    const struct c8_job*         p_jobs,
+    uint32_t                     count,
+    uint32_t                     threads,
+    const struct runner_options* p_options,
+    int                          quiet,
+    uint64_t*                    p_hashes,
+    struct runner_pass*          p_pass,
+    double*                      p_seconds)
+{
+    double start;
+    int result;
+
+    p_pass->p_jobs = p_jobs;
+    p_pass->p_hashes = p_hashes;
+    p_pass->cycles = 0;
+    p_pass->failed = 0;
+    p_pass->quiet = quiet;
+
+    start = now_seconds();
+    result = c8_runner_run(p_jobs, count, threads, p_options->ipf, on_result, p_pass);
+    *p_seconds = now_seconds() - start;
+
+    return result;
+}
+
+static int run_scaling(
+    const struct c8_job*         p_jobs,
+    uint32_t                     count,
+    const struct runner_options* p_options)
+{
+    struct runner_pass pass;
+    uint64_t* p_reference;
+    uint64_t* p_hashes;
+    double base = 0.0;
+    double seconds;
+    uint32_t threads = 1;
+    int consistent = C8_TRUE;
+    int result = C8_TRUE;
+
+    p_reference = calloc(count + 1, sizeof(uint64_t));
+    p_hashes = calloc(count + 1, sizeof(uint64_t));
+
+    if (NULL == p_reference || NULL == p_hashes)
+    {
+        free(p_reference);
+        free(p_hashes);
+        return C8_FALSE;
+    }
+
+    printf("%"PRIu32" jobs, up to %"PRIu32" threads\n", count, p_options->threads);
+    printf("  threads        seconds   instructions/sec   speedup   efficiency\n");
+
+    while (C8_TRUE == result)
+    {
+        result = run_pass(p_jobs, count, threads, p_options, C8_TRUE,
+                          (1 == threads) ? p_reference : p_hashes, &pass, &seconds);
+
+        if (1 == threads)
+        {
+            base = seconds;
+        }
+        else if (0 != memcmp(p_reference, p_hashes, count * sizeof(uint64_t)))
+        {
+            consistent = C8_FALSE;
+        }
+
+        printf("  %7"PRIu32"  %13.3f  %17.0f  %7.2fx  %10.1f%%\n",
+               threads,
+               seconds,
+               (seconds > 0.0) ? (double)pass.cycles / seconds : 0.0,
+               (seconds > 0.0) ? base / seconds : 0.0,
+               (seconds > 0.0) ? 100.0 * base / seconds / threads : 0.0);
+
+        if (threads >= p_options->threads)
+        {
+            break;
+        }
+
+        /* Powers of two, then the requested maximum */
+        threads = (threads * 2 < p_options->threads) ? threads * 2 : p_options->threads;
+    }
+
+    printf("  screen hashes: %s across thread counts\n",
+           consistent ? "identical" : "DIFFER");
+
+    free(p_reference);
+    free(p_hashes);
+
+    /* Jobs are deterministic, so differing hashes mean a broken runner */
+    return (C8_TRUE == result && C8_TRUE == consistent) ? C8_TRUE : C8_FALSE;
+}
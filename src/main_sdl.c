@@ -3,11 +3,16 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <math.h>
+#include <string.h>
+#include <time.h>
 
 #include "c8_cpu.h"
+#include "c8_movie.h"
+#include "c8_pacer.h"
+#include "c8_rewind.h"
+#include "c8_rgba.h"
 
 #define WINDOW_SCALE 15
-#define INSTRUCTIONS_PER_FRAME 10
 
 #define SAMPLE_RATE 44100
 #define AMPLITUDE 8000   
@@ -21,13 +26,29 @@
 
 static void handle_input(
     struct c8_cpu* p_cpu, 
-    int* p_quit);
+    int* p_quit,
+    int* p_rewinding,
+    int* p_turbo);
+
+/**
+ * @brief Run one frame worth of instructions.
+ * @param[in,out] p_redraw, set if the screen was drawn to.
+ * @return C8_FALSE if the program counter went out of bounds.
+ */
+static int run_frame(
+    struct c8_cpu* p_cpu,
+    uint32_t budget,
+    int* p_redraw);
 
 static void draw_screen(
     struct c8_cpu* p_cpu, 
+    const struct c8_palette* p_palette,
     SDL_Texture* p_texture, 
     SDL_Renderer* p_renderer);
 
+static void print_stats(
+    const struct c8_pacer* p_pacer);
+
 static void audio_callback(
     void* userdata,
     uint8_t* stream,
@@ -44,25 +65,91 @@ int main(
     SDL_Renderer* renderer = NULL;
     SDL_Texture* texture = NULL;
     int result = C8_TRUE;
-    int i;
+    struct c8_pacer pacer;
+    uint32_t ips = C8_PACER_DEFAULT_IPS;
+    uint32_t frames;
+    uint32_t frame;
+    int redraw;
+    int stats = 0;
+    int turbo = 0;
     int quit = 0;
+    int rewinding = C8_FALSE;
+    struct c8_rewind* p_rewind;
+    const struct c8_palette* p_palette = c8_palette_find("green");
+    const char* p_rom_path = NULL;
+    const char* p_movie_path = NULL;
+    struct c8_movie* p_movie = NULL;
+    const uint64_t seed = (uint64_t)time(NULL);
     SDL_AudioSpec want;
+    int i;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "--palette") && i + 1 < argc)
+        {
+            p_palette = c8_palette_find(argv[++i]);
+        }
+        else if (0 == strcmp(argv[i], "--ips") && i + 1 < argc)
+        {
+            ips = (uint32_t)strtoul(argv[++i], NULL, 10);
+
+            if (0 == ips)
+            {
+                p_rom_path = NULL;
+                break;
+            }
+        }
+        else if (0 == strcmp(argv[i], "--stats"))
+        {
+            stats = 1;
+        }
+        else if (0 == strcmp(argv[i], "--turbo"))
+        {
+            turbo = 1;
+        }
+        else if (0 == strcmp(argv[i], "--record") && i + 1 < argc)
+        {
+            p_movie_path = argv[++i];
+        }
+        else if (NULL == p_rom_path)
+        {
+            p_rom_path = argv[i];
+        }
+        else
+        {
+            p_rom_path = NULL;
+            break;
+        }
+    }
 
-    if (argc != 2)
+    if (NULL == p_rom_path || NULL == p_palette)
     {
-        printf("usage: ./chip8-sdl path/to/rom\n");
+        printf("usage: ./chip8-sdl [--stats] [--turbo] [--ips N] [--record FILE] [--palette %s] path/to/rom\n", c8_palette_names());
         return 1;
     }
 
     /* Initialize CPU */
     c8_init(&cpu);
-    result = c8_load_rom_from_file(argv[1], &cpu);
+    c8_load_font(&cpu);
+    c8_seed(&cpu, seed);
+    printf("Loading rom: [path='%s']\n", p_rom_path);
+    result = c8_load_rom_from_file(p_rom_path, &cpu);
 
     if (C8_FALSE == result)
     {
         return 1;
     }
 
+    if (NULL != p_movie_path)
+    {
+        p_movie = c8_movie_create(&cpu, seed, ips);
+
+        if (NULL == p_movie)
+        {
+            return 1;
+        }
+    }
+
     /* Initialize SDL */
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0)
     {
@@ -89,41 +176,87 @@ int main(
         "CHIP-8 Emulator (SDL)",
         SDL_WINDOWPOS_CENTERED,
         SDL_WINDOWPOS_CENTERED,
-        C8_SCREEN_W * WINDOW_SCALE,
-        C8_SCREEN_H * WINDOW_SCALE,
+        C8_SCREEN_LORES_W * WINDOW_SCALE,
+        C8_SCREEN_LORES_H * WINDOW_SCALE,
         SDL_WINDOW_SHOWN);
 
     renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
     
+    /* Room for hi-res, lo-res uses the top left corner */
     texture = SDL_CreateTexture(
         renderer, 
         SDL_PIXELFORMAT_RGBA8888,
         SDL_TEXTUREACCESS_STREAMING, 
-        C8_SCREEN_W, 
-        C8_SCREEN_H);
+        C8_SCREEN_HIRES_W, 
+        C8_SCREEN_HIRES_H);
+
+    /* Rewind is optional, run without it if there is no memory. A
+       recording has to run forwards only */
+    p_rewind = (NULL == p_movie) ?
+               c8_rewind_create(C8_REWIND_DEFAULT_FRAMES, C8_REWIND_DEFAULT_BYTES) : NULL;
+
+    if (NULL != p_rewind)
+    {
+        c8_rewind_push(p_rewind, &cpu);
+    }
 
     /* Main Loop */
+    c8_pacer_init(&pacer, ips);
+    frames = 1;
+
     while (C8_TRUE == result && !quit)
     {
-        handle_input(&cpu, &quit);
+        handle_input(&cpu, &quit, &rewinding, &turbo);
+        c8_pacer_set_turbo(&pacer, turbo ? C8_TRUE : C8_FALSE);
 
-        for (i = 0; i < INSTRUCTIONS_PER_FRAME; i++)
+        if (C8_TRUE == rewinding && NULL != p_rewind)
         {
-            result = c8_step(&cpu);
+            /* Step back one frame per frame while the key is held */
+            if (C8_TRUE == c8_rewind_step_back(p_rewind, &cpu))
+            {
+                draw_screen(&cpu, p_palette, texture, renderer);
+            }
+
+            SDL_PauseAudio(1);
+            frames = c8_pacer_wait(&pacer);
+            continue;
+        }
+
+        /* Run every frame that is due, redraw at most once. In turbo mode
+           this is every frame that fits in one display period */
+        redraw = C8_FALSE;
 
-            if (C8_FALSE == result)
+        for (frame = 0; frame < frames && C8_TRUE == result; frame++)
+        {
+            result = run_frame(&cpu, c8_pacer_budget(&pacer), &redraw);
+
+            c8_decrement_timers(&cpu);
+
+            if (NULL != p_rewind)
             {
-                break;
+                c8_rewind_push(p_rewind, &cpu);
+            }
+
+            if (NULL != p_movie && C8_FALSE == c8_movie_record(p_movie, &cpu))
+            {
+                result = C8_FALSE;
             }
         }
 
-        if (cpu.screen_is_dirty)
+        if (C8_FALSE == result)
         {
-            draw_screen(&cpu, texture, renderer);
-            cpu.screen_is_dirty = 0;
+            if (C8_FALSE == c8_has_exited(&cpu))
+            {
+                printf("unexpected program counter %d / %d \n", cpu.pc, cpu.pc_max);
+            }
+            break;
         }
 
-        c8_decrement_timers(&cpu);
+        if (C8_TRUE == redraw)
+        {
+            draw_screen(&cpu, p_palette, texture, renderer);
+            cpu.screen_is_dirty = 0;
+        }
 
         if (cpu.sound_timer > 0)
         {
@@ -134,10 +267,40 @@ int main(
             SDL_PauseAudio(1);
         }
 
-        SDL_Delay(16);
+        if (C8_TRUE == cpu.waiting_for_key &&
+            0 == cpu.delay_timer && 0 == cpu.sound_timer)
+        {
+            /* Nothing happens until a key is pressed, sleep until any
+               event arrives and leave it queued for handle_input */
+            SDL_WaitEventTimeout(NULL, -1);
+            c8_pacer_restart(&pacer);
+            frames = 1;
+            continue;
+        }
+
+        /* Sleep until the next frame is due */
+        frames = c8_pacer_wait(&pacer);
+    }
+
+    if (stats)
+    {
+        print_stats(&pacer);
+    }
+
+    if (NULL != p_movie)
+    {
+        c8_movie_finish(p_movie, &cpu);
+
+        if (C8_FALSE == c8_movie_save(p_movie, p_movie_path))
+        {
+            fprintf(stderr, "failed to write recording '%s'\n", p_movie_path);
+        }
+
+        c8_movie_destroy(p_movie);
     }
 
     /* Cleanup */
+    c8_rewind_destroy(p_rewind);
     SDL_CloseAudio();
     SDL_DestroyTexture(texture);
     SDL_DestroyRenderer(renderer);
@@ -149,6 +312,60 @@ int main(
 
 /* --- Local Function Definitions --- */
 
+static int run_frame(
+    struct c8_cpu* p_cpu,
+    uint32_t budget,
+    int* p_redraw)
+{
+    enum c8_run_stop stop;
+    uint32_t executed;
+
+    while (budget > 0)
+    {
+        stop = c8_run(p_cpu, budget, C8_RUN_STOP_ON_DRAW | C8_RUN_SKIP_IDLE, &executed);
+        budget -= executed;
+
+        if (C8_RUN_DRAW == stop)
+        {
+            *p_redraw = C8_TRUE;
+        }
+        else if (C8_RUN_ERROR == stop)
+        {
+            return C8_FALSE;
+        }
+        else
+        {
+            /* Budget used up or waiting for a key until next frame */
+            break;
+        }
+    }
+
+    return C8_TRUE;
+}
+
+static void print_stats(
+    const struct c8_pacer* p_pacer)
+{
+    const struct c8_pacer_stats* p_stats = &p_pacer->stats;
+
+    if (0 == p_stats->frames)
+    {
+        return;
+    }
+
+    fprintf(stderr,
+            "frames paced: %"PRIu64" (%"PRIu64" caught up, %"PRIu64" dropped)\n"
+            "late:         %.3f ms average, %.3f ms max\n"
+            "jitter:       %.3f ms average, %.3f ms max\n"
+            "turbo frames: %"PRIu64"\n",
+            p_stats->frames, p_stats->caught_up, p_stats->dropped,
+            (double)p_stats->late_ns_total * 1e-6 / p_stats->frames,
+            (double)p_stats->late_ns_max * 1e-6,
+            (double)p_stats->jitter_ns_total * 1e-6 / p_stats->frames,
+            (double)p_stats->jitter_ns_max * 1e-6,
+            p_stats->turbo_frames);
+}
+
 static void audio_callback(void* userdata, uint8_t* stream, int len)
 {
     struct c8_cpu* cpu = (struct c8_cpu*)userdata;
@@ -173,7 +390,7 @@ static void audio_callback(void* userdata, uint8_t* stream, int len)
     }
 }
 
-static void handle_input(struct c8_cpu* p_cpu, int* p_quit)
+static void handle_input(struct c8_cpu* p_cpu, int* p_quit, int* p_rewinding, int* p_turbo)
 {
     SDL_Event e;
     int is_down;
@@ -219,24 +436,40 @@ static void handle_input(struct c8_cpu* p_cpu, int* p_quit)
             case SDLK_c: p_cpu->keyboard[0xB] = is_down; break;
             case SDLK_v: p_cpu->keyboard[0xF] = is_down; break;
 
+            case SDLK_BACKSPACE: *p_rewinding = is_down; break;
+
+            case SDLK_TAB:
+                if (is_down && !e.key.repeat)
+                {
+                    *p_turbo = !*p_turbo;
+                }
+                break;
+
             default: break;
             }
         }
     }
 }
 
-static void draw_screen(struct c8_cpu* p_cpu, SDL_Texture* p_texture, SDL_Renderer* p_renderer)
+static void draw_screen(struct c8_cpu* p_cpu, const struct c8_palette* p_palette, SDL_Texture* p_texture, SDL_Renderer* p_renderer)
 {
-    uint32_t pixels[C8_SCREEN_W * C8_SCREEN_H];
-    int i;
-
-    for (i = 0; i < C8_SCREEN_W * C8_SCREEN_H; i++)
+    /* Only the part of the texture the current resolution uses is
+     * locked and stretched over the window
+     */
+    SDL_Rect area = { 0, 0, p_cpu->screen_w, p_cpu->screen_h };
+    void* p_pixels;
+    int pitch;
+
+    /* Expand straight into the texture, no intermediate copy */
+    if (0 != SDL_LockTexture(p_texture, &area, &p_pixels, &pitch))
     {
-        pixels[i] = (p_cpu->screen[i]) ? 0x00FF00FF : 0x1A1A1AFF;
+        return;
     }
 
-    SDL_UpdateTexture(p_texture, NULL, pixels, C8_SCREEN_W * sizeof(uint32_t));
+    c8_rgba_expand(p_cpu, p_palette, p_pixels, (uint32_t)pitch);
+    SDL_UnlockTexture(p_texture);
+
     SDL_RenderClear(p_renderer);
-    SDL_RenderCopy(p_renderer, p_texture, NULL, NULL);
+    SDL_RenderCopy(p_renderer, p_texture, &area, NULL);
     SDL_RenderPresent(p_renderer);
 }
@@ -0,0 +1,299 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c8_bytes.h"
+#include "c8_cpu.h"
+#include "c8_opcodes.h"
+#include "c8_trace.h"
+
+/* Records printed before the first divergence */
+#define TRACEDUMP_CONTEXT (8)
+
+/**
+ * A trace dump read back from disk.
+ */
+struct tracedump_file {
+    const char* p_path;
+    /* Global index of the first record */
+    uint64_t first;
+    uint32_t count;
+    /* Records with results, the rest were still executing */
+    uint32_t complete;
+    struct c8_trace_record* p_records;
+};
+
+/* --- Local Function Declarations --- */
+
+static void print_usage(
+    const char* p_name);
+
+static int load_trace(
+    const char*            p_path,
+    struct tracedump_file* p_file);
+
+static void print_record(
+    const struct tracedump_file* p_file,
+    uint32_t                     i);
+
+static int same_record(
+    const struct tracedump_file* p_a,
+    uint32_t                     i,
+    const struct tracedump_file* p_b,
+    uint32_t                     j);
+
+static int diff_traces(
+    const struct tracedump_file* p_a,
+    const struct tracedump_file* p_b);
+
+/* --- Main Function --- */
+
+int main(
+    int argc,
+    const char* argv[])
+{
+    struct tracedump_file files[2];
+    const char* p_paths[2] = { NULL, NULL };
+    uint32_t last = 0;
+    uint32_t i;
+    int path_count = 0;
+    int result;
+    int arg;
+
+    for (arg = 1; arg < argc; arg++)
+    {
+        if (0 == strcmp(argv[arg], "-h") ||
+            0 == strcmp(argv[arg], "--help"))
+        {
+            print_usage(argv[0]);
+            return 0;
+        }
+        else if (0 == strcmp(argv[arg], "--last") && arg + 1 < argc)
+        {
+            last = (uint32_t)strtoul(argv[++arg], NULL, 10);
+        }
+        else if ('-' != argv[arg][0] && path_count < 2)
+        {
+            p_paths[path_count++] = argv[arg];
+        }
+        else
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (0 == path_count)
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    for (arg = 0; arg < path_count; arg++)
+    {
+        if (C8_FALSE == load_trace(p_paths[arg], &files[arg]))
+        {
+            return 1;
+        }
+    }
+
+    if (2 == path_count)
+    {
+        result = diff_traces(&files[0], &files[1]);
+    }
+    else
+    {
+        printf("%s: %"PRIu32" records from #%"PRIu64"\n",
+               files[0].p_path, files[0].count, files[0].first);
+
+        i = (0 != last && last < files[0].count) ? files[0].count - last : 0;
+
+        for (; i < files[0].count; i++)
+        {
+            print_record(&files[0], i);
+        }
+
+        result = C8_TRUE;
+    }
+
+    for (arg = 0; arg < path_count; arg++)
+    {
+        free(files[arg].p_records);
+    }
+
+    return (C8_TRUE == result) ? 0 : 1;
+}
+
+/* --- Local Function Definitions --- */
+
+static void print_usage(
+    const char* p_name)
+{
+    printf("usage: %s [--last N] trace [other-trace]\n"
+           "Prints an execution trace written by --trace, oldest first.\n"
+           "With two traces, prints where they first differ.\n"
+           "      --last N          print only the newest N records\n",
+           p_name);
+}
+
+static int load_trace(
+    const char*            p_path,
+    struct tracedump_file* p_file)
+{
+    uint8_t header[C8_TRACE_HEADER_SIZE];
+    uint8_t record[C8_TRACE_RECORD_SIZE];
+    FILE* p_in;
+    uint32_t i;
+
+    memset(p_file, 0x00, sizeof(*p_file));
+    p_file->p_path = p_path;
+
+    p_in = fopen(p_path, "rb");
+
+    if (NULL == p_in)
+    {
+        fprintf(stderr, "chip8-tracedump: cannot open '%s'\n", p_path);
+        return C8_FALSE;
+    }
+
+    if (sizeof(header) != fread(header, 1, sizeof(header), p_in) ||
+        0 != memcmp(header, C8_TRACE_MAGIC, 4) ||
+        C8_TRACE_VERSION != c8_get_le(&header[4], 2) ||
+        C8_TRACE_RECORD_SIZE != c8_get_le(&header[6], 2))
+    {
+        fprintf(stderr, "chip8-tracedump: '%s' is not a version %d trace\n",
+                p_path, C8_TRACE_VERSION);
+        fclose(p_in);
+        return C8_FALSE;
+    }
+
+    p_file->count = (uint32_t)c8_get_le(&header[8], 4);
+    p_file->complete = (uint32_t)c8_get_le(&header[12], 4);
+    p_file->first = c8_get_le(&header[16], 8);
+    p_file->p_records = malloc(sizeof(*p_file->p_records) * (p_file->count + 1));
+
+    if (NULL == p_file->p_records)
+    {
+        fclose(p_in);
+        return C8_FALSE;
+    }
+
+    for (i = 0; i < p_file->count; i++)
+    {
+        if (sizeof(record) != fread(record, 1, sizeof(record), p_in))
+        {
+            fprintf(stderr, "chip8-tracedump: '%s' is truncated\n", p_path);
+            free(p_file->p_records);
+            fclose(p_in);
+            return C8_FALSE;
+        }
+
+        p_file->p_records[i].pc = (uint16_t)c8_get_le(&record[0], 2);
+        p_file->p_records[i].op = (uint16_t)c8_get_le(&record[2], 2);
+        p_file->p_records[i].I = (uint16_t)c8_get_le(&record[4], 2);
+        p_file->p_records[i].vx = record[6];
+        p_file->p_records[i].vf = record[7];
+    }
+
+    fclose(p_in);
+
+    return C8_TRUE;
+}
+
+static void print_record(
+    const struct tracedump_file* p_file,
+    uint32_t                     i)
+{
+    const struct c8_trace_record* p_record = &p_file->p_records[i];
+
+    printf("%12"PRIu64"  %03X  %04X  %-12s",
+           p_file->first + i, p_record->pc, p_record->op,
+           c8_op_name(c8_decode_op(p_record->op)));
+
+    if (i < p_file->complete)
+    {
+        printf("  I=%03X  V%X=%02X  VF=%02X\n",
+               p_record->I, (p_record->op >> 8) & 0xF, p_record->vx, p_record->vf);
+    }
+    else
+    {
+        printf("  (executing)\n");
+    }
+}
+
+static int same_record(
+    const struct tracedump_file* p_a,
+    uint32_t                     i,
+    const struct tracedump_file* p_b,
+    uint32_t                     j)
+{
+    const struct c8_trace_record* p_ra = &p_a->p_records[i];
+    const struct c8_trace_record* p_rb = &p_b->p_records[j];
+
+    if (p_ra->pc != p_rb->pc || p_ra->op != p_rb->op)
+    {
+        return C8_FALSE;
+    }
+
+    /* Results only when both instructions finished */
+    if (i >= p_a->complete || j >= p_b->complete)
+    {
+        return C8_TRUE;
+    }
+
+    return p_ra->I == p_rb->I && p_ra->vx == p_rb->vx && p_ra->vf == p_rb->vf;
+}
+
+static int diff_traces(
+    const struct tracedump_file* p_a,
+    const struct tracedump_file* p_b)
+{
+    /* Records are compared by global index, both traces must start at
+     * the same instruction for the indices to line up */
+    const uint64_t start = (p_a->first > p_b->first) ? p_a->first : p_b->first;
+    const uint64_t end_a = p_a->first + p_a->count;
+    const uint64_t end_b = p_b->first + p_b->count;
+    const uint64_t end = (end_a < end_b) ? end_a : end_b;
+    uint64_t index;
+    uint64_t context;
+
+    if (start >= end)
+    {
+        fprintf(stderr, "chip8-tracedump: traces do not overlap, #%"PRIu64"-#%"PRIu64" and #%"PRIu64"-#%"PRIu64"\n",
+                p_a->first, end_a, p_b->first, end_b);
+        return C8_FALSE;
+    }
+
+    for (index = start; index < end; index++)
+    {
+        if (C8_FALSE == same_record(p_a, (uint32_t)(index - p_a->first),
+                                    p_b, (uint32_t)(index - p_b->first)))
+        {
+            break;
+        }
+    }
+
+    if (index == end)
+    {
+        printf("no difference in %"PRIu64" common records, #%"PRIu64"-#%"PRIu64"\n",
+               end - start, start, end);
+        return C8_TRUE;
+    }
+
+    printf("first difference at #%"PRIu64"\n", index);
+
+    context = (index - start > TRACEDUMP_CONTEXT) ? index - TRACEDUMP_CONTEXT : start;
+
+    for (; context < index; context++)
+    {
+        print_record(p_a, (uint32_t)(context - p_a->first));
+    }
+
+    printf("%s:\n", p_a->p_path);
+    print_record(p_a, (uint32_t)(index - p_a->first));
+    printf("%s:\n", p_b->p_path);
+    print_record(p_b, (uint32_t)(index - p_b->first));
+
+    /* A difference means the traces diverged, exit status reports it */
+    return C8_FALSE;
+}